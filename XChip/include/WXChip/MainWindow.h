@@ -41,7 +41,7 @@ class MainWindow final : public wxFrame
 public:
 	enum 
 	{ 
-		ID_MENU_BAR_LOAD_ROM, ID_ROMS_TEXT, ID_LISTBOX, 
+		ID_MENU_BAR_LOAD_ROM, ID_MENU_BAR_LOAD_LIB, ID_ROMS_TEXT, ID_LISTBOX, 
 		ID_BUTTON_LOAD_ROM, ID_BUTTON_SELECT_DIR, ID_BUTTON_SETTINGS
 	};
 
@@ -65,9 +65,11 @@ private:
 	void OnButtonSettings(wxCommandEvent& ev);
 	void OnButtonSelectDir(wxCommandEvent& ev);
 	void OnMenuBarLoadRom(wxCommandEvent& ev);
+	void OnMenuBarLoadLib(wxCommandEvent& ev);
 
 	wxString m_emuAppPath;
 	wxString m_romPath;
+	wxString m_libPath;
 	utix::Process m_process;
 
 	std::unique_ptr<wxPanel> m_panel;
@@ -26,6 +26,17 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #include "Core/Emulator.h"
 #include "Core/Fonts.h"
 #include "Core/Instructions.h"
+#include "Core/Lockstep.h"
+#include "Core/SharedImage.h"
+#include "Core/MappedFile.h"
+#include "Core/RomLibrary.h"
+#include "Core/Stats.h"
+#include "Core/Trace.h"
+#include "Core/Debugger.h"
+#include "Core/Disassembler.h"
+#include "Core/Analyzer.h"
+#include "Core/TripleBuffer.h"
+#include "Core/CommandQueue.h"
 
 
 
@@ -0,0 +1,180 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_ANALYZER_H_
+#define XCHIP_CORE_ANALYZER_H_
+
+#include <cstdio>
+#include <Utix/Ints.h>
+
+
+
+namespace xchip {
+
+
+// Static control flow analysis of a ROM image. A recursive descent from
+// the entry point separates reachable code from data, then basic blocks,
+// the call graph, BNNN jump tables and stores through I into code
+// (self-modifying code) are recovered from it. I is followed through
+// ANNN along each path, stores and reads through a computed I are missed.
+// The results are kept in fixed arrays allocated by Initialize(), Analyze()
+// fails if one of them overflows.
+class Analyzer
+{
+public:
+	static constexpr size_t MAX_ADDRESS = 0x10000;
+	static constexpr size_t MAX_TABLE_ENTRIES = 128;
+	static constexpr size_t MAX_BLOCKS = MAX_ADDRESS / 2;  // 2 bytes at least each
+	static constexpr size_t MAX_FUNCTIONS = 0x1000 + 1;    // 2NNN targets and the entry
+	static constexpr size_t MAX_CALLS = 0x4000;
+	static constexpr size_t MAX_JUMP_TABLES = 0x400;
+	static constexpr size_t MAX_STORES = 0x4000;
+
+	enum Marks : uint8_t
+	{
+		MARK_CODE     = 0x01,  // byte of a reachable instruction
+		MARK_INSTR    = 0x02,  // first byte of a reachable instruction
+		MARK_BLOCK    = 0x04,  // basic block leader
+		MARK_FUNCTION = 0x08,  // entry point or 2NNN target
+		MARK_TABLE    = 0x10,  // BNNN jump table entry
+		MARK_READ     = 0x20,  // read through I, sprites and FX65
+		MARK_WRITE    = 0x40   // written through I, FX33 and FX55
+	};
+
+	// [begin, end), last is the address of the block's last instruction
+	struct Block { uint16_t begin, end, last; };
+	struct Call { uint16_t caller, site, callee; };
+	struct JumpTable { uint16_t site, base, count; };
+	struct Store { uint16_t site, address, size; };
+
+	Analyzer() noexcept;
+	~Analyzer();
+	Analyzer(const Analyzer&) = delete;
+	Analyzer& operator=(const Analyzer&) = delete;
+
+	bool Initialize() noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+
+	bool Analyze(const uint8_t* image, const size_t size, const size_t base);
+	bool Analyze(const uint8_t* image, const size_t size, const size_t base, const size_t entry);
+
+	size_t GetBase() const;
+	size_t GetEnd() const;
+	size_t GetEntry() const;
+	uint8_t GetMarks(const size_t address) const;
+	bool IsCode(const size_t address) const;
+	bool IsInstruction(const size_t address) const;
+	uint16_t GetOpcode(const size_t address) const;
+	const Block* GetBlocks() const;
+	const uint16_t* GetFunctions() const;
+	const Call* GetCalls() const;
+	const JumpTable* GetJumpTables() const;
+	const Store* GetSelfModifyingStores() const;
+	size_t GetBlocksSize() const;
+	size_t GetFunctionsSize() const;
+	size_t GetCallsSize() const;
+	size_t GetJumpTablesSize() const;
+	size_t GetSelfModifyingStoresSize() const;
+
+	void WriteListing(FILE* out) const;
+	void WriteReport(FILE* out) const;
+
+private:
+	// the (pc, I) pairs walked are an open addressing set, kept half empty
+	static constexpr size_t MAX_PATHS = 0x10000;
+	static constexpr size_t MAX_VISITED = 0x40000;
+
+	struct Path { uint16_t pc; int32_t I; };
+	bool InImage(const size_t address, const size_t size) const;
+	bool Discover();
+	bool ScanJumpTable(const uint16_t site, const uint16_t base, const int32_t I);
+	void MarkRange(const size_t address, const size_t size, const uint8_t marks);
+	void BuildBlocks();
+	bool BuildCallGraph();
+	size_t GetSuccessors(const uint16_t pc, uint16_t* succ) const;
+	uint16_t GetSkipTarget(const uint16_t next) const;
+
+	const uint8_t* m_image = nullptr;
+	uint8_t* m_marks = nullptr;
+	size_t m_base = 0;
+	size_t m_end = 0;
+	size_t m_entry = 0;
+	uint32_t* m_visited = nullptr;
+	uint16_t* m_stamps = nullptr;
+	uint16_t* m_stack = nullptr;
+	Path* m_worklist = nullptr;
+	Block* m_blocks = nullptr;
+	uint16_t* m_functions = nullptr;
+	Call* m_calls = nullptr;
+	JumpTable* m_tables = nullptr;
+	Store* m_stores = nullptr;
+	size_t m_visitedSize = 0;
+	size_t m_worklistSize = 0;
+	size_t m_blocksSize = 0;
+	size_t m_functionsSize = 0;
+	size_t m_callsSize = 0;
+	size_t m_tablesSize = 0;
+	size_t m_storesSize = 0;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool Analyzer::IsInitialized() const { return m_initialized; }
+inline size_t Analyzer::GetBase() const { return m_base; }
+inline size_t Analyzer::GetEnd() const { return m_end; }
+inline size_t Analyzer::GetEntry() const { return m_entry; }
+inline uint8_t Analyzer::GetMarks(const size_t address) const { return m_marks[address % MAX_ADDRESS]; }
+inline bool Analyzer::IsCode(const size_t address) const { return (GetMarks(address) & MARK_CODE) != 0; }
+inline bool Analyzer::IsInstruction(const size_t address) const { return (GetMarks(address) & MARK_INSTR) != 0; }
+inline const Analyzer::Block* Analyzer::GetBlocks() const { return m_blocks; }
+inline const uint16_t* Analyzer::GetFunctions() const { return m_functions; }
+inline const Analyzer::Call* Analyzer::GetCalls() const { return m_calls; }
+inline const Analyzer::JumpTable* Analyzer::GetJumpTables() const { return m_tables; }
+inline const Analyzer::Store* Analyzer::GetSelfModifyingStores() const { return m_stores; }
+inline size_t Analyzer::GetBlocksSize() const { return m_blocksSize; }
+inline size_t Analyzer::GetFunctionsSize() const { return m_functionsSize; }
+inline size_t Analyzer::GetCallsSize() const { return m_callsSize; }
+inline size_t Analyzer::GetJumpTablesSize() const { return m_tablesSize; }
+inline size_t Analyzer::GetSelfModifyingStoresSize() const { return m_storesSize; }
+
+
+inline bool Analyzer::Analyze(const uint8_t* image, const size_t size, const size_t base)
+{
+	return this->Analyze(image, size, base, base);
+}
+
+
+// the image is only referenced, it must outlive the Analyzer's queries
+inline uint16_t Analyzer::GetOpcode(const size_t address) const
+{
+	return static_cast<uint16_t>((m_image[address - m_base] << 8) | m_image[address - m_base + 1]);
+}
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_ANALYZER_H_
@@ -0,0 +1,104 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_COMMANDQUEUE_H_
+#define XCHIP_CORE_COMMANDQUEUE_H_
+
+#include <atomic>
+#include <Utix/Ints.h>
+
+
+
+namespace xchip {
+
+class Emulator;
+
+
+// a request to the emulation thread that carries data,
+// see Emulator::PostCommand()
+struct Command
+{
+	using DoneCallback = void(*)(const void* arg, const bool success);
+
+	enum Type : uint8_t
+	{
+		SET_CPU_FREQ,  // value
+		SET_FPS,       // value
+		SAVE_STATE     // Clone() into dest without syncing dest plugins, then done(arg, success)
+	};
+
+	Type type;
+	int value;
+	Emulator* dest;
+	DoneCallback done;
+	const void* arg;
+};
+
+
+
+
+// Hands commands from any number of threads to one consumer thread,
+// lock free and bounded. Each slot holds a sequence number telling
+// whose turn it is: producers claim slots with a CAS on the tail and
+// never wait, Push() fails when the queue is full. So it can be used
+// from signal handlers, as long as std::atomic<size_t> is lock free.
+class CommandQueue
+{
+public:
+	static constexpr size_t CAPACITY = 32;
+
+	CommandQueue() noexcept;
+	CommandQueue(const CommandQueue&) = delete;
+	CommandQueue& operator=(const CommandQueue&) = delete;
+
+	// producers
+	bool Push(const Command& command);
+
+	// consumer: false when empty
+	bool Pop(Command& command);
+
+private:
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		Command command;
+	};
+
+	Slot m_slots[CAPACITY];
+	std::atomic<size_t> m_tail;
+	size_t m_head = 0;
+};
+
+
+
+
+}
+
+
+
+
+
+
+
+
+
+#endif // XCHIP_CORE_COMMANDQUEUE_H_
@@ -37,7 +37,7 @@ struct Cpu
 	uint8_t* memory;
 	uint8_t* registers;
 	size_t*  stack;
-	uint32_t* gfx;
+	uint64_t* gfx; // bit planes of 64 pixels words, the leftmost pixel in the msb
 
 	iRender* render;
 	iInput* input;
@@ -51,6 +51,11 @@ struct Cpu
 	uint16_t opcode;
 	uint8_t delayTimer;
 	uint8_t soundTimer;
+	uint16_t keys;     // keypad state, bit N is set while key N is down
+	uint16_t waitKeys; // keys already held when FX0A began to wait
+	uint8_t planes;    // XO-Chip FN01: planes drawn, scrolled and cleared. 1 by default
+	uint8_t pitch;     // XO-Chip FX3A: pattern rate, 4000 * 2^((pitch - 64) / 48) hz
+	uint8_t pattern[16]; // XO-Chip F002: 1 bit audio pattern, with AUDIO_PATTERN
 	
 	enum Flags : uint32_t 
 	{ 
@@ -61,7 +66,10 @@ struct Cpu
 		EXTENDED_MODE = 0x10,
 		BAD_RENDER = 0x20,
 		BAD_INPUT = 0x40,
-		BAD_SOUND = 0x80
+		BAD_SOUND = 0x80,
+		WAIT_KEY = 0x100,
+		AUDIO_PATTERN = 0x200,
+		HOLD = 0x400  // paused by the host, see Emulator::RequestPause()
 	};
 };
 
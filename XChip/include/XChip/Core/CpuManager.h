@@ -21,29 +21,44 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #ifndef XCHIP_CORE_MANAGER_H_
 #define XCHIP_CORE_MANAGER_H_
 
+#include <cstring>
 #include <Utix/Alloc.h>
 #include <Utix/Vector2.h>
 
 #include "Cpu.h"
 #include "Fonts.h"
+#include "MappedFile.h"
 
 
 
 namespace xchip {
+class SharedImage;
 
 class CpuManager
 {
 public:
+	static constexpr size_t MAX_MEMORY_SIZE = 0x10000;
+	static constexpr size_t MEMORY_PAGE_SIZE = 0x100;
+	static constexpr size_t MEMORY_PAGES = MAX_MEMORY_SIZE / MEMORY_PAGE_SIZE;
+	// readable bytes after the memory, the longest read from one
+	// address is a 16x16 sprite on both planes
+	static constexpr size_t MEMORY_GUARD_SIZE = 64;
+	static constexpr size_t GFX_PLANES = 2;
+	static constexpr size_t MAX_GFX_SIZE = 128 * 64;
+
 	CpuManager() noexcept;
 	~CpuManager();
 	CpuManager(const CpuManager&) = delete;
 	CpuManager& operator=(const CpuManager&) = delete;
 
 	void Dispose() noexcept;
+	bool CloneInto(CpuManager& dest) const;
 
 
 	uint8_t GetDelayTimer() const;
 	uint8_t GetSoundTimer() const;
+	uint16_t GetKeys() const;
+	uint8_t GetPlanes() const;
 	uint16_t GetOpcode() const;
 	uint16_t GetOpcode(const uint16_t mask) const;
 	uint32_t GetFlags() const;
@@ -52,50 +67,59 @@ public:
 	size_t GetPC() const;
 	size_t GetSP() const;
 	size_t GetMemorySize() const;
+	size_t GetMemoryMask() const;
 	size_t GetRegistersSize() const;
 	size_t GetStackSize() const;
+	size_t GetStackMask() const;
 	size_t GetGfxSize() const;
+	size_t GetGfxPitch() const;
+	size_t GetPlaneSize() const;
 	const utix::Vec2i& GetGfxRes() const;
+	const utix::Vec2i& GetGfxModeRes(const bool extended) const;
 
 
 	const iRender* GetRender() const;
 	const iInput* GetInput() const;
 	const iSound* GetSound() const;
 	const uint8_t* GetMemory() const;
+	const uint8_t* GetMemoryAt(const size_t address) const;
 	const uint8_t* GetRegisters() const;
 	const size_t* GetStack() const;
-	const uint32_t* GetGfx() const;
+	const uint64_t* GetGfx() const;
+	const uint64_t* GetPlane(const size_t plane) const;
 	const Cpu& GetCpu() const;
 	const uint8_t& GetMemory(const size_t offset) const;
 	const uint8_t& GetRegisters(const size_t offset) const;
 	const size_t& GetStack(const size_t offset) const;
-	const uint32_t& GetGfx(const size_t offset) const;
-	const uint32_t& GetGfx(const utix::Vec2i& point) const;
-	const uint32_t& GetGfx(const int x, const int y) const;
+	void ComposeGfx(uint8_t* dest) const;
 
 
 	iRender* GetRender();
 	iInput* GetInput();
 	iSound* GetSound();
 	uint8_t* GetMemory();
+	uint8_t* GetMemoryAt(const size_t address);
 	uint8_t* GetRegisters();
 	size_t* GetStack();
-	uint32_t* GetGfx();
+	uint64_t* GetGfx();
+	uint64_t* GetPlane(const size_t plane);
 	Cpu& GetCpu();
 	uint8_t& GetMemory(const size_t offset);
 	uint8_t& GetRegisters(const size_t offset);
 	size_t& GetStack(const size_t offset);
-	uint32_t& GetGfx(const size_t offset);
-	uint32_t& GetGfx(const utix::Vec2i& point);
-	uint32_t& GetGfx(const int x, const int y);
+	bool IsMemoryPageDirty(const size_t page) const;
+	bool IsMemoryShared() const;
+	bool IsGfxDirty() const;
 	
 
 	void FetchOpcode();
+	void SkipInstruction();
 	bool SetMemory(const size_t size);
+	bool SetMemory(const SharedImage& image);
 	bool SetRegisters(const size_t size);
 	bool SetStack(const size_t size);
-	bool SetGfxRes(const utix::Vec2i& res);
-	bool SetGfxRes(const int w, const int h);
+	bool SetGfxModes(const utix::Vec2i& lowRes, const utix::Vec2i& highRes);
+	void SetExtendedGfx(const bool extended);
 	bool ResizeMemory(const size_t size);
 	bool ResizeRegisters(const size_t size);
 	bool ResizeStack(const size_t size);
@@ -104,16 +128,20 @@ public:
 	void CleanFlags();
 	void SetDelayTimer(const uint8_t val);
 	void SetSoundTimer(const uint8_t val);
+	void SetKeys(const uint16_t mask);
+	void SetPlanes(const uint8_t mask);
 	void SetOpcode(const uint16_t val);
 	void SetIndexRegister(const size_t index);
 	void SetPC(const size_t offset);
 	void SetSP(const size_t offset);
 	void LoadDefaultFont();
 	void LoadHiResFont();
-	bool LoadRom(const char* file, const size_t at);
+	LoadStatus LoadRom(const char* file, const size_t at);
+	LoadStatus LoadRom(const uint8_t* data, const size_t size, const size_t at);
 	void SetRender(iRender* render);
 	void SetInput(iInput* input);
 	void SetSound(iSound* sound);
+	void SyncSoundPattern();
 
 	iRender* SwapRender(iRender* render);
 	iInput* SwapInput(iInput* input);
@@ -125,12 +153,28 @@ public:
 	void CleanStack();
 	void CleanGfx();
 
+	// dirty tracking used by CloneInto. Anything writing memory or gfx 
+	// through the raw pointers must mark what it wrote.
+	void MarkMemoryDirty(const size_t offset, const size_t size);
+	void MarkGfxDirty();
+	void MarkMemoryClean();
+
 	static constexpr size_t GetDefaultFontIndex();
 	static constexpr size_t GetHiResFontIndex();
+	static uint32_t NewCloneBase();
 
 private:
+	void ReleaseMemory();
+
 	Cpu m_cpu;
 	utix::Vec2i m_gfxRes = {0, 0};
+	uint64_t* m_gfxModes[2] = { nullptr, nullptr };
+	utix::Vec2i m_gfxModesRes[2] = { {0, 0}, {0, 0} };
+	const SharedImage* m_memoryImage = nullptr;
+	size_t m_memorySize = 0;
+	uint64_t m_dirtyPages[MEMORY_PAGES / 64] = { 0 };
+	uint32_t m_cloneBase = 0;
+	bool m_gfxDirty = false;
 };
 
 
@@ -141,6 +185,8 @@ private:
 
 inline uint8_t CpuManager::GetDelayTimer() const { return m_cpu.delayTimer; }
 inline uint8_t CpuManager::GetSoundTimer() const { return m_cpu.soundTimer; }
+inline uint8_t CpuManager::GetPlanes() const { return m_cpu.planes; }
+inline uint16_t CpuManager::GetKeys() const { return m_cpu.keys; }
 inline uint16_t CpuManager::GetOpcode() const { return m_cpu.opcode; }
 inline uint16_t CpuManager::GetOpcode(const uint16_t mask) const { return m_cpu.opcode & mask; }
 inline uint32_t CpuManager::GetFlags() const { return m_cpu.flags; }
@@ -148,20 +194,34 @@ inline uint32_t CpuManager::GetFlags(const uint32_t flags) const { return m_cpu.
 inline size_t CpuManager::GetIndexRegister() const { return m_cpu.I; }
 inline size_t CpuManager::GetPC() const { return m_cpu.pc; }
 inline size_t CpuManager::GetSP() const { return m_cpu.sp; }
-inline size_t CpuManager::GetMemorySize() const { return utix::arr_size(m_cpu.memory); }
+inline size_t CpuManager::GetMemorySize() const { return m_memorySize; }
+inline size_t CpuManager::GetMemoryMask() const { return m_memorySize - 1; }
 inline size_t CpuManager::GetRegistersSize() const { return utix::arr_size(m_cpu.registers); }
 inline size_t CpuManager::GetStackSize() const { return utix::arr_size(m_cpu.stack); }
-inline size_t CpuManager::GetGfxSize() const { return utix::arr_size(m_cpu.gfx); }
+inline size_t CpuManager::GetStackMask() const { return GetStackSize() - 1; }
+inline size_t CpuManager::GetGfxSize() const { return m_gfxRes.x * m_gfxRes.y; }
+inline size_t CpuManager::GetGfxPitch() const { return m_gfxRes.x / 64; }
+inline size_t CpuManager::GetPlaneSize() const { return GetGfxPitch() * m_gfxRes.y; }
 inline const utix::Vec2i& CpuManager::GetGfxRes() const { return m_gfxRes; }
+inline const utix::Vec2i& CpuManager::GetGfxModeRes(const bool extended) const { return m_gfxModesRes[extended]; }
 
 inline const iRender* CpuManager::GetRender() const { return m_cpu.render; }
 inline const iInput* CpuManager::GetInput() const { return m_cpu.input; }
 inline const iSound* CpuManager::GetSound() const { return m_cpu.sound; }
 inline const uint8_t* CpuManager::GetMemory() const { return m_cpu.memory; }
+inline const uint8_t* CpuManager::GetMemoryAt(const size_t address) const { return m_cpu.memory + (address & GetMemoryMask()); }
 inline const uint8_t* CpuManager::GetRegisters() const { return m_cpu.registers; }
 inline const size_t* CpuManager::GetStack() const { return m_cpu.stack; }
-inline const uint32_t* CpuManager::GetGfx() const { return m_cpu.gfx; }
+inline const uint64_t* CpuManager::GetGfx() const { return m_cpu.gfx; }
 inline const Cpu& CpuManager::GetCpu() const { return m_cpu; }
+inline bool CpuManager::IsGfxDirty() const { return m_gfxDirty; }
+inline bool CpuManager::IsMemoryShared() const { return m_memoryImage != nullptr; }
+
+inline bool CpuManager::IsMemoryPageDirty(const size_t page) const
+{
+	ASSERT_MSG(page < MEMORY_PAGES, "memory page overflow");
+	return (m_dirtyPages[page / 64] & (uint64_t(1) << (page % 64))) != 0;
+}
 
 
 
@@ -186,25 +246,10 @@ inline const size_t& CpuManager::GetStack(const size_t offset) const
 }
 
 
-inline const uint32_t& CpuManager::GetGfx(const size_t offset) const 
-{ 
-	ASSERT_MSG(GetGfxSize() > offset, "GFX overflow"); 
-	return m_cpu.gfx[offset]; 
-}
-
-
-inline const uint32_t& CpuManager::GetGfx(const utix::Vec2i& point) const  
-{
-	ASSERT_MSG(m_gfxRes.x >= point.x && m_gfxRes.y >= point.y, "GFX overflow"); 
-	return m_cpu.gfx[ ( m_gfxRes.x * point.y ) + point.x]; 
-}
-
-
-
-inline const uint32_t& CpuManager::GetGfx(const int x, const int y) const  
+inline const uint64_t* CpuManager::GetPlane(const size_t plane) const
 {
-	ASSERT_MSG(m_gfxRes.x >= x && m_gfxRes.y >= y, "GFX overflow"); 
-	return m_cpu.gfx[ ( m_gfxRes.x * y ) + x]; 
+	ASSERT_MSG(plane < GFX_PLANES, "GFX plane overflow");
+	return m_cpu.gfx + (plane * GetPlaneSize());
 }
 
 
@@ -216,9 +261,10 @@ inline iRender* CpuManager::GetRender() { return m_cpu.render; }
 inline iInput* CpuManager::GetInput() { return m_cpu.input; }
 inline iSound* CpuManager::GetSound() { return m_cpu.sound; }
 inline uint8_t* CpuManager::GetMemory() { return m_cpu.memory; }
+inline uint8_t* CpuManager::GetMemoryAt(const size_t address) { return m_cpu.memory + (address & GetMemoryMask()); }
 inline uint8_t* CpuManager::GetRegisters() { return m_cpu.registers; }
 inline size_t* CpuManager::GetStack() { return m_cpu.stack; }
-inline uint32_t* CpuManager::GetGfx() { return m_cpu.gfx; }
+inline uint64_t* CpuManager::GetGfx() { return m_cpu.gfx; }
 inline Cpu& CpuManager::GetCpu() { return m_cpu; }
 
 
@@ -242,31 +288,28 @@ inline size_t& CpuManager::GetStack(const size_t offset)
 }
 
 
-inline uint32_t& CpuManager::GetGfx(const size_t offset) 
-{ 
-	ASSERT_MSG(GetGfxSize() > offset, "GFX overflow"); 
-	return m_cpu.gfx[offset]; 
-}
-
-
-inline uint32_t& CpuManager::GetGfx(const utix::Vec2i& point)
+inline uint64_t* CpuManager::GetPlane(const size_t plane)
 {
-	ASSERT_MSG(m_gfxRes.x >= point.x && m_gfxRes.y >= point.y, "GFX overflow"); 
-	return m_cpu.gfx[ ( m_gfxRes.x * point.y ) + point.x]; 
+	ASSERT_MSG(plane < GFX_PLANES, "GFX plane overflow");
+	return m_cpu.gfx + (plane * GetPlaneSize());
 }
 
 
-inline uint32_t& CpuManager::GetGfx(const int x, const int y)
+// the pc wraps around the memory, the guard tail covers pc + 1
+inline void CpuManager::FetchOpcode()
 {
-	ASSERT_MSG(m_gfxRes.x >= x && m_gfxRes.y >= y, "GFX overflow"); 
-	return m_cpu.gfx[ ( m_gfxRes.x * y ) + x]; 
+	const size_t pc = m_cpu.pc & GetMemoryMask();
+	m_cpu.opcode = m_cpu.memory[pc] << 8 | m_cpu.memory[pc + 1];
+	m_cpu.pc = pc + 2;
 }
 
 
-inline void CpuManager::FetchOpcode()
+// the skip instructions jump over F000 NNNN whole, 4 bytes
+inline void CpuManager::SkipInstruction()
 {
-	m_cpu.opcode = m_cpu.memory[m_cpu.pc] << 8 | m_cpu.memory[m_cpu.pc+1];
-	m_cpu.pc += 2;
+	const size_t pc = m_cpu.pc & GetMemoryMask();
+	const bool longInstr = ((m_cpu.memory[pc] ^ 0xF0) | m_cpu.memory[pc + 1]) == 0;
+	m_cpu.pc = pc + 2 + (size_t(longInstr) << 1);
 }
 
 
@@ -275,6 +318,8 @@ inline void CpuManager::UnsetFlags(const uint32_t flags) { m_cpu.flags &= ~flags
 inline void CpuManager::CleanFlags() { m_cpu.flags = 0; }
 inline void CpuManager::SetDelayTimer(const uint8_t val) { m_cpu.delayTimer = val; }
 inline void CpuManager::SetSoundTimer(const uint8_t val) { m_cpu.soundTimer = val; }
+inline void CpuManager::SetKeys(const uint16_t mask) { m_cpu.keys = mask; }
+inline void CpuManager::SetPlanes(const uint8_t mask) { m_cpu.planes = mask; }
 inline void CpuManager::SetOpcode(const uint16_t val) { m_cpu.opcode = val; }
 inline void CpuManager::SetIndexRegister(const size_t index) { m_cpu.I = index; }
 inline void CpuManager::SetPC(const size_t offset) { m_cpu.pc = offset; }
@@ -283,7 +328,8 @@ inline void CpuManager::SetSP(const size_t offset) { m_cpu.sp = offset; }
 
 inline void CpuManager::CleanMemory() 
 { 
-	utix::arr_zero(m_cpu.memory); 
+	memset(m_cpu.memory, 0, GetMemorySize());
+	MarkMemoryDirty(0, GetMemorySize());
 }
 
 inline void CpuManager::CleanRegisters() 
@@ -292,6 +338,10 @@ inline void CpuManager::CleanRegisters()
 	m_cpu.I = 0;
 	m_cpu.delayTimer = 0;
 	m_cpu.soundTimer = 0;
+	m_cpu.waitKeys = 0;
+	m_cpu.planes = 1;
+	m_cpu.pitch = 64;
+	memset(m_cpu.pattern, 0, sizeof(m_cpu.pattern));
 }
 
 
@@ -305,6 +355,47 @@ inline void CpuManager::CleanStack()
 inline void CpuManager::CleanGfx() 
 { 
 	utix::arr_zero(m_cpu.gfx); 
+	m_gfxDirty = true;
+}
+
+
+// both modes are allocated by SetGfxModes, switching is a pointer swap.
+// The new mode starts blank, as 00FE/00FF do on a real SuperChip.
+inline void CpuManager::SetExtendedGfx(const bool extended)
+{
+	ASSERT_MSG(m_gfxModes[extended] != nullptr, "null gfx mode buffer");
+
+	if (m_cpu.gfx != m_gfxModes[extended])
+	{
+		m_cpu.gfx = m_gfxModes[extended];
+		m_gfxRes = m_gfxModesRes[extended];
+		CleanGfx();
+	}
+
+	if (extended)
+		SetFlags(Cpu::EXTENDED_MODE);
+	else
+		UnsetFlags(Cpu::EXTENDED_MODE);
+}
+
+
+inline void CpuManager::MarkMemoryDirty(const size_t offset, const size_t size)
+{
+	if (size == 0)
+		return;
+
+	// a write wrapping around the memory end dirties the first pages
+	ASSERT_MSG(offset < MAX_MEMORY_SIZE && size <= MAX_MEMORY_SIZE, "memory page overflow");
+	const size_t pageMask = GetMemoryMask() / MEMORY_PAGE_SIZE;
+	const size_t last = (offset + size - 1) / MEMORY_PAGE_SIZE;
+	for (size_t page = offset / MEMORY_PAGE_SIZE; page <= last; ++page)
+		m_dirtyPages[(page & pageMask) / 64] |= uint64_t(1) << ((page & pageMask) % 64);
+}
+
+
+inline void CpuManager::MarkGfxDirty()
+{
+	m_gfxDirty = true;
 }
 
 
@@ -0,0 +1,173 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_DEBUGGER_H_
+#define XCHIP_CORE_DEBUGGER_H_
+
+#include <Utix/Ints.h>
+#include "CpuManager.h"
+
+
+
+namespace xchip {
+
+
+// Breakpoints, watchpoints and stepping for one CpuManager. The Emulator
+// only calls into it from its instrumented execution path, which it takes
+// while a Debugger is enabled, so a run without one pays nothing for it.
+// State is inspected through the CpuManager getters while paused.
+class Debugger
+{
+public:
+	static constexpr size_t MAX_ADDRESS = 0x10000;
+	static constexpr size_t MAX_CONDITIONS = 16;
+
+	enum Watch : uint8_t
+	{
+		WATCH_READ = 0x01,
+		WATCH_WRITE = 0x02
+	};
+
+	// V0 - VF are 0x0 - 0xF
+	enum Register : uint8_t
+	{
+		REG_I = 0x10,
+		REG_DT = 0x11,
+		REG_SP = 0x12
+	};
+
+	enum class Compare : uint8_t { EQUAL, NOT_EQUAL, LESS, GREATER };
+
+	enum class Reason : uint8_t
+	{
+		NONE,
+		PAUSE,
+		BREAKPOINT,
+		WATCH_READ,
+		WATCH_WRITE,
+		CONDITION,
+		STEP
+	};
+
+	// why and where the last break happened. address is the PC for
+	// breakpoints and steps, the memory address for watchpoints and
+	// the condition index for conditions
+	struct BreakInfo
+	{
+		Reason reason;
+		uint16_t pc;
+		uint16_t address;
+	};
+
+	Debugger() noexcept;
+	~Debugger();
+	Debugger(const Debugger&) = delete;
+	Debugger& operator=(const Debugger&) = delete;
+
+	bool Initialize() noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	bool IsPaused() const;
+	const BreakInfo& GetBreakInfo() const;
+
+	void SetBreakpoint(const uint16_t address, const bool val);
+	bool GetBreakpoint(const uint16_t address) const;
+	void SetWatchpoint(const uint16_t address, const size_t size, const uint8_t watch);
+	uint8_t GetWatchpoint(const uint16_t address) const;
+	int AddCondition(const uint8_t reg, const Compare cmp, const uint16_t value);
+	bool RemoveCondition(const int index);
+	bool GetCondition(const int index, uint8_t& reg, Compare& cmp, uint16_t& value) const;
+	void ClearAll();
+
+	void Break();
+	void Continue();
+	void Step();
+	void StepOver(const CpuManager& cpuMan);
+	void RunTo(const uint16_t address);
+
+	// the Emulator's instrumented path. BeforeInstr returns
+	// false when the next instruction must not run.
+	bool BeforeInstr(const CpuManager& cpuMan);
+	void AfterInstr(const CpuManager& cpuMan);
+
+	static uint16_t ReadRegister(const CpuManager& cpuMan, const uint8_t reg);
+
+private:
+	struct Condition
+	{
+		uint16_t value;
+		uint8_t reg;
+		Compare cmp;
+		bool active;
+		bool last;
+	};
+
+	enum class Run : uint8_t { RUNNING, PAUSED, STEP, STEP_OVER, RUN_TO };
+
+	void Pause(const Reason reason, const uint16_t pc, const uint16_t address);
+	bool TestBit(const uint64_t* bits, const size_t address) const;
+	bool CheckWatchpoints(const CpuManager& cpuMan);
+
+	uint64_t* m_breakpoints = nullptr;
+	uint8_t* m_watchpoints = nullptr;
+	Condition m_conditions[MAX_CONDITIONS];
+	BreakInfo m_breakInfo = { Reason::NONE, 0, 0 };
+	size_t m_conditionsCount = 0;
+	size_t m_watchCount = 0;
+	size_t m_stopSP = 0;
+	uint16_t m_stopPC = 0;
+	Run m_run = Run::RUNNING;
+	bool m_resuming = false;
+	bool m_breakRequest = false;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool Debugger::IsInitialized() const { return m_initialized; }
+inline bool Debugger::IsPaused() const { return m_run == Run::PAUSED; }
+inline const Debugger::BreakInfo& Debugger::GetBreakInfo() const { return m_breakInfo; }
+
+inline bool Debugger::TestBit(const uint64_t* bits, const size_t address) const
+{
+	return (bits[address / 64] & (uint64_t(1) << (address % 64))) != 0;
+}
+
+inline bool Debugger::GetBreakpoint(const uint16_t address) const 
+{ 
+	ASSERT_MSG(m_initialized, "Debugger is not initialized");
+	return TestBit(m_breakpoints, address); 
+}
+
+inline uint8_t Debugger::GetWatchpoint(const uint16_t address) const 
+{ 
+	ASSERT_MSG(m_initialized, "Debugger is not initialized");
+	return m_watchpoints[address]; 
+}
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_DEBUGGER_H_
@@ -0,0 +1,86 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_DISASSEMBLER_H_
+#define XCHIP_CORE_DISASSEMBLER_H_
+
+#include <Utix/Ints.h>
+
+
+
+// Stateless opcode decoding: handler names, mnemonics, control flow and
+// the memory each instruction touches through I. Shared by the Analyzer,
+// the profiler reports, the debugger and the tools.
+
+namespace xchip { namespace disassembler {
+
+
+enum Flow : uint8_t
+{
+	FLOW_NEXT,      // falls through
+	FLOW_SKIP,      // falls through or skips the next instruction
+	FLOW_JUMP,      // 1NNN
+	FLOW_CALL,      // 2NNN, returns to the next instruction
+	FLOW_RETURN,    // 00EE
+	FLOW_INDIRECT,  // BNNN, target depends on V0
+	FLOW_STOP       // 00FD and unknown opcodes
+};
+
+
+enum Access : uint8_t
+{
+	ACCESS_NONE  = 0x00,
+	ACCESS_READ  = 0x01,
+	ACCESS_WRITE = 0x02
+};
+
+
+struct OpcodeInfo
+{
+	uint16_t mask;
+	uint16_t value;
+	const char* name;    // "8XY4"
+	const char* syntax;  // "ADD V{x}, V{y}"
+	Flow flow;
+};
+
+
+// the last entry matches any opcode and stands for the unknown ones
+constexpr size_t OPCODE_TABLE_SIZE = 51;
+extern const OpcodeInfo opcodeTable[OPCODE_TABLE_SIZE];
+
+// enough for the longest mnemonic plus its operands
+constexpr size_t MAX_TEXT_SIZE = 24;
+
+
+extern size_t GetOpcodeIndex(const uint16_t opcode);
+extern const OpcodeInfo& GetOpcodeInfo(const uint16_t opcode);
+extern bool IsKnownOpcode(const uint16_t opcode);
+extern size_t GetInstrSize(const uint16_t opcode);
+extern size_t Disassemble(const uint16_t opcode, char* buffer, const size_t size);
+extern Access GetAccess(const uint16_t opcode, const bool extended, size_t& size);
+
+
+
+}}
+
+
+
+#endif // XCHIP_CORE_DISASSEMBLER_H_
@@ -21,6 +21,8 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #ifndef XCHIP_CORE_EMULATOR_H_
 #define XCHIP_CORE_EMULATOR_H_
 
+#include <atomic>
+#include <thread>
 #include <Utix/Log.h>
 #include <Utix/Timer.h>
 #include <Utix/Assert.h>
@@ -28,6 +30,12 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 
 #include <XChip/Plugins.h>
 #include "CpuManager.h"
+#include "SharedImage.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Debugger.h"
+#include "TripleBuffer.h"
+#include "CommandQueue.h"
 #include "Instructions.h"
 
 
@@ -54,6 +62,7 @@ public:
 	bool Initialize(UniqueRender&& render, UniqueInput&& input, UniqueSound&& sound) noexcept;
 
 	void Dispose() noexcept;
+	bool Clone(Emulator& dest) const;
 	bool IsInitialized() const;
 	bool Good() const;
 	bool GetInstrFlag() const;
@@ -62,25 +71,65 @@ public:
 	void HaltForNextFlag() const;
 	int GetCpuFreq() const;
 	int GetFps() const;
+	bool GetStatsEnabled() const;
+	EmulatorStats GetStats() const;
+	bool GetTraceEnabled() const;
+	const TraceBuffer& GetTrace() const;
+	bool GetDebuggerEnabled() const;
+	const Debugger& GetDebugger() const;
+	bool GetIdleSkipEnabled() const;
+	bool GetWorkerRunning() const;
+	const CpuManager& GetCpuManager() const;
 	const iRender* GetRender() const;
 	const iInput* GetInput() const;
 	const iSound* GetSound() const;
 
+	// the per frame plugin calls. A host that created its plugins itself
+	// can name their final types (see EmuApp with XCHIP_STATIC_PLUGINS),
+	// the calls are then direct and can be inlined. The defaults call
+	// through the interfaces, as the plugins loaded from libraries need.
+	template<class Render = iRender, class Input = iInput>
 	void UpdateSystems();
 	void ExecuteInstr();
 	void CleanFlags();
+	template<class Render = iRender>
 	void Draw();
 	void Reset();
+	size_t RunFrameUncapped();
+
+	// threaded mode: the machine runs on a worker thread and the
+	// calling thread only presents, see UpdatePresentation().
+	bool StartWorker();
+	void StopWorker();
+	bool UpdatePresentation();
+
+	// the control plane: safe from any thread and from signal handlers,
+	// applied by the emulation thread between bursts (UpdateSystems(), 
+	// RunFrameUncapped() and the worker loop). PostCommand() fails when 
+	// the queue is full. A SAVE_STATE dest only gets the machine, its 
+	// plugins are not synced: Clone() it on the host thread to load it.
+	void RequestExit();
+	void RequestReset();
+	void RequestPause(const bool val);
+	bool PostCommand(const Command& command);
 
 	iRender* GetRender();
 	iInput* GetInput();
 	iSound* GetSound();
+	TraceBuffer& GetTrace();
+	Debugger& GetDebugger();
 
 	void SetDrawFlag(const bool val);
 	void SetExitFlag(const bool val);
 	void SetCpuFreq(const int value);
 	void SetFps(const int value);
+	void SetStatsEnabled(const bool val);
+	bool SetTraceEnabled(const bool val, const size_t capacity = TraceBuffer::DEFAULT_CAPACITY);
+	bool SetDebuggerEnabled(const bool val);
+	void SetIdleSkipEnabled(const bool val);
 	bool LoadRom(const std::string& fileName);
+	bool LoadRom(const uint8_t* data, const size_t size);
+	bool LoadRom(const SharedImage& image);
 	bool SetRender(UniqueRender rend);
 	bool SetInput(UniqueInput input);
 	bool SetSound(UniqueSound sound);
@@ -93,15 +142,60 @@ public:
 	P SwapPlugin(P&&);
 
 private:
+	enum Hooks : uint8_t
+	{
+		HOOK_TRACE = 0x01,
+		HOOK_DEBUGGER = 0x02
+	};
+
+	// posted by the plugins callbacks and the control plane, 
+	// taken by the emulation thread
+	enum Requests : uint32_t
+	{
+		REQ_EXIT = 0x01,
+		REQ_RESET = 0x02,
+		REQ_PAUSE = 0x04,
+		REQ_RESUME = 0x08,
+		REQ_COMMAND = 0x10
+	};
+
  	void UpdateTimers();
+	void TickTimers();
+	bool ExecuteHooked();
+	int CheckIdleLoop();
 	bool InitRender();
 	bool InitInput();
 	bool InitSound();
+	void PostRequest(const uint32_t request);
+	void ApplyRequests();
+	void ApplyCommand(const Command& command);
+	bool CloneState(Emulator& dest) const;
+	bool SyncRender(const utix::Vec2i& res, const uint8_t* gfx);
+	void PublishFrame();
+	void WorkerLoop();
 
 	CpuManager m_manager;
 	utix::Timer m_instrTimer;
 	utix::Timer m_frameTimer;
 	utix::Timer m_chDelayTimer;
+	mutable StatsCollector m_stats;
+	TraceBuffer m_trace;
+	Debugger m_debugger;
+	uint8_t m_hooks = 0;
+	int m_uncappedInstrs = 0;
+	int m_uncappedTicks = 0;
+	bool m_idleSkip = false;
+	bool m_idle = false;
+	std::thread m_worker;
+	TripleBuffer m_frames;
+	utix::Timer m_presentTimer;
+	std::atomic<uint32_t> m_requests;
+	CommandQueue m_commands;
+	std::atomic<uint16_t> m_keyMask;
+	std::atomic<bool> m_workerRunning;
+	const uint8_t* m_renderGfx = nullptr;
+	utix::Vec2i m_renderRes;
+	uint8_t m_screen[CpuManager::MAX_GFX_SIZE];
 	UniqueRender m_renderPlugin;
 	UniqueInput m_inputPlugin;
 	UniqueSound m_soundPlugin;
@@ -116,16 +210,32 @@ inline bool Emulator::IsInitialized() const { return m_initialized; }
 inline bool Emulator::Good() const { return m_manager.GetFlags(Cpu::BAD_RENDER | Cpu::BAD_INPUT | Cpu::BAD_SOUND) == 0u; }
 inline bool Emulator::GetInstrFlag() const { return m_manager.GetFlags(Cpu::INSTR) != 0u; }
 inline bool Emulator::GetDrawFlag() const { return m_manager.GetFlags(Cpu::DRAW) != 0u; }
-inline bool Emulator::GetExitFlag() const { return m_manager.GetFlags(Cpu::EXIT) != 0u; }
+inline bool Emulator::GetExitFlag() const { return (m_requests.load(std::memory_order_relaxed) & REQ_EXIT) || m_manager.GetFlags(Cpu::EXIT); }
 inline const iRender* Emulator::GetRender() const { return m_manager.GetRender(); }
 inline const iInput* Emulator::GetInput() const { return m_manager.GetInput(); }
 inline const iSound* Emulator::GetSound() const { return m_manager.GetSound(); }
 inline int Emulator::GetCpuFreq() const { return m_instrTimer.GetTargetHz(); }
 inline int Emulator::GetFps() const { return m_frameTimer.GetTargetHz(); }
+inline bool Emulator::GetStatsEnabled() const { return m_stats.IsEnabled(); }
+inline EmulatorStats Emulator::GetStats() const { return m_stats.GetSnapshot(); }
+inline bool Emulator::GetTraceEnabled() const { return m_trace.IsInitialized(); }
+inline const TraceBuffer& Emulator::GetTrace() const { return m_trace; }
+inline bool Emulator::GetDebuggerEnabled() const { return m_debugger.IsInitialized(); }
+inline const Debugger& Emulator::GetDebugger() const { return m_debugger; }
+inline bool Emulator::GetIdleSkipEnabled() const { return m_idleSkip; }
+inline bool Emulator::GetWorkerRunning() const { return m_workerRunning.load(std::memory_order_acquire); }
+inline const CpuManager& Emulator::GetCpuManager() const { return m_manager; }
 
 
 inline void Emulator::SetCpuFreq(const int value) { m_instrTimer.SetTargetHz(utix::Clamp(value, 60, 50000)); }
 inline void Emulator::SetFps(const int value) { m_frameTimer.SetTargetHz(utix::Clamp(value, 10, 1000)); }
+inline void Emulator::SetStatsEnabled(const bool val) { m_stats.SetEnabled(val); }
+
+inline void Emulator::SetIdleSkipEnabled(const bool val)
+{
+	m_idleSkip = val;
+	m_idle = false;
+}
 
 inline void Emulator::SetDrawFlag(const bool val) 
 { 
@@ -136,33 +246,205 @@ inline void Emulator::SetDrawFlag(const bool val)
 }
 
 
+// setting it only posts the request, so it is safe from other threads
 inline void Emulator::SetExitFlag(const bool val) 
 {
 	if (val)
-		m_manager.SetFlags(Cpu::EXIT);
-	else
-		m_manager.UnsetFlags(Cpu::EXIT);
+	{
+		this->RequestExit();
+		return;
+	}
+
+	m_requests.fetch_and(~static_cast<uint32_t>(REQ_EXIT), std::memory_order_relaxed);
+	m_manager.UnsetFlags(Cpu::EXIT);
+}
+
+
+
+inline bool Emulator::LoadRom(const std::string& fname) 
+{ 
+	if (m_manager.LoadRom(fname.c_str(), 0x200) != LoadStatus::OK)
+		return false;
+
+	// the freshly loaded image is the base clones diff against
+	m_manager.MarkMemoryClean();
+	return true;
 }
 
 
+inline bool Emulator::LoadRom(const uint8_t* data, const size_t size) 
+{ 
+	if (m_manager.LoadRom(data, size, 0x200) != LoadStatus::OK)
+		return false;
 
-inline bool Emulator::LoadRom(const std::string& fname) { return m_manager.LoadRom(fname.c_str(), 0x200); }
+	m_manager.MarkMemoryClean();
+	return true;
+}
+
+
+inline bool Emulator::LoadRom(const SharedImage& image)
+{
+	// the image replaces the whole memory (fonts included), 
+	// it must outlive this Emulator or the next LoadRom call.
+	return m_manager.SetMemory(image);
+}
 
 inline iRender* Emulator::GetRender() { return m_manager.GetRender(); }
 inline iInput* Emulator::GetInput() { return m_manager.GetInput(); }
 inline iSound* Emulator::GetSound() { return m_manager.GetSound(); }
+inline TraceBuffer& Emulator::GetTrace() { return m_trace; }
+inline Debugger& Emulator::GetDebugger() { return m_debugger; }
+
+inline bool Emulator::SetTraceEnabled(const bool val, const size_t capacity)
+{
+	m_hooks &= ~HOOK_TRACE;
+	if (!val)
+	{
+		m_trace.Dispose();
+		return true;
+	}
+
+	if (!m_trace.Initialize(capacity))
+		return false;
+
+	m_hooks |= HOOK_TRACE;
+	return true;
+}
+
+
+inline bool Emulator::SetDebuggerEnabled(const bool val)
+{
+	m_hooks &= ~HOOK_DEBUGGER;
+	m_manager.UnsetFlags(Cpu::PAUSE);
+	if (!val)
+	{
+		m_debugger.Dispose();
+		return true;
+	}
+
+	if (!m_debugger.Initialize())
+		return false;
+
+	m_hooks |= HOOK_DEBUGGER;
+	return true;
+}
 
 inline void Emulator::ExecuteInstr()
 {
-	instructions::ExecuteInstruction(m_manager);
+	// FX0A holds the cpu until UpdateSystems sees a new key,
+	// the host until RequestPause(false)
+	if (m_manager.GetFlags(Cpu::WAIT_KEY | Cpu::HOLD))
+	{
+		m_manager.UnsetFlags(Cpu::INSTR);
+		return;
+	}
+
+	// tracing and debugging take their own path. Paced, every call runs
+	// a single instruction, so the hooks, the idle loop state and the 
+	// stats are tested once per instruction here. RunFrameUncapped() 
+	// tests the hooks and the idle skip once per burst instead.
+	if (!m_hooks)
+	{
+		// the loop would not change anything, the slot passes with no work
+		if (m_idle)
+			m_idle = this->CheckIdleLoop() != 0;
+
+		if (m_idle)
+		{
+			m_stats.AddInstr();
+			m_stats.AddIdle();
+			m_manager.UnsetFlags(Cpu::INSTR);
+			return;
+		}
+
+		instructions::ExecuteInstruction(m_manager);
+		m_stats.AddInstr();
+
+		// idle loops are only looked for where a jump lands
+		if (m_idleSkip && m_manager.GetOpcode(0xF000) == 0x1000)
+			m_idle = this->CheckIdleLoop() != 0;
+	}
+	else if (this->ExecuteHooked())
+	{
+		m_stats.AddInstr();
+	}
+
 	m_manager.UnsetFlags(Cpu::INSTR);
 }
 
 
+template<class Render, class Input>
+inline void Emulator::UpdateSystems()
+{
+	ASSERT_MSG(!m_manager.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
+	ASSERT_MSG(!m_manager.GetFlags(Cpu::BAD_INPUT),  "BAD INPUT");
+
+	// the plugins are polled once per frame, when UpdateTimers() raises
+	// the DRAW flag, not once per instruction. Their calls stay out of
+	// the instruction path, and the events and keys can't change any
+	// faster than the host presents anyway.
+	const bool framePending = m_manager.GetFlags(Cpu::DRAW) != 0;
+	this->UpdateTimers();
+
+	if (!framePending && m_manager.GetFlags(Cpu::DRAW))
+	{
+		Render* const render = static_cast<Render*>(m_manager.GetRender());
+		if (m_stats.IsEnabled())
+		{
+			const auto begin = StatsCollector::Now();
+			render->UpdateEvents();
+			m_stats.AddEvents(StatsCollector::Now() - begin);
+		}
+		else
+		{
+			render->UpdateEvents();
+		}
+
+		// the keypad mask is copied into the cpu once per frame,
+		// instructions read it from there instead of the plugin
+		Input* const input = static_cast<Input*>(m_manager.GetInput());
+		input->UpdateKeys();
+		m_manager.SetKeys(input->GetKeyMask());
+	}
+
+	if (m_requests.load(std::memory_order_relaxed))
+		this->ApplyRequests();
+
+	// FX0A is resumed here, with the keys of this frame
+	if (m_manager.GetFlags(Cpu::WAIT_KEY))
+		instructions::PollWaitKey(m_manager);
+}
+
+
+template<class Render>
 inline void Emulator::Draw()
 {
 	ASSERT_MSG( !m_manager.GetFlags(Cpu::BAD_RENDER), "bad render!");
-	m_manager.GetRender()->DrawBuffer();
+
+	// the planes become palette indexes for the render.
+	// 00FE/00FF only resize the gfx, the render follows it here
+	m_manager.ComposeGfx(m_screen);
+	if ((m_renderGfx != m_screen || m_renderRes != m_manager.GetGfxRes())
+		&& !this->SyncRender(m_manager.GetGfxRes(), m_screen))
+	{
+		m_manager.SetFlags(Cpu::EXIT);
+		m_manager.UnsetFlags(Cpu::DRAW);
+		return;
+	}
+
+	Render* const render = static_cast<Render*>(m_manager.GetRender());
+	if (m_stats.IsEnabled())
+	{
+		const auto begin = StatsCollector::Now();
+		render->DrawBuffer();
+		const auto end = StatsCollector::Now();
+		m_stats.AddFrame(end - begin, end);
+	}
+	else
+	{
+		render->DrawBuffer();
+	}
+
 	m_manager.UnsetFlags(Cpu::DRAW);
 }
 
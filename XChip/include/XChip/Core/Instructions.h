@@ -31,6 +31,7 @@ using InstrTable = void(*)(CpuManager&);
 extern InstrTable instrTable[16];
 
 extern void ExecuteInstruction(CpuManager&);
+extern bool PollWaitKey(CpuManager&); // ends a FX0A wait when a new key goes down
 
 
 // Primary table
@@ -39,15 +40,17 @@ extern void op_1NNN(CpuManager&); // jumps to address NNN
 extern void op_2NNN(CpuManager&); // calls subroutine at NNN
 extern void op_3XNN(CpuManager&); // Skips the next instruction if VX equals NN
 extern void op_4XNN(CpuManager&); // Skips the next instruction if VX doesn't equal NN
+extern void op_5XYx(CpuManager&); // 3 instructions switch
 extern void op_5XY0(CpuManager&); // Skips the next instruction if VX equals VY
+extern void op_5XY2(CpuManager&); // 5XY2* XO-Chip: Stores VX to VY in memory starting at I
+extern void op_5XY3(CpuManager&); // 5XY3* XO-Chip: Fills VX to VY from memory starting at I
 extern void op_6XNN(CpuManager&); // Sets VX to NN
 extern void op_7XNN(CpuManager&); // adds NN to VX
 extern void op_9XY0(CpuManager&); // Skips the next instruction if VX doesn't equal VY
 extern void op_ANNN(CpuManager&); // Sets I to the address NNN
 extern void op_BNNN(CpuManager&); // Jumps to the address NNN plus V0
 extern void op_CXNN(CpuManager&); // Sets VX to the result of a bitwise AND operation on a random number and NN
-extern void op_DXYN(CpuManager&); // DRAW Instruction .....
-extern void op_DXYN_ex(CpuManager&); // DRAW Instruction extended mode
+extern void op_DXYN(CpuManager&); // DRAW Instruction, DXY0 draws 16x16 in extended mode
 extern void op_EXxx(CpuManager&); // 2 instruction EX9E, EXA1
 // Primary table end
 
@@ -71,9 +74,15 @@ extern void op_8XYE(CpuManager&); // Shifts VX left by one. VF is set to the val
 
 // FXxxx subtable start
 extern void op_FXxx(CpuManager&); // 9 instructions, FX07 - FX33 
+extern void op_FXx0(CpuManager&); // 2 instructions switch
+extern void op_F000(CpuManager&); // F000 NNNN* XO-Chip: Sets I to the 16 bits address NNNN
 extern void op_FX30(CpuManager&); // FX30* SuperChip: Point I to the location of the sprite for the character in VX
+extern void op_FN01(CpuManager&); // FN01* XO-Chip: select the planes N drawn, scrolled and cleared
 extern void op_FX07(CpuManager&); // FX07   Sets VX to the value of the delay timer.
+extern void op_F002(CpuManager&); // F002* XO-Chip: load the 16 bytes audio pattern from I
+extern void op_FXxA(CpuManager&); // 2 instructions switch
 extern void op_FX0A(CpuManager&); // FX0A   A key press is awaited, and then stored in VX.
+extern void op_FX3A(CpuManager&); // FX3A* XO-Chip: set the audio pattern pitch to VX
 extern void op_FXx5(CpuManager&); // 3 instructions switch
 extern void op_FX18(CpuManager&); // FX18   Sets the sound timer to VX.
 extern void op_FX1E(CpuManager&); // FX1E   Adds VX to I.
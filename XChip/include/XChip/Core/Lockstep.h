@@ -0,0 +1,128 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_LOCKSTEP_H_
+#define XCHIP_CORE_LOCKSTEP_H_
+
+#include <Utix/Ints.h>
+#include <Utix/Assert.h>
+#include "CpuManager.h"
+
+
+
+namespace xchip {
+
+
+// Runs many CpuManagers (lanes) one instruction at a time, in lockstep.
+// The runner keeps the lanes' V0-VF, PC and I in its own arrays, in blocks
+// of BLOCK_LANES lanes, each register a row of one byte per lane. Lanes 
+// that fetched the same opcode run it together over those rows for the 
+// ALU, skip, jump and ANNN instructions, SSE2 where the target has it.
+// Every other opcode, and groups too small to pay off, run on the scalar
+// instruction tables. Lanes with Cpu::EXIT or Cpu::WAIT_KEY set are left halted.
+// Between steps the CpuManagers are out of date: Flush() or GetLane()
+// write the registers back, the next Step() loads them again. Dispose()
+// flushes too, the lanes must outlive the runner.
+class LockstepRunner
+{
+public:
+	static constexpr size_t MAX_LANES = 0x10000;
+	static constexpr size_t MIN_VECTOR_LANES = 4;
+	static constexpr size_t BLOCK_LANES = 16;
+
+	LockstepRunner() noexcept;
+	~LockstepRunner();
+	LockstepRunner(const LockstepRunner&) = delete;
+	LockstepRunner& operator=(const LockstepRunner&) = delete;
+
+	bool Initialize(CpuManager* const* lanes, const size_t count) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	size_t GetLaneCount() const;
+	size_t GetVectorInstrCount() const;
+	size_t GetScalarInstrCount() const;
+	CpuManager& GetLane(const size_t index);
+
+	void Step();
+	void Flush();
+	void TickTimers();
+
+private:
+	static constexpr size_t BLOCK_SIZE = BLOCK_LANES * 16;
+
+	void RunGroup(const uint16_t opcode, const uint8_t* mask, const size_t size);
+	bool ExecuteVector(const uint16_t opcode, const uint8_t* mask);
+	void ExecuteScalar(const uint8_t* mask);
+	size_t MatchLanes(const uint16_t opcode);
+	void LoadLanes();
+	void LoadLane(const size_t lane);
+	void StoreLane(const size_t lane);
+	void SkipLane(const size_t lane);
+	template<class Op>
+	void RunAlu(const uint8_t* mask, const size_t x, const size_t y, Op op);
+	template<class Cond>
+	void RunSkip(const uint8_t* mask, const size_t x, const size_t y, Cond cond);
+
+	CpuManager** m_lanes = nullptr;
+	const uint8_t** m_memory = nullptr;
+	size_t* m_memoryMask = nullptr;
+	size_t* m_pc = nullptr;
+	size_t* m_index = nullptr;
+	uint16_t* m_opcodes = nullptr;
+	uint8_t* m_regs = nullptr;    // [block][register][lane in block]
+	uint8_t* m_running = nullptr; // 0xFF for the lanes not halted
+	uint8_t* m_pending = nullptr; // running lanes no group took yet
+	uint8_t* m_mask = nullptr;    // the lanes of the current group
+	size_t m_laneCount = 0;
+	size_t m_blockCount = 0;
+	size_t m_runningCount = 0;
+	size_t m_vectorInstrs = 0;
+	size_t m_scalarInstrs = 0;
+	bool m_flushed = false;
+	bool m_initialized = false;
+};
+
+
+
+
+
+inline bool LockstepRunner::IsInitialized() const { return m_initialized; }
+inline size_t LockstepRunner::GetLaneCount() const { return m_laneCount; }
+inline size_t LockstepRunner::GetVectorInstrCount() const { return m_vectorInstrs; }
+inline size_t LockstepRunner::GetScalarInstrCount() const { return m_scalarInstrs; }
+
+// the lanes are flushed first, changes made
+// to them are loaded by the next Step()
+inline CpuManager& LockstepRunner::GetLane(const size_t index)
+{
+	ASSERT_MSG(index < m_laneCount, "lane index overflow");
+	this->Flush();
+	return *m_lanes[index];
+}
+
+
+
+
+}
+
+
+
+
+#endif // XCHIP_CORE_LOCKSTEP_H_
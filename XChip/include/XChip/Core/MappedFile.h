@@ -0,0 +1,83 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_MAPPEDFILE_H_
+#define XCHIP_CORE_MAPPEDFILE_H_
+
+#include <Utix/Ints.h>
+
+
+
+namespace xchip {
+
+
+enum class LoadStatus
+{
+	OK,
+	OPEN_FAILED,
+	READ_FAILED,
+	EMPTY,
+	DOES_NOT_FIT,
+	BAD_FORMAT
+};
+
+
+
+// A whole file mapped read-only in memory, so it can be read any
+// number of times with no further I/O. Platforms without file
+// mappings get the file read into a heap buffer instead.
+class MappedFile
+{
+public:
+	MappedFile() noexcept;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	LoadStatus Initialize(const char* fileName) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	bool IsMapped() const;
+	size_t GetSize() const;
+	const uint8_t* GetData() const;
+
+private:
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_mapped = false;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool MappedFile::IsInitialized() const { return m_initialized; }
+inline bool MappedFile::IsMapped() const { return m_mapped; }
+inline size_t MappedFile::GetSize() const { return m_size; }
+inline const uint8_t* MappedFile::GetData() const { return m_data; }
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_MAPPEDFILE_H_
@@ -0,0 +1,68 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_PROFILER_H_
+#define XCHIP_CORE_PROFILER_H_
+
+#include <cstdio>
+#include <chrono>
+#include <Utix/Ints.h>
+
+
+
+// Execution profiler, compiled in with XCHIP_PROFILER (cmake -DENABLE_PROFILER=ON).
+// ExecuteInstruction records every instruction's PC, opcode and host
+// time. Without XCHIP_PROFILER nothing here is referenced by the dispatch.
+// The counters are not synchronized: record from one emulation thread at a
+// time, the -THREADED worker included, and Report() after it is joined.
+
+namespace xchip { namespace profiler {
+
+
+struct Stats
+{
+	uint64_t count;
+	uint64_t nanosecs;
+};
+
+
+extern void Record(const uint16_t pc, const uint16_t opcode, const uint64_t nanosecs);
+extern void Reset();
+extern void Report(FILE* out);
+
+extern const Stats& GetPCStats(const uint16_t pc);
+extern const Stats& GetOpcodeStats(const uint16_t opcode);
+extern const char* GetHandlerName(const uint16_t opcode);
+
+
+
+inline uint64_t Now()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+}}
+
+
+
+#endif // XCHIP_CORE_PROFILER_H_
@@ -0,0 +1,117 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_ROMLIBRARY_H_
+#define XCHIP_CORE_ROMLIBRARY_H_
+
+#include <Utix/Ints.h>
+#include <Utix/Assert.h>
+#include "MappedFile.h"
+
+
+
+namespace xchip {
+
+
+// Many ROMs packed in a single file, read through one mapping.
+// Layout, little endian:
+//   Header | Entry[count] sorted by hash | ROM bytes
+// Entry offsets are relative to the start of the ROM bytes.
+class RomLibrary
+{
+public:
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t MAX_NAME_SIZE = 104;
+	static const char MAGIC[8];
+
+	enum Variant : uint32_t
+	{
+		VARIANT_UNKNOWN = 0,
+		VARIANT_CHIP8 = 0x1,
+		VARIANT_SCHIP = 0x2,
+		VARIANT_XOCHIP = 0x4
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t count;
+		uint64_t indexOffset;
+		uint64_t dataOffset;
+	};
+
+	struct Entry
+	{
+		uint64_t hash;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t variant;
+		char name[MAX_NAME_SIZE];
+	};
+
+
+	RomLibrary() noexcept;
+	~RomLibrary();
+	RomLibrary(const RomLibrary&) = delete;
+	RomLibrary& operator=(const RomLibrary&) = delete;
+
+	LoadStatus Initialize(const char* fileName) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	size_t GetCount() const;
+	const Entry& GetEntry(const size_t index) const;
+	const uint8_t* GetRomData(const Entry& entry) const;
+
+	const Entry* FindByName(const char* name) const;
+	const Entry* FindByHash(const uint64_t hash) const;
+	const Entry* Find(const char* nameOrHash) const;
+
+	static uint64_t ComputeHash(const uint8_t* data, const size_t size);
+
+private:
+	MappedFile m_file;
+	const Entry* m_entries = nullptr;
+	const uint8_t* m_romData = nullptr;
+	size_t m_count = 0;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool RomLibrary::IsInitialized() const { return m_initialized; }
+inline size_t RomLibrary::GetCount() const { return m_count; }
+inline const uint8_t* RomLibrary::GetRomData(const Entry& entry) const { return m_romData + entry.offset; }
+
+inline const RomLibrary::Entry& RomLibrary::GetEntry(const size_t index) const
+{
+	ASSERT_MSG(index < m_count, "RomLibrary entry overflow");
+	return m_entries[index];
+}
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_ROMLIBRARY_H_
@@ -0,0 +1,88 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_SHAREDIMAGE_H_
+#define XCHIP_CORE_SHAREDIMAGE_H_
+
+#include <Utix/Ints.h>
+
+
+
+namespace xchip {
+class CpuManager;
+
+
+// A read-only memory image (fonts + ROM) shared by many CpuManagers.
+// Each CpuManager gets a private copy-on-write view of it, so only the
+// pages an instance writes to are materialized. Views are backed by
+// MAP_PRIVATE mappings on Linux/Mac and FILE_MAP_COPY views on Windows,
+// elsewhere they fall back to plain copies. The image must outlive
+// every CpuManager mapping it. Raw images are a power of two memory
+// followed by CpuManager::MEMORY_GUARD_SIZE zeroed bytes.
+class SharedImage
+{
+public:
+	SharedImage() noexcept;
+	~SharedImage();
+	SharedImage(const SharedImage&) = delete;
+	SharedImage& operator=(const SharedImage&) = delete;
+
+	bool Initialize(const CpuManager& source) noexcept;
+	bool Initialize(const uint8_t* data, const size_t size) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	bool IsShared() const;
+	size_t GetSize() const;
+	uint32_t GetCloneBase() const;
+	const uint8_t* GetData() const;
+
+	uint8_t* MapPrivate() const;
+	void UnmapPrivate(uint8_t* view) const;
+
+private:
+	#ifdef _WIN32
+	void* m_handle = nullptr;
+	#else
+	int m_fd = -1;
+	#endif
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	uint32_t m_cloneBase = 0;
+	bool m_shared = false;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool SharedImage::IsInitialized() const { return m_initialized; }
+inline bool SharedImage::IsShared() const { return m_shared; }
+inline size_t SharedImage::GetSize() const { return m_size; }
+inline uint32_t SharedImage::GetCloneBase() const { return m_cloneBase; }
+inline const uint8_t* SharedImage::GetData() const { return m_data; }
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_SHAREDIMAGE_H_
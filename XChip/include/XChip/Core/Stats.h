@@ -0,0 +1,140 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_STATS_H_
+#define XCHIP_CORE_STATS_H_
+
+#include <atomic>
+#include <Utix/Ints.h>
+
+
+
+namespace xchip {
+
+
+// Emulator performance counters. Rates and averages cover the last
+// StatsCollector::WINDOW, totals cover the whole run. Times in ms.
+struct EmulatorStats
+{
+	uint64_t instructions;
+	uint64_t idleInstructions;  // part of instructions, fast-forwarded idle loops
+	uint64_t framesPresented;
+	uint64_t framesSkipped;
+	uint64_t missedDeadlines;
+	double elapsedSecs;
+	double instrPerSec;
+	double targetInstrPerSec;
+	double framesPerSec;
+	double targetFps;
+	double avgFrameMs;
+	double p99FrameMs;
+	double avgSleepOvershootMs;
+	double maxSleepOvershootMs;
+	double avgDrawMs;
+	double avgEventsMs;
+};
+
+
+
+// Accumulates the Emulator counters on the emulation thread and
+// publishes an EmulatorStats snapshot once per window, checked on each
+// instruction slot, frame and Update(). The snapshot sits behind a 
+// sequence lock, so GetSnapshot() is safe and cheap to call from any 
+// thread. AddPresent() is the only counter safe from another thread,
+// the threaded mode's presentation thread.
+class StatsCollector
+{
+public:
+	static constexpr uint64_t WINDOW = 1000000000; // ns
+	static constexpr size_t MAX_FRAME_SAMPLES = 1024;
+
+	StatsCollector() noexcept;
+	StatsCollector(const StatsCollector&) = delete;
+	StatsCollector& operator=(const StatsCollector&) = delete;
+
+	void Reset();
+	void SetEnabled(const bool val);
+	bool IsEnabled() const;
+	EmulatorStats GetSnapshot() const;
+
+	void AddInstr(const uint64_t count = 1);
+	void AddIdle(const uint64_t count = 1);
+	void AddInstrSlot(const uint64_t now, const int targetHz);
+	void AddFrameSlot(const uint64_t now, const int targetFps);
+	void AddFrame(const uint64_t drawNs, const uint64_t now);
+	void AddSleep(const uint64_t askedNs, const uint64_t sleptNs);
+	void AddEvents(const uint64_t eventsNs);
+	void AddPresent(const uint64_t drawNs);
+	void Update(const uint64_t now);
+
+	static uint64_t Now();
+
+private:
+	void Publish(const uint64_t now);
+
+	uint64_t m_instrs = 0;
+	uint64_t m_idleInstrs = 0;
+	uint64_t m_framesPresented = 0;
+	uint64_t m_framesSkipped = 0;
+	uint64_t m_missedDeadlines = 0;
+	uint64_t m_startTime = 0;
+	uint64_t m_lastInstrSlot = 0;
+	uint64_t m_lastFrameSlot = 0;
+	uint64_t m_lastFrame = 0;
+
+	// current window
+	uint64_t m_windowStart = 0;
+	uint64_t m_windowInstrs = 0; // m_instrs when the window started
+	uint64_t m_windowFrames = 0;
+	uint64_t m_drawNs = 0;
+	uint64_t m_eventsNs = 0;
+	uint64_t m_eventsCount = 0;
+	uint64_t m_overshootNs = 0;
+	uint64_t m_maxOvershootNs = 0;
+	uint64_t m_sleepCount = 0;
+	uint32_t m_frameSamples[MAX_FRAME_SAMPLES];
+	size_t m_frameSamplesCount = 0;
+	int m_targetHz = 0;
+	int m_targetFps = 0;
+	bool m_enabled = false;
+
+	// drawn by the presentation thread
+	std::atomic<uint64_t> m_presentNs;
+	std::atomic<uint64_t> m_presentCount;
+
+	std::atomic<uint32_t> m_sequence;
+	EmulatorStats m_snapshot;
+};
+
+
+
+
+inline bool StatsCollector::IsEnabled() const { return m_enabled; }
+inline void StatsCollector::AddInstr(const uint64_t count) { m_instrs += count; }
+inline void StatsCollector::AddIdle(const uint64_t count) { m_idleInstrs += count; }
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_STATS_H_
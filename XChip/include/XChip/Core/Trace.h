@@ -0,0 +1,145 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_TRACE_H_
+#define XCHIP_CORE_TRACE_H_
+
+#include <atomic>
+#include <Utix/Ints.h>
+#include "CpuManager.h"
+#include "Instructions.h"
+
+
+
+namespace xchip {
+
+
+// one executed instruction. vx and vf are read after it ran,
+// X being the opcode's second nibble: together they hold the
+// register any CHIP-8 instruction may have changed.
+struct TraceRecord
+{
+	uint32_t cycle;
+	uint16_t pc;
+	uint16_t opcode;
+	uint16_t I;
+	uint8_t vx;
+	uint8_t vf;
+};
+
+
+
+// trace file: a TraceHeader followed by 'count' TraceRecords, oldest first.
+// records only keep the low 32 bits of the cycle, lastCycle has the full
+// value of the newest record so a decoder can rebuild the others.
+struct TraceHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t count;
+	uint64_t lastCycle;
+};
+
+
+
+
+// A fixed size ring of the last executed instructions. The emulation
+// thread is the only writer, Dump() may run on any thread: it copies
+// the ring and drops the records overwritten while it was copying.
+class TraceBuffer
+{
+public:
+	static constexpr char MAGIC[8] = { 'X', 'C', 'H', 'I', 'P', 'T', 'R', 'C' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t DEFAULT_CAPACITY = 0x10000;
+
+	TraceBuffer() noexcept;
+	~TraceBuffer();
+	TraceBuffer(const TraceBuffer&) = delete;
+	TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+	bool Initialize(const size_t capacity = DEFAULT_CAPACITY) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	size_t GetCapacity() const;
+	uint64_t GetCycle() const;
+	bool Dump(const char* fileName) const;
+
+	void Execute(CpuManager& cpuMan);
+	void Record(const CpuManager& cpuMan, const uint16_t pc);
+
+	// the buffer dumped by DumpCrash(), called on unknown opcodes 
+	// and, by the application, on fatal signals. 'machine' is the 
+	// CpuManager this buffer traces: the unknown opcodes of any other
+	// (lockstep lanes, clones, other emulators) are not dumped. 'current'
+	// is the CpuManager in the middle of an instruction, if any.
+	void SetCrashDump(const char* fileName, const CpuManager& machine);
+	static bool DumpCrash(const CpuManager* current = nullptr);
+
+private:
+	TraceRecord* m_records = nullptr;
+	size_t m_mask = 0;
+	std::atomic<uint64_t> m_head;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool TraceBuffer::IsInitialized() const { return m_initialized; }
+inline size_t TraceBuffer::GetCapacity() const { return m_mask + 1; }
+inline uint64_t TraceBuffer::GetCycle() const { return m_head.load(std::memory_order_relaxed); }
+
+
+inline void TraceBuffer::Execute(CpuManager& cpuMan)
+{
+	const auto pc = static_cast<uint16_t>(cpuMan.GetPC());
+	instructions::ExecuteInstruction(cpuMan);
+	Record(cpuMan, pc);
+}
+
+
+inline void TraceBuffer::Record(const CpuManager& cpuMan, const uint16_t pc)
+{
+	const auto head = m_head.load(std::memory_order_relaxed);
+	const auto opcode = cpuMan.GetOpcode();
+	const auto* const registers = cpuMan.GetRegisters();
+
+	auto& record = m_records[head & m_mask];
+	record.cycle = static_cast<uint32_t>(head);
+	record.pc = pc;
+	record.opcode = opcode;
+	record.I = static_cast<uint16_t>(cpuMan.GetIndexRegister());
+	record.vx = registers[(opcode >> 8) & 0xF];
+	record.vf = registers[0xF];
+
+	// publish, Dump() reads the head with acquire
+	m_head.store(head + 1, std::memory_order_release);
+}
+
+
+
+
+}
+
+
+
+#endif // XCHIP_CORE_TRACE_H_
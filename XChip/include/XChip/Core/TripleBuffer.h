@@ -0,0 +1,106 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_CORE_TRIPLEBUFFER_H_
+#define XCHIP_CORE_TRIPLEBUFFER_H_
+
+#include <atomic>
+#include <Utix/Ints.h>
+#include <Utix/Vector2.h>
+
+
+
+namespace xchip {
+
+
+// a finished frame: palette indexed pixels and the resolution they are in.
+// number counts the published frames, so gaps show the dropped ones.
+struct Frame
+{
+	uint8_t* pixels;
+	utix::Vec2i res;
+	uint64_t number;
+};
+
+
+
+
+// Hands frames from one producer thread to one consumer thread, lock 
+// free. Each side owns one of the three frames and the third is the
+// last published; Publish() and Acquire() swap their own with it. The
+// producer never waits: frames not acquired in time are replaced.
+class TripleBuffer
+{
+public:
+	TripleBuffer() noexcept;
+	~TripleBuffer();
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	bool Initialize(const size_t maxPixels) noexcept;
+	void Dispose() noexcept;
+	bool IsInitialized() const;
+	size_t GetMaxPixels() const;
+
+	// producer
+	Frame& GetBack();
+	void Publish();
+
+	// consumer: the newest frame, nullptr when none was published since
+	const Frame* Acquire();
+
+private:
+	enum : uint8_t
+	{
+		INDEX_MASK = 0x03,
+		FRESH = 0x04
+	};
+
+	Frame m_frames[3];
+	uint8_t* m_pixels = nullptr;
+	size_t m_maxPixels = 0;
+	std::atomic<uint8_t> m_middle;
+	uint8_t m_back = 0;
+	uint8_t m_front = 1;
+	uint64_t m_published = 0;
+	bool m_initialized = false;
+};
+
+
+
+
+inline bool TripleBuffer::IsInitialized() const { return m_initialized; }
+inline size_t TripleBuffer::GetMaxPixels() const { return m_maxPixels; }
+inline Frame& TripleBuffer::GetBack() { return m_frames[m_back]; }
+
+
+
+
+}
+
+
+
+
+
+
+
+
+
+#endif // XCHIP_CORE_TRIPLEBUFFER_H_
@@ -43,12 +43,11 @@ public:
 	const char* GetPluginVersion() const noexcept override;
 	PluginDeleter GetPluginDeleter() const noexcept override;
 	bool IsKeyPressed(const Key key) const noexcept override;
+	uint16_t GetKeyMask() const noexcept override;
 
 	bool UpdateKeys() noexcept override;
-	Key WaitKeyPress() noexcept override;
 
 	void SetMiddleScreen(const int middleScreen) noexcept { m_middleScreen = middleScreen; }
-	void SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept override;
 	void SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept override;
 	void SetEscapeKeyCallback(const void* arg, EscapeKeyCallback callback) noexcept override;
 
@@ -56,10 +55,8 @@ private:
 	enum { LEFT = 1, RIGHT };
 	uint8_t m_direction = 0;
 	int m_middleScreen = 32;
-	WaitKeyCallback m_waitClbk = nullptr;
 	ResetKeyCallback m_resetClbk = nullptr;
 	EscapeKeyCallback m_escapeClbk = nullptr;
-	const void* m_waitClbkArg;
 	const void* m_resetClbkArg;
 	const void* m_escapeClbkArg;
 	bool m_initialized = false;
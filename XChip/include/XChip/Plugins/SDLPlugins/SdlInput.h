@@ -47,24 +47,24 @@ public:
 	const char* GetPluginVersion() const noexcept override;
 	PluginDeleter GetPluginDeleter() const noexcept override;
 	bool IsKeyPressed(const Key key) const noexcept override;
+	uint16_t GetKeyMask() const noexcept override;
 
 	bool UpdateKeys() noexcept override;
-	Key WaitKeyPress() noexcept override;
 
-	void SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept override;
 	void SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept override;
 	void SetEscapeKeyCallback(const void* arg, EscapeKeyCallback callback) noexcept override;
 
 private:
+	static int SDLCALL OnEvent(void* sdlinput, SDL_Event* event);
+	enum SystemKeys : uint8_t { SYS_RESET = 0x1, SYS_ESCAPE = 0x2 };
 	struct KeyPair { Key chip8Key; SDL_Scancode sdlKey; };
 	utix::Vector<KeyPair> m_keyPairs;
-	const unsigned char* m_keyboardState = nullptr;
-	WaitKeyCallback m_waitClbk = nullptr;
 	ResetKeyCallback m_resetClbk = nullptr;
 	EscapeKeyCallback m_escapeClbk = nullptr;
-	const void* m_waitClbkArg;
 	const void* m_resetClbkArg;
 	const void* m_escapeClbkArg;
+	uint16_t m_keyMask = 0;
+	uint8_t m_systemKeys = 0;
 	bool m_initialized = false;
 
 };
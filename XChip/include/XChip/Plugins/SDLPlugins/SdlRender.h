@@ -47,20 +47,23 @@ public:
 	const char* GetPluginVersion() const noexcept override;
 	PluginDeleter GetPluginDeleter() const noexcept override;
 	const char* GetWindowName() const noexcept override;
-	const uint32_t* GetBuffer() const noexcept override;
+	const uint8_t* GetBuffer() const noexcept override;
 	utix::Color GetDrawColor() const noexcept override;
 	utix::Color GetBackgroundColor() const noexcept override;
+	utix::Color GetPaletteColor(const uint8_t index) const noexcept override;
 	utix::Vec2i GetResolution() const noexcept override;
 	utix::Vec2i GetWindowSize() const noexcept override;
 	utix::Vec2i GetWindowPosition() const noexcept override;
 
 	void SetWindowName(const char* name) noexcept override;
-	void SetBuffer(const uint32_t* gfx) noexcept override;
+	void SetBuffer(const uint8_t* gfx) noexcept override;
 	bool SetResolution(const utix::Vec2i& res) noexcept override;
+	bool ReserveResolution(const utix::Vec2i& res) noexcept override;
 	void SetWindowSize(const utix::Vec2i& size) noexcept override;
 	void SetWindowPosition(const utix::Vec2i& pos) noexcept override;
 	bool SetDrawColor(const utix::Color& color) noexcept override;
 	bool SetBackgroundColor(const utix::Color& color) noexcept override;
+	bool SetPaletteColor(const uint8_t index, const utix::Color& color) noexcept override;
 	bool SetFullScreen(const bool option) noexcept override;
 	bool UpdateEvents() noexcept override;
 	void DrawBuffer() noexcept override;
@@ -71,12 +74,19 @@ public:
 	void SetWinResizeCallback(const void* arg, WinResizeCallback callback) noexcept override;
 
 private:
-	bool CreateTexture(const int w, const int h);
+	SDL_Texture* CreateTexture(const utix::Vec2i& res);
+	int FindTexture(const utix::Vec2i& res) const;
 	SDL_Event m_sdlevent;
 	SDL_Window* m_window = nullptr;
 	SDL_Renderer* m_rend = nullptr;
 	SDL_Texture* m_texture = nullptr;
-	const uint32_t* m_buffer = nullptr;
+	// one texture per reserved resolution, m_texture is one of them
+	SDL_Texture* m_textures[2] { nullptr, nullptr };
+	utix::Vec2i m_texturesRes[2] { {0, 0}, {0, 0} };
+	utix::Vec2i m_res { 0, 0 };
+	const uint8_t* m_buffer = nullptr;
+	// RGBA8888 texture pixels: black, white, light grey, dark grey
+	uint32_t m_palette[PALETTE_SIZE] { 0x000000ff, 0xffffffff, 0xaaaaaaff, 0x555555ff };
 	WinCloseCallback m_closeClbk = nullptr;
 	WinResizeCallback m_resizeClbk = nullptr;
 	const void* m_closeClbkArg;
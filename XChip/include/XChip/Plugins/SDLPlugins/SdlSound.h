@@ -21,6 +21,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #ifndef XCHIP_PLUGINS_SDLSOUND_H_
 #define XCHIP_PLUGINS_SDLSOUND_H_
 
+#include <atomic>
 #include <SDL2/SDL.h>
 #include <Utix/Ints.h>
 #include <XChip/Plugins/iSound.h>
@@ -36,6 +37,11 @@ class SdlSound final : public iSound
 	static constexpr const char* const PLUGIN_NAME = "SdlSound";
 	static constexpr const char* const PLUGIN_VER = "1.0 using SDL2";
 	static constexpr float DEFAULT_FREQ = 450;
+	static constexpr int RAMP_SAMPLES = 64;
+	static constexpr size_t WAVETABLE_SIZE = 1024;
+	static constexpr int WAVETABLE_SHIFT = 22; // 32 bits phase to the table index
+	static constexpr size_t PATTERN_BITS = 128;
+	static constexpr int PATTERN_SHIFT = 25;
 public:
 	SdlSound() noexcept;
 	~SdlSound();
@@ -51,33 +57,47 @@ public:
 	float GetSoundFreq() const noexcept override;
 	void SetCountdownFreq(const float hertz) noexcept override;
 	void SetSoundFreq(const float hz) noexcept override;
-	void Play(const uint8_t soundTimer) noexcept override;
+	void Tick(const uint8_t soundTimer) noexcept override;
+	void SetPattern(const uint8_t* pattern, const uint8_t pitch) noexcept override;
 	void Stop() noexcept override;
 
 
 
 private:
-	float GetPlayFreq() const;
 	float GetCurFreq() const;
-	void SetPlayFreq(const float hz);
 	void SetCurFreq(const float hz);
 	void SetCycleTime(const float hz);
-	void SetLenght(const unsigned int len);
+	void RenderBlock(size_t write, size_t count, const int32_t gainStep);
 
 	bool OpenAudioDevice();
 	void CloseAudioDevice();
-	template<class T>
 	static void audio_callback(void* userdata, uint8_t* stream, int len) noexcept;
 
 
 	SDL_AudioSpec* m_specs = nullptr;
 	SDL_AudioDeviceID m_dev = 0;
 	float m_cycleTime;
-	float m_playFreq;
 	float m_curFreq;
-	float m_len;
-	unsigned int m_pos;
+	float m_tickRemain;
+	uint32_t m_phase;
+	uint32_t m_phaseStep;
+	uint32_t m_patternStep;
+	int32_t m_gain; // 16.16 fixed point amplitude
 	int m_amplitude;
+	int m_tableShift;
+	const Sint16* m_table; // m_wavetable or m_pattern
+	Sint16 m_wavetable[WAVETABLE_SIZE];
+	Sint16 m_pattern[PATTERN_BITS];
+
+	// single producer (Tick) single consumer (audio_callback) ring,
+	// the indexes only grow and are masked on access.
+	Sint16* m_ring = nullptr;
+	size_t m_ringMask = 0;
+	size_t m_maxQueued = 0;
+	std::atomic<size_t> m_write;
+	std::atomic<size_t> m_read;
+	std::atomic<bool> m_flush;
+	std::atomic<bool> m_playing;
 	bool m_initialized = false;
 	enum SpecsID { WANT, HAVE };
 };
@@ -44,22 +44,20 @@ public:
 	PluginDeleter GetPluginDeleter() const noexcept override;
 
 	bool IsKeyPressed(const Key key) const noexcept override;
+	uint16_t GetKeyMask() const noexcept override;
 	bool UpdateKeys() noexcept override;
-	Key WaitKeyPress() noexcept override;
 	
 	
-	void SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept override;
 	void SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept override;
 	void SetEscapeKeyCallback(const void* arg, EscapeKeyCallback callback) noexcept override;
 private:
 	struct KeyPair { Key chip8Key; sf::Keyboard::Key sfKey; };
 	utix::Vector<KeyPair> m_keyPairs;
-	const void* m_waitArg = nullptr;
 	const void* m_resetArg = nullptr;
 	const void* m_escapeArg = nullptr;
-	WaitKeyCallback m_waitCallback = nullptr;
 	ResetKeyCallback m_resetCallback = nullptr;
 	EscapeKeyCallback m_escapeCallback = nullptr;
+	uint16_t m_keyMask = 0;
 	bool m_initialized = false;
 };
 
@@ -24,7 +24,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #define XCHIP_PLUGINS_UNIQUEPLUGIN_H_
 
 #include "iPlugin.h"
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 #include <Utix/DLoader.h>
 #endif
 #include <Utix/Log.h>
@@ -34,7 +34,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 
 namespace xchip {
 
-// NOTE: Android version does not use plugins as shared library yet
+// NOTE: with XCHIP_STATIC_PLUGINS, Load takes the plugin object and Free deletes it
 template<class T>
 class UniquePlugin
 {
@@ -60,7 +60,7 @@ public:
 	T* get();
 	T* operator->();
 
-	#ifndef __ANDROID__
+	#ifndef XCHIP_STATIC_PLUGINS
 	bool Load(const std::string& dlPath);
 	#else
 	bool Load(T* const plugin);
@@ -71,13 +71,13 @@ public:
 
 
 private:
-	#ifndef __ANDROID__
+	#ifndef XCHIP_STATIC_PLUGINS
 	utix::DLoader m_dloader;
 	#endif
 	T* m_plugin = nullptr;
 };
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 inline void call_deleter(utix::DLoader&, iPlugin*) noexcept;
 #endif
 
@@ -92,7 +92,7 @@ inline UniquePlugin<T>::UniquePlugin(const nullptr_t)
 template<class T>
 inline UniquePlugin<T>::UniquePlugin(UniquePlugin&& rhs) noexcept
 	:  
-	#ifndef __ANDROID__
+	#ifndef XCHIP_STATIC_PLUGINS
 	m_dloader(std::move(rhs.m_dloader)),
 	#endif
 	m_plugin(rhs.m_plugin)
@@ -186,7 +186,7 @@ inline T* UniquePlugin<T>::get()
 
 
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 
 template<class T>
 bool UniquePlugin<T>::Load(const std::string& dlPath)
@@ -320,7 +320,7 @@ void UniquePlugin<T>::Swap(UniquePlugin& other) noexcept
 }
 
 
-#endif // __ANDROID__
+#endif // XCHIP_STATIC_PLUGINS
 
 
 
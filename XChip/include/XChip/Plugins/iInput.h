@@ -52,17 +52,15 @@ enum class Key : uint8_t
 class iInput : public iPlugin
 {
 public:
-	using WaitKeyCallback = bool(*)(const void*);
 	using ResetKeyCallback = void(*)(const void*);
 	using EscapeKeyCallback = void(*)(const void*);
 
 	virtual bool Initialize() noexcept = 0;
 	virtual bool IsKeyPressed(const Key key) const noexcept = 0;
+	virtual uint16_t GetKeyMask() const noexcept = 0; // bit N is set while KEY_N is down
 	virtual bool UpdateKeys() noexcept = 0;
-	virtual Key WaitKeyPress() noexcept = 0;
 	
 	
-	virtual void SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept = 0;
 	virtual void SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept = 0;
 	virtual void SetEscapeKeyCallback(const void* arg, EscapeKeyCallback callback) noexcept = 0;
 };
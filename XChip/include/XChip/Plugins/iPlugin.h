@@ -35,6 +35,14 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #define XCHIP_FREE_PLUGIN_SYM "XCHIP_FreePlugin"
 
 
+// plugins linked into the executable: UniquePlugin takes an object
+// instead of a shared library path, and the plugins don't export
+// the loader symbols. Android has no shared library plugins yet.
+#if defined(__ANDROID__) && !defined(XCHIP_STATIC_PLUGINS)
+#define XCHIP_STATIC_PLUGINS
+#endif
+
+
 namespace xchip {
 
 
@@ -29,31 +29,39 @@ namespace xchip {
 
 
 
+// the buffer holds one palette index per pixel, composed from the gfx planes. 
+// the draw color is palette index 1 and the background color is index 0.
+// ReserveResolution prepares a resolution ahead, so a later SetResolution 
+// to it only swaps what is in use. At least two resolutions are kept.
 class iRender : public iPlugin
 {
 public:
 	using WinCloseCallback = void(*)(const void*);
 	using WinResizeCallback = void(*)(const void*);
+	static constexpr uint8_t PALETTE_SIZE = 4;
 
 	virtual bool Initialize(const utix::Vec2i& winSize, const utix::Vec2i& resolution) noexcept = 0;
 	
 	virtual const char* GetWindowName() const noexcept = 0;
-	virtual const uint32_t* GetBuffer() const noexcept = 0;
+	virtual const uint8_t* GetBuffer() const noexcept = 0;
 	virtual utix::Vec2i GetResolution() const noexcept = 0;
 	virtual utix::Vec2i GetWindowSize() const noexcept = 0;
 	virtual utix::Vec2i GetWindowPosition() const noexcept = 0;
 	virtual utix::Color GetDrawColor() const noexcept = 0;
 	virtual utix::Color GetBackgroundColor() const noexcept = 0;
+	virtual utix::Color GetPaletteColor(const uint8_t index) const noexcept = 0;
 
 	virtual bool UpdateEvents() noexcept = 0;
 	virtual void SetWindowName(const char* name) noexcept = 0;
 	virtual bool SetResolution(const utix::Vec2i& res) noexcept = 0;
+	virtual bool ReserveResolution(const utix::Vec2i& res) noexcept = 0;
 	virtual void SetWindowSize(const utix::Vec2i& size) noexcept = 0;
 	virtual void SetWindowPosition(const utix::Vec2i& pos) noexcept = 0;
 	virtual bool SetDrawColor(const utix::Color& color) noexcept = 0;
 	virtual bool SetBackgroundColor(const utix::Color& color) noexcept = 0;
+	virtual bool SetPaletteColor(const uint8_t index, const utix::Color& color) noexcept = 0;
 	virtual bool SetFullScreen(const bool option) noexcept = 0;
-	virtual void SetBuffer(const uint32_t* gfx) noexcept = 0;
+	virtual void SetBuffer(const uint8_t* gfx) noexcept = 0;
 	virtual void DrawBuffer() noexcept = 0;
 	virtual void HideWindow() noexcept = 0;
 	virtual void ShowWindow() noexcept = 0;
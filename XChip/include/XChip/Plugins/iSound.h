@@ -37,7 +37,14 @@ public:
 	virtual float GetSoundFreq() const noexcept = 0;
 	virtual void SetCountdownFreq(const float hz) noexcept = 0;
 	virtual void SetSoundFreq(const float hz) noexcept = 0;
-	virtual void Play(const uint8_t soundTimer) noexcept = 0;
+	// called once per emulated countdown tick, with the sound timer
+	// before it counts down: the tone sounds for the tick while it is not 0.
+	// Runs on the emulation thread and must never block.
+	virtual void Tick(const uint8_t soundTimer) noexcept = 0;
+	// XO-Chip: the next ticks play this 128 bits pattern in a loop, 
+	// at 4000 * 2^((pitch - 64) / 48) bits per second. nullptr goes 
+	// back to the plain tone. The pattern is copied.
+	virtual void SetPattern(const uint8_t* pattern, const uint8_t pitch) noexcept = 0;
 	virtual void Stop() noexcept = 0;
 
 
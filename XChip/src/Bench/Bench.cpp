@@ -0,0 +1,744 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/CliOpts.h>
+
+#include <XChip/Core/CpuManager.h>
+#include <XChip/Core/Instructions.h>
+#include <XChip/Core/Lockstep.h>
+
+
+
+/*******************************************************************************************
+ *	XChipBench micro-benchmarks for the Core hot paths
+ *	-FILTER   only run the benchmarks whose name contains this string
+ *	-REPS     timed repetitions per benchmark, default 15
+ *	-WARMUP   untimed repetitions before measuring, default 3
+ *	-MINTIME  minimum milliseconds of a single repetition, default 10
+ *	-FORMAT   text, csv or json. default text
+ *	-ROM      also benchmark LoadRom from this file
+ *	-OUT      write the results to this file instead of stdout
+ *
+ *	every repetition runs the same batch of operations, the batch size is
+ *	calibrated once so a repetition takes at least -MINTIME. Results are
+ *	in nanoseconds per operation. "loop" measures the harness itself
+ *	(resetting PC around an ExecuteInstruction call), subtract it from the
+ *	instruction benchmarks to get the handler cost alone. Core logs go to
+ *	stdout too, use -OUT to keep csv and json results clean.
+ *	"lockstep/" benchmarks run LOCKSTEP_LANES CpuManagers, one operation is
+ *	one instruction on every lane, either through the LockstepRunner or
+ *	lane after lane on the instruction tables.
+ *******************************************************************************************/
+
+
+
+
+
+namespace {
+using xchip::CpuManager;
+using Clock = std::chrono::steady_clock;
+
+struct Config
+{
+	std::string filter;
+	std::string format = "text";
+	std::string romPath;
+	std::string outPath;
+	int reps = 15;
+	int warmup = 3;
+	double minTimeNs = 10e6;
+};
+
+
+struct Result
+{
+	const char* name;
+	uint64_t batch;
+	int reps;
+	double minNs;
+	double medianNs;
+	double meanNs;
+	double stddevNs;
+};
+
+
+// a benchmark runs 'count' operations on the given CpuManager
+using BenchFunc = void(*)(CpuManager& cpuMan, uint64_t count);
+using SetupFunc = bool(*)(CpuManager& cpuMan);
+
+struct Benchmark
+{
+	const char* name;
+	SetupFunc setup;
+	BenchFunc run;
+};
+
+
+
+bool ParseConfig(const utix::CliOpts& opts, Config& config);
+bool SetupLoRes(CpuManager& cpuMan);
+bool SetupHiRes(CpuManager& cpuMan);
+bool SetupLockstepAlu(CpuManager& cpuMan);
+bool SetupLockstepBranch(CpuManager& cpuMan);
+bool SetupLockstep(const uint16_t* program, const size_t size);
+double Elapsed(const Benchmark& bench, CpuManager& cpuMan, const uint64_t batch);
+Result Measure(const Benchmark& bench, const Config& config, CpuManager& cpuMan);
+void PrintHeader(FILE* out, const Config& config);
+void PrintResult(FILE* out, const Config& config, const Result& result, const bool last);
+void PrintFooter(FILE* out, const Config& config);
+}
+
+
+
+
+namespace benchs {
+void loop(CpuManager& cpuMan, uint64_t count);
+void alu_6XNN(CpuManager& cpuMan, uint64_t count);
+void alu_7XNN(CpuManager& cpuMan, uint64_t count);
+void alu_8XY4(CpuManager& cpuMan, uint64_t count);
+void alu_8XYE(CpuManager& cpuMan, uint64_t count);
+void skip_3XNN(CpuManager& cpuMan, uint64_t count);
+void skip_5XY0(CpuManager& cpuMan, uint64_t count);
+void flow_1NNN(CpuManager& cpuMan, uint64_t count);
+void flow_2NNN_00EE(CpuManager& cpuMan, uint64_t count);
+void flow_BNNN(CpuManager& cpuMan, uint64_t count);
+void mem_ANNN(CpuManager& cpuMan, uint64_t count);
+void mem_FX1E(CpuManager& cpuMan, uint64_t count);
+void mem_FX33(CpuManager& cpuMan, uint64_t count);
+void mem_FX55(CpuManager& cpuMan, uint64_t count);
+void mem_FX65(CpuManager& cpuMan, uint64_t count);
+void mem_5XY2(CpuManager& cpuMan, uint64_t count);
+void mem_5XY3(CpuManager& cpuMan, uint64_t count);
+void rand_CXNN(CpuManager& cpuMan, uint64_t count);
+void gfx_00E0(CpuManager& cpuMan, uint64_t count);
+void gfx_DXYN_lores(CpuManager& cpuMan, uint64_t count);
+void gfx_DXYN_lores_wrap(CpuManager& cpuMan, uint64_t count);
+void gfx_DXY0_schip(CpuManager& cpuMan, uint64_t count);
+void gfx_DXYN_planes(CpuManager& cpuMan, uint64_t count);
+void gfx_00CN(CpuManager& cpuMan, uint64_t count);
+void gfx_00FB(CpuManager& cpuMan, uint64_t count);
+void gfx_00FC(CpuManager& cpuMan, uint64_t count);
+void gfx_00FE_00FF(CpuManager& cpuMan, uint64_t count);
+void conv_compose(CpuManager& cpuMan, uint64_t count);
+void conv_palette_hires(CpuManager& cpuMan, uint64_t count);
+void load_rom_memory(CpuManager& cpuMan, uint64_t count);
+void load_rom_file(CpuManager& cpuMan, uint64_t count);
+void lockstep_scalar(CpuManager& cpuMan, uint64_t count);
+void lockstep_runner(CpuManager& cpuMan, uint64_t count);
+}
+
+
+
+
+const Benchmark benchmarks[] =
+{
+	{ "loop",                   SetupLoRes,          benchs::loop },
+	{ "instr/6XNN",             SetupLoRes,          benchs::alu_6XNN },
+	{ "instr/7XNN",             SetupLoRes,          benchs::alu_7XNN },
+	{ "instr/8XY4",             SetupLoRes,          benchs::alu_8XY4 },
+	{ "instr/8XYE",             SetupLoRes,          benchs::alu_8XYE },
+	{ "instr/3XNN",             SetupLoRes,          benchs::skip_3XNN },
+	{ "instr/5XY0",             SetupLoRes,          benchs::skip_5XY0 },
+	{ "instr/1NNN",             SetupLoRes,          benchs::flow_1NNN },
+	{ "instr/2NNN+00EE",        SetupLoRes,          benchs::flow_2NNN_00EE },
+	{ "instr/BNNN",             SetupLoRes,          benchs::flow_BNNN },
+	{ "instr/ANNN",             SetupLoRes,          benchs::mem_ANNN },
+	{ "instr/FX1E",             SetupLoRes,          benchs::mem_FX1E },
+	{ "instr/FX33",             SetupLoRes,          benchs::mem_FX33 },
+	{ "instr/FX55",             SetupLoRes,          benchs::mem_FX55 },
+	{ "instr/FX65",             SetupLoRes,          benchs::mem_FX65 },
+	{ "instr/5XY2",             SetupLoRes,          benchs::mem_5XY2 },
+	{ "instr/5XY3",             SetupLoRes,          benchs::mem_5XY3 },
+	{ "instr/CXNN",             SetupLoRes,          benchs::rand_CXNN },
+	{ "gfx/00E0",               SetupLoRes,          benchs::gfx_00E0 },
+	{ "gfx/DXYN-lores",         SetupLoRes,          benchs::gfx_DXYN_lores },
+	{ "gfx/DXYN-lores-wrap",    SetupLoRes,          benchs::gfx_DXYN_lores_wrap },
+	{ "gfx/DXY0-schip16",       SetupHiRes,          benchs::gfx_DXY0_schip },
+	{ "gfx/DXYN-2planes",       SetupHiRes,          benchs::gfx_DXYN_planes },
+	{ "gfx/00CN",               SetupHiRes,          benchs::gfx_00CN },
+	{ "gfx/00FB",               SetupHiRes,          benchs::gfx_00FB },
+	{ "gfx/00FC",               SetupHiRes,          benchs::gfx_00FC },
+	{ "gfx/00FE+00FF",          SetupHiRes,          benchs::gfx_00FE_00FF },
+	{ "conv/compose-64x32",     SetupLoRes,          benchs::conv_compose },
+	{ "conv/compose-128x64",    SetupHiRes,          benchs::conv_compose },
+	{ "conv/palette-128x64",    SetupHiRes,          benchs::conv_palette_hires },
+	{ "rom/load-memory",        SetupLoRes,          benchs::load_rom_memory },
+	{ "rom/load-file",          SetupLoRes,          benchs::load_rom_file },
+	{ "lockstep/alu-scalar",    SetupLockstepAlu,    benchs::lockstep_scalar },
+	{ "lockstep/alu-runner",    SetupLockstepAlu,    benchs::lockstep_runner },
+	{ "lockstep/branch-scalar", SetupLockstepBranch, benchs::lockstep_scalar },
+	{ "lockstep/branch-runner", SetupLockstepBranch, benchs::lockstep_runner }
+};
+
+
+constexpr size_t LOCKSTEP_LANES = 64;
+
+Config g_config;
+CpuManager g_lanes[LOCKSTEP_LANES];
+xchip::LockstepRunner g_lockstep;
+
+
+
+
+int main(int argc, char** argv)
+{
+	const utix::CliOpts opts(argc - 1, argv + 1);
+	if (!ParseConfig(opts, g_config))
+	{
+		fprintf(stderr, "Usage: %s [-FILTER name] [-REPS n] [-WARMUP n] [-MINTIME ms] "
+		                "[-FORMAT text|csv|json] [-ROM file] [-OUT file]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Result> results;
+
+	for (const auto& bench : benchmarks)
+	{
+		if (!g_config.filter.empty() && strstr(bench.name, g_config.filter.c_str()) == nullptr)
+			continue;
+
+		if (bench.run == benchs::load_rom_file && g_config.romPath.empty())
+			continue;
+
+		CpuManager cpuMan;
+		if (!bench.setup(cpuMan))
+		{
+			utix::LogError("XChipBench: could not set up \'%s\': %s", bench.name, utix::GetLastLogError().c_str());
+			return EXIT_FAILURE;
+		}
+
+		results.push_back(Measure(bench, g_config, cpuMan));
+	}
+
+	FILE* const out = g_config.outPath.empty() ? stdout : fopen(g_config.outPath.c_str(), "w");
+	if (!out)
+	{
+		utix::LogError("XChipBench: could not open '%s'", g_config.outPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	PrintHeader(out, g_config);
+	for (size_t i = 0; i < results.size(); ++i)
+		PrintResult(out, g_config, results[i], (i + 1) == results.size());
+	PrintFooter(out, g_config);
+
+	if (out != stdout)
+		fclose(out);
+
+	return EXIT_SUCCESS;
+}
+
+
+
+
+
+
+
+
+
+
+namespace {
+
+
+bool ParseConfig(const utix::CliOpts& opts, Config& config)
+{
+	config.filter = opts.GetOpt("-FILTER");
+	config.romPath = opts.GetOpt("-ROM");
+	config.outPath = opts.GetOpt("-OUT");
+
+	const auto format = opts.GetOpt("-FORMAT");
+	if (!format.empty())
+		config.format = format;
+
+	const auto reps = opts.GetOpt("-REPS");
+	if (!reps.empty())
+		config.reps = std::atoi(reps.c_str());
+
+	const auto warmup = opts.GetOpt("-WARMUP");
+	if (!warmup.empty())
+		config.warmup = std::atoi(warmup.c_str());
+
+	const auto minTime = opts.GetOpt("-MINTIME");
+	if (!minTime.empty())
+		config.minTimeNs = std::atof(minTime.c_str()) * 1e6;
+
+	return config.reps > 0 && config.warmup >= 0 && config.minTimeNs > 0
+		&& (config.format == "text" || config.format == "csv" || config.format == "json");
+}
+
+
+
+
+bool SetupLoRes(CpuManager& cpuMan)
+{
+	// same layout Emulator uses, no plugins are needed by
+	// the instructions benchmarked here.
+	if (cpuMan.SetMemory(CpuManager::MAX_MEMORY_SIZE)
+		&& cpuMan.SetRegisters(0x10)
+		&& cpuMan.SetStack(0x10)
+		&& cpuMan.SetGfxModes({64, 32}, {128, 64}))
+	{
+		cpuMan.LoadDefaultFont();
+		cpuMan.LoadHiResFont();
+		cpuMan.CleanGfx();
+		cpuMan.SetPC(0x200);
+		return true;
+	}
+
+	return false;
+}
+
+
+
+bool SetupHiRes(CpuManager& cpuMan)
+{
+	if (!SetupLoRes(cpuMan))
+		return false;
+
+	cpuMan.SetExtendedGfx(true);
+	return true;
+}
+
+
+
+
+bool SetupLockstepAlu(CpuManager& cpuMan)
+{
+	// every lane on the same path, VB differs per lane
+	const uint16_t program[] = { 0x7A01, 0x8AB4, 0x8AB1, 0x8AB6, 0x1200 };
+	return SetupLoRes(cpuMan) && SetupLockstep(program, utix::arr_size(program));
+}
+
+
+
+bool SetupLockstepBranch(CpuManager& cpuMan)
+{
+	// VC = VA & 1 decides a skip, so the lanes split in two
+	// groups every iteration and merge again at the 1200 jump
+	const uint16_t program[] = { 0x7A01, 0x6C01, 0x8CA2, 0x3C00, 0x7B01, 0x1200 };
+	return SetupLoRes(cpuMan) && SetupLockstep(program, utix::arr_size(program));
+}
+
+
+
+bool SetupLockstep(const uint16_t* program, const size_t size)
+{
+	// the runner writes its registers back on Dispose, before the lanes are reset
+	g_lockstep.Dispose();
+
+	CpuManager* lanes[LOCKSTEP_LANES];
+	for (size_t i = 0; i < LOCKSTEP_LANES; ++i)
+	{
+		CpuManager& lane = g_lanes[i];
+		if (!SetupLoRes(lane))
+			return false;
+
+		uint8_t* const memory = lane.GetMemory() + 0x200;
+		for (size_t j = 0; j < size; ++j)
+		{
+			memory[j * 2] = program[j] >> 8;
+			memory[(j * 2) + 1] = program[j] & 0xFF;
+		}
+
+		lane.GetRegisters(0xA) = static_cast<uint8_t>(i);
+		lane.GetRegisters(0xB) = static_cast<uint8_t>(i * 3);
+		lanes[i] = &lane;
+	}
+
+	return g_lockstep.Initialize(lanes, LOCKSTEP_LANES);
+}
+
+
+
+
+double Elapsed(const Benchmark& bench, CpuManager& cpuMan, const uint64_t batch)
+{
+	const auto begin = Clock::now();
+	bench.run(cpuMan, batch);
+	const auto end = Clock::now();
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+}
+
+
+
+
+Result Measure(const Benchmark& bench, const Config& config, CpuManager& cpuMan)
+{
+	// grow the batch until one repetition is long enough to
+	// drown the clock resolution and call overhead
+	uint64_t batch = 1;
+	for (double ns = Elapsed(bench, cpuMan, batch); ns < config.minTimeNs; ns = Elapsed(bench, cpuMan, batch))
+	{
+		const double scale = ns > 0 ? (config.minTimeNs / ns) * 1.2 : 10.0;
+		batch = static_cast<uint64_t>(batch * std::min(std::max(scale, 2.0), 10.0));
+	}
+
+	for (int i = 0; i < config.warmup; ++i)
+		Elapsed(bench, cpuMan, batch);
+
+	std::vector<double> samples(config.reps);
+	for (auto& sample : samples)
+		sample = Elapsed(bench, cpuMan, batch) / batch;
+
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0;
+	for (const auto sample : samples)
+		sum += sample;
+
+	const double mean = sum / samples.size();
+	double variance = 0;
+	for (const auto sample : samples)
+		variance += (sample - mean) * (sample - mean);
+
+	const size_t mid = samples.size() / 2;
+	const double median = (samples.size() % 2) ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+
+	return Result {
+		bench.name, batch, config.reps, samples.front(), median, mean,
+		samples.size() > 1 ? std::sqrt(variance / (samples.size() - 1)) : 0.0
+	};
+}
+
+
+
+
+void PrintHeader(FILE* out, const Config& config)
+{
+	if (config.format == "csv")
+		fprintf(out, "name,batch,reps,min_ns,median_ns,mean_ns,stddev_ns\n");
+	else if (config.format == "json")
+		fprintf(out, "{\n\t\"unit\": \"ns/op\",\n\t\"benchmarks\": [\n");
+	else
+		fprintf(out, "%-22s %12s %10s %10s %10s %8s\n", "benchmark", "batch", "min", "median", "mean", "stddev");
+}
+
+
+
+void PrintResult(FILE* out, const Config& config, const Result& r, const bool last)
+{
+	if (config.format == "csv")
+	{
+		fprintf(out, "%s,%llu,%d,%.3f,%.3f,%.3f,%.3f\n", r.name, static_cast<unsigned long long>(r.batch),
+		       r.reps, r.minNs, r.medianNs, r.meanNs, r.stddevNs);
+	}
+	else if (config.format == "json")
+	{
+		fprintf(out, "\t\t{ \"name\": \"%s\", \"batch\": %llu, \"reps\": %d, \"min\": %.3f, "
+		       "\"median\": %.3f, \"mean\": %.3f, \"stddev\": %.3f }%s\n",
+		       r.name, static_cast<unsigned long long>(r.batch), r.reps, r.minNs,
+		       r.medianNs, r.meanNs, r.stddevNs, last ? "" : ",");
+	}
+	else
+	{
+		fprintf(out, "%-22s %12llu %10.2f %10.2f %10.2f %7.1f%%\n", r.name, static_cast<unsigned long long>(r.batch),
+		       r.minNs, r.medianNs, r.meanNs, r.meanNs > 0 ? (100.0 * r.stddevNs) / r.meanNs : 0.0);
+	}
+}
+
+
+
+void PrintFooter(FILE* out, const Config& config)
+{
+	if (config.format == "json")
+		fprintf(out, "\t]\n}\n");
+	else if (config.format == "text")
+		fprintf(out, "\nns/op, stddev relative to the mean\n");
+
+	fflush(out);
+}
+
+
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+namespace benchs {
+using xchip::instructions::ExecuteInstruction;
+
+
+// writes the opcodes at 0x200 and runs them 'count' times, PC is
+// rewound to 0x200 before every run of the sequence.
+inline void run_program(CpuManager& cpuMan, const uint16_t* program, const size_t size, uint64_t count)
+{
+	uint8_t* const memory = cpuMan.GetMemory() + 0x200;
+	for (size_t i = 0; i < size; ++i)
+	{
+		memory[i * 2] = program[i] >> 8;
+		memory[(i * 2) + 1] = program[i] & 0xFF;
+	}
+
+	while (count--)
+	{
+		cpuMan.SetPC(0x200);
+		for (size_t i = 0; i < size; ++i)
+			ExecuteInstruction(cpuMan);
+	}
+}
+
+
+inline void run_opcode(CpuManager& cpuMan, const uint16_t opcode, const uint64_t count)
+{
+	run_program(cpuMan, &opcode, 1, count);
+}
+
+
+
+void loop(CpuManager& cpuMan, uint64_t count)
+{
+	// 0x1200: jumps to itself, the cheapest instruction there is
+	run_opcode(cpuMan, 0x1200, count);
+}
+
+
+void alu_6XNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x6A42, count); }
+void alu_7XNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x7A03, count); }
+void alu_8XY4(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x8AB4, count); }
+void alu_8XYE(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x8ABE, count); }
+void skip_3XNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x3A00, count); }
+void skip_5XY0(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x5AB0, count); }
+void flow_1NNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x1300, count); }
+void flow_BNNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0xB300, count); }
+void mem_ANNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0xA300, count); }
+void rand_CXNN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0xCAFF, count); }
+
+
+void flow_2NNN_00EE(CpuManager& cpuMan, uint64_t count)
+{
+	// 0x200: call 0x204, 0x204: return. two instructions per op
+	const uint16_t program[] = { 0x2204, 0x0000, 0x00EE };
+	run_program(cpuMan, program, 3, 0);
+
+	cpuMan.SetSP(0);
+	while (count--)
+	{
+		cpuMan.SetPC(0x200);
+		ExecuteInstruction(cpuMan);
+		ExecuteInstruction(cpuMan);
+	}
+}
+
+
+void mem_FX1E(CpuManager& cpuMan, uint64_t count)
+{
+	cpuMan.SetIndexRegister(0x300);
+	cpuMan.GetRegisters(0xA) = 0;
+	run_opcode(cpuMan, 0xFA1E, count);
+}
+
+
+void mem_FX33(CpuManager& cpuMan, uint64_t count)
+{
+	cpuMan.SetIndexRegister(0x300);
+	cpuMan.GetRegisters(0xA) = 253;
+	run_opcode(cpuMan, 0xFA33, count);
+}
+
+
+void mem_FX55(CpuManager& cpuMan, uint64_t count)
+{
+	// V0..VE, the most a FX55/FX65 moves without overflowing the asserts
+	cpuMan.SetIndexRegister(0x300);
+	run_opcode(cpuMan, 0xFE55, count);
+}
+
+
+void mem_FX65(CpuManager& cpuMan, uint64_t count)
+{
+	cpuMan.SetIndexRegister(0x300);
+	run_opcode(cpuMan, 0xFE65, count);
+}
+
+
+void mem_5XY2(CpuManager& cpuMan, uint64_t count)
+{
+	// XO-Chip: V0..VE above the 4 KiB CHIP-8 memory
+	cpuMan.SetIndexRegister(0x8000);
+	run_opcode(cpuMan, 0x50E2, count);
+}
+
+
+void mem_5XY3(CpuManager& cpuMan, uint64_t count)
+{
+	cpuMan.SetIndexRegister(0x8000);
+	run_opcode(cpuMan, 0x50E3, count);
+}
+
+
+
+
+void gfx_00E0(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x00E0, count); }
+void gfx_00CN(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x00C4, count); }
+void gfx_00FB(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x00FB, count); }
+void gfx_00FC(CpuManager& cpuMan, uint64_t count) { run_opcode(cpuMan, 0x00FC, count); }
+
+
+void gfx_00FE_00FF(CpuManager& cpuMan, uint64_t count)
+{
+	// games flipping modes every frame, each switch clears the new mode
+	const uint16_t program[] = { 0x00FE, 0x00FF };
+	run_program(cpuMan, program, 2, count);
+}
+
+
+void gfx_DXYN_lores(CpuManager& cpuMan, uint64_t count)
+{
+	// 15 rows of the '8' font sprite region at (8, 8)
+	cpuMan.SetIndexRegister(CpuManager::GetDefaultFontIndex());
+	cpuMan.GetRegisters(0xA) = 8;
+	cpuMan.GetRegisters(0xB) = 8;
+	run_opcode(cpuMan, 0xDABF, count);
+}
+
+
+void gfx_DXYN_lores_wrap(CpuManager& cpuMan, uint64_t count)
+{
+	// bottom right corner, every row and column wraps
+	cpuMan.SetIndexRegister(CpuManager::GetDefaultFontIndex());
+	cpuMan.GetRegisters(0xA) = 60;
+	cpuMan.GetRegisters(0xB) = 28;
+	run_opcode(cpuMan, 0xDABF, count);
+}
+
+
+void gfx_DXY0_schip(CpuManager& cpuMan, uint64_t count)
+{
+	cpuMan.SetIndexRegister(CpuManager::GetHiResFontIndex());
+	cpuMan.GetRegisters(0xA) = 40;
+	cpuMan.GetRegisters(0xB) = 20;
+	run_opcode(cpuMan, 0xDAB0, count);
+}
+
+
+void gfx_DXYN_planes(CpuManager& cpuMan, uint64_t count)
+{
+	// XO-Chip FN01 with both planes, each one takes its own 15 rows.
+	// x = 60 spills every row into the next word
+	cpuMan.SetPlanes(0x3);
+	cpuMan.SetIndexRegister(CpuManager::GetDefaultFontIndex());
+	cpuMan.GetRegisters(0xA) = 60;
+	cpuMan.GetRegisters(0xB) = 8;
+	run_opcode(cpuMan, 0xDABF, count);
+}
+
+
+
+
+// the Emulator composes the gfx planes into palette indexes, the 
+// render plugins look them up into a streaming texture, which may 
+// have a wider pitch than the gfx rows.
+std::vector<uint8_t> screen(CpuManager::MAX_GFX_SIZE);
+std::vector<uint32_t> texture(256 * 64);
+
+
+void conv_compose(CpuManager& cpuMan, uint64_t count)
+{
+	while (count--)
+		cpuMan.ComposeGfx(screen.data());
+}
+
+
+
+void conv_palette_hires(CpuManager& cpuMan, uint64_t count)
+{
+	const uint32_t palette[4] = { 0xFF101010, 0xFF33FF66, 0xFFAAAAAA, 0xFF555555 };
+	const auto res = cpuMan.GetGfxRes();
+	const size_t pitch = 256;
+	while (count--)
+	{
+		cpuMan.ComposeGfx(screen.data());
+		const uint8_t* src = screen.data();
+		for (int y = 0; y < res.y; ++y)
+		{
+			uint32_t* const dest = &texture[y * pitch];
+			for (int x = 0; x < res.x; ++x)
+				dest[x] = palette[*src++ & 0x3];
+		}
+	}
+}
+
+
+
+
+void load_rom_memory(CpuManager& cpuMan, uint64_t count)
+{
+	// the biggest ROM that fits a CHIP-8 memory
+	static std::vector<uint8_t> rom(0x1000 - 0x200, 0xA5);
+	while (count--)
+		cpuMan.LoadRom(rom.data(), rom.size(), 0x200);
+}
+
+
+void load_rom_file(CpuManager& cpuMan, uint64_t count)
+{
+	while (count--)
+	{
+		if (cpuMan.LoadRom(g_config.romPath.c_str(), 0x200) != xchip::LoadStatus::OK)
+		{
+			utix::LogError("XChipBench: %s", utix::GetLastLogError().c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+
+
+
+void lockstep_scalar(CpuManager&, uint64_t count)
+{
+	while (count--)
+	{
+		for (auto& lane : g_lanes)
+			ExecuteInstruction(lane);
+	}
+}
+
+
+void lockstep_runner(CpuManager&, uint64_t count)
+{
+	while (count--)
+		g_lockstep.Step();
+}
+
+
+}
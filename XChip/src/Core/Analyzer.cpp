@@ -0,0 +1,699 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <algorithm>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/Assert.h>
+
+#include <XChip/Core/Analyzer.h>
+#include <XChip/Core/Disassembler.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+using namespace disassembler;
+
+constexpr size_t Analyzer::MAX_ADDRESS;
+constexpr size_t Analyzer::MAX_TABLE_ENTRIES;
+constexpr size_t Analyzer::MAX_BLOCKS;
+constexpr size_t Analyzer::MAX_FUNCTIONS;
+constexpr size_t Analyzer::MAX_CALLS;
+constexpr size_t Analyzer::MAX_JUMP_TABLES;
+constexpr size_t Analyzer::MAX_STORES;
+constexpr size_t Analyzer::MAX_PATHS;
+constexpr size_t Analyzer::MAX_VISITED;
+
+constexpr uint32_t NO_VISIT = 0xFFFFFFFF; // pc 0xFFFF is never walked, see InImage()
+
+
+// local functions declarations
+template<class T>
+inline bool alloc_list(const size_t size, T*& arr);
+template<class T>
+inline void free_list(T*& arr);
+template<class T>
+inline bool push_list(T* arr, size_t& size, const size_t capacity, const T& value);
+inline bool overflow(const char* what);
+inline uint32_t* find_visit(uint32_t* visited, const size_t capacity, const uint32_t key);
+inline uint16_t get_nnn(const uint16_t opcode);
+inline bool is_code_write(const uint8_t* marks, const Analyzer::Store& store);
+
+
+
+
+
+Analyzer::Analyzer() noexcept
+{
+	Log("Creating Analyzer object...");
+}
+
+
+Analyzer::~Analyzer()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying Analyzer object...");
+}
+
+
+
+bool Analyzer::Initialize() noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	if (!alloc_list(MAX_ADDRESS, m_marks)
+		|| !alloc_list(MAX_VISITED, m_visited)
+		|| !alloc_list(MAX_ADDRESS, m_stamps)
+		|| !alloc_list(MAX_ADDRESS, m_stack)
+		|| !alloc_list(MAX_PATHS, m_worklist)
+		|| !alloc_list(MAX_BLOCKS, m_blocks)
+		|| !alloc_list(MAX_FUNCTIONS, m_functions)
+		|| !alloc_list(MAX_CALLS, m_calls)
+		|| !alloc_list(MAX_JUMP_TABLES, m_tables)
+		|| !alloc_list(MAX_STORES, m_stores))
+	{
+		LogError("Analyzer: cannot allocate the analysis tables");
+		this->Dispose();
+		return false;
+	}
+
+	arr_zero(m_marks, MAX_ADDRESS);
+	m_initialized = true;
+	return true;
+}
+
+
+
+void Analyzer::Dispose() noexcept
+{
+	free_list(m_marks);
+	free_list(m_visited);
+	free_list(m_stamps);
+	free_list(m_stack);
+	free_list(m_worklist);
+	free_list(m_blocks);
+	free_list(m_functions);
+	free_list(m_calls);
+	free_list(m_tables);
+	free_list(m_stores);
+
+	m_image = nullptr;
+	m_base = m_end = m_entry = 0;
+	m_visitedSize = m_worklistSize = 0;
+	m_blocksSize = m_functionsSize = m_callsSize = m_tablesSize = m_storesSize = 0;
+	m_initialized = false;
+}
+
+
+
+
+bool Analyzer::Analyze(const uint8_t* image, const size_t size, const size_t base, const size_t entry)
+{
+	ASSERT_MSG(m_initialized, "Analyzer is not initialized");
+	ASSERT_MSG(image != nullptr, "null image");
+
+	if (size == 0 || base + size > MAX_ADDRESS || entry < base || entry >= base + size)
+	{
+		LogError("Analyzer: invalid image range 0x%zX-0x%zX, entry 0x%zX", base, base + size, entry);
+		return false;
+	}
+
+	std::fill_n(m_marks, MAX_ADDRESS, uint8_t(0));
+	std::fill_n(m_visited, MAX_VISITED, NO_VISIT);
+	m_visitedSize = m_worklistSize = 0;
+	m_blocksSize = m_functionsSize = m_callsSize = m_tablesSize = m_storesSize = 0;
+
+	m_image = image;
+	m_base = base;
+	m_end = base + size;
+	m_entry = entry;
+
+	m_marks[entry] |= MARK_FUNCTION | MARK_BLOCK;
+	m_worklist[m_worklistSize++] = { static_cast<uint16_t>(entry), -1 };
+	if (!Discover())
+	{
+		m_image = nullptr;
+		return false;
+	}
+
+	// only stores landing on reachable code are self-modifying,
+	// the rest are plain data writes
+	const uint8_t* const marks = m_marks;
+	m_storesSize = std::remove_if(m_stores, m_stores + m_storesSize, [marks](const Store& store) {
+		return !is_code_write(marks, store);
+	}) - m_stores;
+
+	// in address order for the listing
+	std::sort(m_tables, m_tables + m_tablesSize, [](const JumpTable& a, const JumpTable& b) {
+		return a.base != b.base ? a.base < b.base : a.site < b.site;
+	});
+
+	BuildBlocks();
+	if (!BuildCallGraph())
+	{
+		m_image = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+
+
+
+void Analyzer::WriteListing(FILE* out) const
+{
+	ASSERT_MSG(m_image != nullptr, "Analyzer has no image");
+
+	size_t tableIndex = 0;
+	size_t addr = m_base;
+	while (addr < m_end)
+	{
+		const auto marks = m_marks[addr];
+
+		if (marks & MARK_FUNCTION)
+			fprintf(out, "\n; function 0x%03zX\n", addr);
+
+		for (; tableIndex < m_tablesSize && m_tables[tableIndex].base <= addr; ++tableIndex)
+		{
+			if (m_tables[tableIndex].base == addr)
+				fprintf(out, "; jump table, %u entries, from 0x%03X\n", m_tables[tableIndex].count, m_tables[tableIndex].site);
+		}
+
+		if ((marks & MARK_INSTR) && InImage(addr, 2))
+		{
+			char text[MAX_TEXT_SIZE];
+			const auto opcode = GetOpcode(addr);
+			Disassemble(opcode, text, sizeof(text));
+			if ((marks | m_marks[addr + 1]) & MARK_WRITE)
+				fprintf(out, "0x%03zX  %04X  %-20s ; self-modified\n", addr, opcode, text);
+			else
+				fprintf(out, "0x%03zX  %04X  %s\n", addr, opcode, text);
+
+			// F000 NNNN's address word
+			if (GetInstrSize(opcode) == 4 && InImage(addr + 2, 2))
+				fprintf(out, "0x%03zX  %04X\n", addr + 2, GetOpcode(addr + 2));
+
+			addr += GetInstrSize(opcode);
+			continue;
+		}
+
+
+		// data runs up to 8 bytes per line, broken at the next instruction
+		uint8_t lineMarks = 0;
+		fprintf(out, "0x%03zX  DB   ", addr);
+		for (size_t i = 0; i < 8 && addr < m_end && !(m_marks[addr] & MARK_INSTR); ++i, ++addr)
+		{
+			lineMarks |= m_marks[addr];
+			fprintf(out, "%s0x%02X", i ? ", " : "", m_image[addr - m_base]);
+		}
+
+		if (lineMarks & (MARK_READ | MARK_WRITE))
+			fprintf(out, " ; %s%s", (lineMarks & MARK_READ) ? "r" : "", (lineMarks & MARK_WRITE) ? "w" : "");
+
+		fprintf(out, "\n");
+	}
+
+	fflush(out);
+}
+
+
+
+
+void Analyzer::WriteReport(FILE* out) const
+{
+	ASSERT_MSG(m_image != nullptr, "Analyzer has no image");
+
+	size_t instrs = 0, code = 0, data = 0;
+	for (size_t addr = m_base; addr < m_end; ++addr)
+	{
+		instrs += (m_marks[addr] & MARK_INSTR) != 0;
+		code += (m_marks[addr] & MARK_CODE) != 0;
+		data += (m_marks[addr] & (MARK_CODE | MARK_READ)) == MARK_READ;
+	}
+
+	fprintf(out, "image: 0x%03zX-0x%03zX  entry: 0x%03zX\n", m_base, m_end - 1, m_entry);
+	fprintf(out, "code bytes: %zu  data bytes: %zu  unreached bytes: %zu\n", code, data, (m_end - m_base) - code - data);
+	fprintf(out, "instructions: %zu  blocks: %zu  functions: %zu  calls: %zu\n", instrs, m_blocksSize,
+	        m_functionsSize, m_callsSize);
+
+
+	fprintf(out, "\n-- call graph --\n");
+	for (size_t i = 0; i < m_functionsSize; ++i)
+	{
+		const auto function = m_functions[i];
+		fprintf(out, "0x%03X ->", function);
+		uint16_t last = 0;
+		for (size_t j = 0; j < m_callsSize; ++j)
+		{
+			const auto& call = m_calls[j];
+			// calls are grouped by caller, repeated callees print once
+			if (call.caller == function && call.callee != last)
+				fprintf(out, " 0x%03X", call.callee);
+			if (call.caller == function)
+				last = call.callee;
+		}
+		fprintf(out, "\n");
+	}
+
+
+	fprintf(out, "\n-- jump tables --\n");
+	for (size_t i = 0; i < m_tablesSize; ++i)
+		fprintf(out, "0x%03X: JP V0, 0x%03X  %u entries\n", m_tables[i].site, m_tables[i].base, m_tables[i].count);
+
+
+	fprintf(out, "\n-- self-modifying stores --\n");
+	for (size_t i = 0; i < m_storesSize; ++i)
+	{
+		const auto& store = m_stores[i];
+		fprintf(out, "0x%03X: writes 0x%03X-0x%03X\n", store.site, store.address, store.address + store.size - 1);
+	}
+
+	fflush(out);
+}
+
+
+
+
+
+
+
+
+inline bool Analyzer::InImage(const size_t address, const size_t size) const
+{
+	return address >= m_base && address + size <= m_end;
+}
+
+
+
+
+bool Analyzer::Discover()
+{
+	// an instruction is walked again for each distinct I reaching it, so the
+	// sprites drawn after a skip over ANNN are found. I only comes from
+	// ANNN constants, which bounds the walk.
+	while (m_worklistSize != 0)
+	{
+		const auto path = m_worklist[--m_worklistSize];
+
+		uint16_t pc = path.pc;
+		int32_t I = path.I;
+
+		while (InImage(pc, 2))
+		{
+			const uint32_t key = (uint32_t(pc) << 16) | (I & 0xFFFF);
+			uint32_t* const visit = find_visit(m_visited, MAX_VISITED, key);
+			if (*visit == key)
+				break;
+			else if (m_visitedSize == MAX_VISITED / 2)
+				return overflow("paths");
+
+			*visit = key;
+			++m_visitedSize;
+
+			const auto opcode = GetOpcode(pc);
+			const auto& info = GetOpcodeInfo(opcode);
+
+			// reaching an unknown opcode means the path ran into data
+			if (info.flow == FLOW_STOP && !IsKnownOpcode(opcode))
+				break;
+
+			const auto instrSize = GetInstrSize(opcode);
+			m_marks[pc] |= MARK_CODE | MARK_INSTR;
+			MarkRange(pc + 1, instrSize - 1, MARK_CODE);
+
+
+			// follow I while it holds a constant, DXY0 is assumed to be in extended mode
+			size_t size;
+			const auto access = GetAccess(opcode, true, size);
+			if (access != ACCESS_NONE && I >= 0)
+			{
+				MarkRange(static_cast<size_t>(I), size, access == ACCESS_READ ? MARK_READ : MARK_WRITE);
+				if (access == ACCESS_WRITE && !push_list(m_stores, m_storesSize, MAX_STORES, 
+					Store{ pc, static_cast<uint16_t>(I), static_cast<uint16_t>(size) }))
+				{
+					return overflow("stores");
+				}
+			}
+
+			if ((opcode & 0xF000) == 0xA000)
+				I = get_nnn(opcode);
+			else if (opcode == 0xF000)
+				I = InImage(pc + 2, 2) ? GetOpcode(pc + 2) : -1;
+			else if ((opcode & 0xF0FF) == 0xF01E || (opcode & 0xF0FF) == 0xF029 || (opcode & 0xF0FF) == 0xF030)
+				I = -1;
+
+
+			const uint16_t next = pc + instrSize;
+			switch (info.flow)
+			{
+				case FLOW_NEXT:
+					pc = next;
+					continue;
+
+				case FLOW_SKIP:
+				{
+					const uint16_t skipped = GetSkipTarget(next);
+					m_marks[next] |= MARK_BLOCK;
+					m_marks[skipped] |= MARK_BLOCK;
+					if (!push_list(m_worklist, m_worklistSize, MAX_PATHS, Path{ skipped, I }))
+						return overflow("paths");
+					pc = next;
+					continue;
+				}
+
+				case FLOW_CALL:
+					// the callee may change I
+					m_marks[get_nnn(opcode)] |= MARK_FUNCTION | MARK_BLOCK;
+					m_marks[next] |= MARK_BLOCK;
+					if (!push_list(m_worklist, m_worklistSize, MAX_PATHS, Path{ get_nnn(opcode), I }))
+						return overflow("paths");
+					I = -1;
+					pc = next;
+					continue;
+
+				case FLOW_JUMP:
+					m_marks[get_nnn(opcode)] |= MARK_BLOCK;
+					if (!push_list(m_worklist, m_worklistSize, MAX_PATHS, Path{ get_nnn(opcode), I }))
+						return overflow("paths");
+					break;
+
+				case FLOW_INDIRECT:
+					if (!ScanJumpTable(pc, get_nnn(opcode), I))
+						return false;
+					break;
+
+				default: // FLOW_RETURN, FLOW_STOP
+					break;
+			}
+
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+
+
+bool Analyzer::ScanJumpTable(const uint16_t site, const uint16_t base, const int32_t I)
+{
+	// V0 is not known statically. Tables are usually a run of 1NNN
+	// at the base, V0 picking one by a multiple of 2. Anything else is
+	// taken as a single computed target at the base.
+	uint16_t count = 0;
+	while (count < MAX_TABLE_ENTRIES && InImage(base + (count * 2), 2)
+		&& GetOpcodeInfo(GetOpcode(base + (count * 2))).flow == FLOW_JUMP)
+	{
+		++count;
+	}
+
+	const uint16_t entries = count ? count : 1;
+	for (uint16_t i = 0; i < entries; ++i)
+	{
+		const uint16_t entry = base + (i * 2);
+		m_marks[entry] |= MARK_TABLE | MARK_BLOCK;
+		if (!push_list(m_worklist, m_worklistSize, MAX_PATHS, Path{ entry, I }))
+			return overflow("paths");
+	}
+
+	// walked again for another I
+	const auto known = std::find_if(m_tables, m_tables + m_tablesSize, [site](const JumpTable& table) {
+		return table.site == site;
+	});
+
+	if (known == m_tables + m_tablesSize 
+		&& !push_list(m_tables, m_tablesSize, MAX_JUMP_TABLES, JumpTable{ site, base, entries }))
+	{
+		return overflow("jump tables");
+	}
+
+	return true;
+}
+
+
+
+
+void Analyzer::MarkRange(const size_t address, const size_t size, const uint8_t marks)
+{
+	for (size_t i = 0; i < size; ++i)
+		m_marks[(address + i) % MAX_ADDRESS] |= marks;
+}
+
+
+
+
+void Analyzer::BuildBlocks()
+{
+	bool open = false;
+	size_t addr = m_base;
+
+	while (addr < m_end)
+	{
+		if (!(m_marks[addr] & MARK_INSTR) || !InImage(addr, 2))
+		{
+			open = false;
+			++addr;
+			continue;
+		}
+
+		if (!open || (m_marks[addr] & MARK_BLOCK))
+		{
+			ASSERT_MSG(m_blocksSize < MAX_BLOCKS, "blocks overflow");
+			m_marks[addr] |= MARK_BLOCK;
+			m_blocks[m_blocksSize++] = { static_cast<uint16_t>(addr), 0, 0 };
+			open = true;
+		}
+
+		const auto opcode = GetOpcode(addr);
+		auto& block = m_blocks[m_blocksSize - 1];
+		block.last = static_cast<uint16_t>(addr);
+		block.end = static_cast<uint16_t>(addr + GetInstrSize(opcode));
+
+		// any control flow ends the block, calls included
+		open = GetOpcodeInfo(opcode).flow == FLOW_NEXT;
+		addr += GetInstrSize(opcode);
+	}
+}
+
+
+
+
+bool Analyzer::BuildCallGraph()
+{
+	for (size_t addr = m_base; addr < m_end; ++addr)
+	{
+		if (m_marks[addr] & MARK_FUNCTION)
+		{
+			ASSERT_MSG(m_functionsSize < MAX_FUNCTIONS, "functions overflow");
+			m_functions[m_functionsSize++] = static_cast<uint16_t>(addr);
+		}
+	}
+
+
+	// walk each function's body without entering its callees,
+	// code shared by several functions belongs to all of them.
+	// an address is stamped when pushed, so the stack never
+	// holds it twice for the same function.
+	arr_zero(m_stamps, MAX_ADDRESS);
+
+	for (size_t i = 0; i < m_functionsSize; ++i)
+	{
+		const auto stamp = static_cast<uint16_t>(i + 1);
+		const auto function = m_functions[i];
+		const auto first = m_callsSize;
+		size_t stackSize = 0;
+
+		if ((m_marks[function] & MARK_INSTR) && InImage(function, 2))
+		{
+			m_stamps[function] = stamp;
+			m_stack[stackSize++] = function;
+		}
+
+		while (stackSize != 0)
+		{
+			const auto pc = m_stack[--stackSize];
+			const auto opcode = GetOpcode(pc);
+			if (GetOpcodeInfo(opcode).flow == FLOW_CALL 
+				&& !push_list(m_calls, m_callsSize, MAX_CALLS, Call{ function, pc, get_nnn(opcode) }))
+			{
+				return overflow("calls");
+			}
+
+			uint16_t succ[MAX_TABLE_ENTRIES];
+			const auto count = GetSuccessors(pc, succ);
+			for (size_t j = 0; j < count; ++j)
+			{
+				if (m_stamps[succ[j]] != stamp && (m_marks[succ[j]] & MARK_INSTR) && InImage(succ[j], 2))
+				{
+					m_stamps[succ[j]] = stamp;
+					m_stack[stackSize++] = succ[j];
+				}
+			}
+		}
+
+		std::sort(m_calls + first, m_calls + m_callsSize, [](const Call& a, const Call& b) {
+			return a.callee != b.callee ? a.callee < b.callee : a.site < b.site;
+		});
+	}
+
+	return true;
+}
+
+
+
+
+size_t Analyzer::GetSuccessors(const uint16_t pc, uint16_t* succ) const
+{
+	// successors inside the function: a call continues at the next instruction
+	const auto opcode = GetOpcode(pc);
+	const uint16_t next = pc + GetInstrSize(opcode);
+
+	switch (GetOpcodeInfo(opcode).flow)
+	{
+		case FLOW_NEXT:
+		case FLOW_CALL:
+			succ[0] = next;
+			return 1;
+
+		case FLOW_SKIP:
+			succ[0] = next;
+			succ[1] = GetSkipTarget(next);
+			return 2;
+
+		case FLOW_JUMP:
+			succ[0] = get_nnn(opcode);
+			return 1;
+
+		case FLOW_INDIRECT:
+			for (size_t t = 0; t < m_tablesSize; ++t)
+			{
+				const auto& table = m_tables[t];
+				if (table.site != pc)
+					continue;
+
+				for (uint16_t i = 0; i < table.count; ++i)
+					succ[i] = table.base + (i * 2);
+				return table.count;
+			}
+			return 0;
+
+		default:
+			return 0;
+	}
+}
+
+
+
+
+// a skip jumps over the instruction at next, F000 NNNN is 4 bytes long
+uint16_t Analyzer::GetSkipTarget(const uint16_t next) const
+{
+	const size_t size = InImage(next, 2) ? GetInstrSize(GetOpcode(next)) : 2;
+	return static_cast<uint16_t>(next + size);
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+template<class T>
+inline bool alloc_list(const size_t size, T*& arr)
+{
+	arr = static_cast<T*>(alloc_arr(sizeof(T) * size));
+	return arr != nullptr;
+}
+
+
+template<class T>
+inline void free_list(T*& arr)
+{
+	if (arr != nullptr)
+	{
+		free_arr(arr);
+		arr = nullptr;
+	}
+}
+
+
+template<class T>
+inline bool push_list(T* arr, size_t& size, const size_t capacity, const T& value)
+{
+	if (size == capacity)
+		return false;
+
+	arr[size++] = value;
+	return true;
+}
+
+
+inline bool overflow(const char* what)
+{
+	LogError("Analyzer: too many %s, the image can't be analyzed", what);
+	return false;
+}
+
+
+// open addressing, the slot holding key or the empty one where it goes
+inline uint32_t* find_visit(uint32_t* visited, const size_t capacity, const uint32_t key)
+{
+	// capacity is a power of 2, the product's high bits mix both pc and I
+	const size_t mask = capacity - 1;
+	size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 40);
+	while (visited[slot & mask] != key && visited[slot & mask] != NO_VISIT)
+		++slot;
+
+	return &visited[slot & mask];
+}
+
+
+inline uint16_t get_nnn(const uint16_t opcode)
+{
+	return opcode & 0x0FFF;
+}
+
+
+inline bool is_code_write(const uint8_t* marks, const Analyzer::Store& store)
+{
+	for (size_t i = 0; i < store.size; ++i)
+	{
+		if (marks[(store.address + i) % Analyzer::MAX_ADDRESS] & Analyzer::MARK_CODE)
+			return true;
+	}
+
+	return false;
+}
+
+
+
+
+}
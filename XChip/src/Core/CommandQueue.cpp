@@ -0,0 +1,102 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdint>
+
+#include <Utix/Log.h>
+
+#include <XChip/Core/CommandQueue.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+
+
+
+CommandQueue::CommandQueue() noexcept
+	: m_tail(0)
+{
+	Log("Creating CommandQueue object...");
+
+	// slot i is free for the push at position i
+	for (size_t i = 0; i < CAPACITY; ++i)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+
+
+
+bool CommandQueue::Push(const Command& command)
+{
+	size_t pos = m_tail.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		Slot& slot = m_slots[pos & (CAPACITY - 1)];
+		const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+		if (diff == 0)
+		{
+			// on failure pos is reloaded with the current tail
+			if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				slot.command = command;
+				slot.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0)
+		{
+			// the slot still holds the command pushed a lap before
+			return false;
+		}
+		else
+		{
+			// another producer took it
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+
+
+bool CommandQueue::Pop(Command& command)
+{
+	Slot& slot = m_slots[m_head & (CAPACITY - 1)];
+
+	// not pushed yet, or a producer is still writing it
+	if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+		return false;
+
+	command = slot.command;
+	slot.sequence.store(m_head + CAPACITY, std::memory_order_release);
+	++m_head;
+	return true;
+}
+
+
+
+
+}
@@ -19,11 +19,13 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 */
 
 
+#include <atomic>
 #include <Utix/Log.h>
 #include <Utix/ScopeExit.h>
 #include <Utix/Assert.h>
 
 #include <XChip/Core/CpuManager.h>
+#include <XChip/Core/SharedImage.h>
 #include <XChip/Plugins/iRender.h>
 #include <XChip/Plugins/iInput.h>
 #include <XChip/Plugins/iSound.h>
@@ -34,14 +36,26 @@ namespace xchip {
 using namespace utix;
 
 
+constexpr size_t CpuManager::MAX_MEMORY_SIZE;
+constexpr size_t CpuManager::MEMORY_PAGE_SIZE;
+constexpr size_t CpuManager::MEMORY_PAGES;
+constexpr size_t CpuManager::MEMORY_GUARD_SIZE;
+constexpr size_t CpuManager::GFX_PLANES;
+constexpr size_t CpuManager::MAX_GFX_SIZE;
+
+
 // local functions declarations
 inline void set_plugin_flag(Cpu::Flags flag, const iPlugin* plugin, CpuManager& man);
+inline size_t pow2_size(const size_t size);
 template<class T>
 inline bool alloc_cpu_arr(const size_t size, T*&);
 template<class T>
 inline bool realloc_cpu_arr(const size_t size, T*&);
 template<class T>
 inline void free_cpu_arr(T*& arr);
+static uint64_t compose_table[256];
+static bool init_compose_table();
+static const bool compose_table_ready = init_compose_table();
 
 
 
@@ -51,6 +65,8 @@ CpuManager::CpuManager() noexcept
 	Log("Creating CpuManager object...");
 	// init all members to 0
 	memset(&m_cpu, 0, sizeof(Cpu));
+	m_cpu.planes = 1;
+	m_cpu.pitch = 64;
 	SetFlags( Cpu::BAD_RENDER | Cpu::BAD_INPUT | Cpu::BAD_SOUND ); 
 }
 
@@ -67,24 +83,158 @@ CpuManager::~CpuManager()
 
 void CpuManager::Dispose() noexcept
 {
-	free_cpu_arr(m_cpu.gfx);
+	free_cpu_arr(m_gfxModes[0]);
+	free_cpu_arr(m_gfxModes[1]);
+	m_cpu.gfx = nullptr;
 	free_cpu_arr(m_cpu.stack);
 	free_cpu_arr(m_cpu.registers);
-	free_cpu_arr(m_cpu.memory);
+	ReleaseMemory();
+}
+
+
+bool CpuManager::CloneInto(CpuManager& dest) const
+{
+	ASSERT_MSG(&dest != this, "trying to clone into itself");
+	ASSERT_MSG(m_cpu.memory != nullptr, "null Cpu::memory");
+
+	// these are no-ops when dest already has the same layout,
+	// a dest memory mapped from a SharedImage is kept mapped.
+	const bool sameMemory = dest.m_cpu.memory && dest.m_memorySize == m_memorySize;
+	if ((!sameMemory && !dest.SetMemory(GetMemorySize()))
+		|| !dest.SetRegisters(GetRegistersSize())
+		|| !dest.SetStack(GetStackSize())
+		|| !dest.SetGfxModes(m_gfxModesRes[0], m_gfxModesRes[1]))
+	{
+		LogError("CpuManager: could not clone, failed to allocate destination");
+		return false;
+	}
+
+	dest.SetExtendedGfx(m_cpu.gfx == m_gfxModes[1]);
+
+
+	// memory and gfx only differ from the shared base on the pages
+	// dirty in either side, the rest is already equal.
+	if (m_cloneBase != 0 && dest.m_cloneBase == m_cloneBase)
+	{
+		const auto memSize = GetMemorySize();
+		for (size_t word = 0; word < utix::arr_size(m_dirtyPages); ++word)
+		{
+			auto bits = m_dirtyPages[word] | dest.m_dirtyPages[word];
+			for (size_t page = word * 64; bits != 0; ++page, bits >>= 1)
+			{
+				if (bits & 0x1)
+				{
+					const auto offset = page * MEMORY_PAGE_SIZE;
+					const auto size = (memSize - offset) < MEMORY_PAGE_SIZE ? (memSize - offset) : MEMORY_PAGE_SIZE;
+					memcpy(dest.m_cpu.memory + offset, m_cpu.memory + offset, size);
+				}
+			}
+		}
+
+		if (m_gfxDirty || dest.m_gfxDirty)
+			memcpy(dest.m_cpu.gfx, m_cpu.gfx, sizeof(uint64_t) * arr_size(m_cpu.gfx));
+	}
+	else
+	{
+		memcpy(dest.m_cpu.memory, m_cpu.memory, GetMemorySize());
+		memcpy(dest.m_cpu.gfx, m_cpu.gfx, sizeof(uint64_t) * arr_size(m_cpu.gfx));
+		dest.m_cloneBase = m_cloneBase;
+	}
+
+	memcpy(dest.m_dirtyPages, m_dirtyPages, sizeof(m_dirtyPages));
+	dest.m_gfxDirty = m_gfxDirty;
+
+
+	memcpy(dest.m_cpu.registers, m_cpu.registers, GetRegistersSize());
+	memcpy(dest.m_cpu.stack, m_cpu.stack, sizeof(size_t) * GetStackSize());
+	dest.m_cpu.sp = m_cpu.sp;
+	dest.m_cpu.pc = m_cpu.pc;
+	dest.m_cpu.I = m_cpu.I;
+	dest.m_cpu.opcode = m_cpu.opcode;
+	dest.m_cpu.delayTimer = m_cpu.delayTimer;
+	dest.m_cpu.soundTimer = m_cpu.soundTimer;
+	dest.m_cpu.keys = m_cpu.keys;
+	dest.m_cpu.waitKeys = m_cpu.waitKeys;
+	dest.m_cpu.planes = m_cpu.planes;
+	dest.m_cpu.pitch = m_cpu.pitch;
+	memcpy(dest.m_cpu.pattern, m_cpu.pattern, sizeof(m_cpu.pattern));
+
+	// plugin flags belong to the destination
+	constexpr uint32_t badFlags = Cpu::BAD_RENDER | Cpu::BAD_INPUT | Cpu::BAD_SOUND;
+	dest.m_cpu.flags = (m_cpu.flags & ~badFlags) | (dest.m_cpu.flags & badFlags);
+	return true;
 }
 
 
+
 bool CpuManager::SetMemory(const size_t size)
 {
-	if (alloc_cpu_arr(size, m_cpu.memory))
+	if (size > MAX_MEMORY_SIZE) 
+	{
+		LogError("Cpu memory size: %zu is over the max: %zu", size, MAX_MEMORY_SIZE);
+		return false;
+	}
+
+	// a private heap memory of the same size is kept as is
+	const size_t space = pow2_size(size);
+	if (m_cpu.memory && !m_memoryImage && m_memorySize == space)
+		return true;
+
+	ReleaseMemory();
+
+	if (alloc_cpu_arr(space + MEMORY_GUARD_SIZE, m_cpu.memory))
+	{
+		memset(m_cpu.memory + space, 0, MEMORY_GUARD_SIZE);
+		m_memorySize = space;
+		MarkMemoryClean();
 		return true;
+	}
 
-	LogError("Cannot allocate Cpu memory size: %zu", size);
+	LogError("Cannot allocate Cpu memory size: %zu", space);
 	return false;
 }
 
 
 
+bool CpuManager::SetMemory(const SharedImage& image)
+{
+	ASSERT_MSG(image.IsInitialized(), "SharedImage is not initialized");
+
+	// the image carries the guard tail after the memory space
+	const size_t space = image.GetSize() - MEMORY_GUARD_SIZE;
+	if (image.GetSize() <= MEMORY_GUARD_SIZE || pow2_size(space) != space) 
+	{
+		LogError("SharedImage size: %zu is not a Cpu memory plus its guard", image.GetSize());
+		return false;
+	}
+	else if (space > MAX_MEMORY_SIZE) 
+	{
+		LogError("Cpu memory size: %zu is over the max: %zu", space, MAX_MEMORY_SIZE);
+		return false;
+	}
+
+	ReleaseMemory();
+
+	// pages are only copied when this instance writes to them
+	m_cpu.memory = image.MapPrivate();
+	if (!m_cpu.memory)
+	{
+		LogError("Cannot map SharedImage into Cpu memory");
+		return false;
+	}
+
+	m_memoryImage = &image;
+	m_memorySize = space;
+
+	// every manager mapping the same image starts equal to it
+	m_cloneBase = image.GetCloneBase();
+	memset(m_dirtyPages, 0, sizeof(m_dirtyPages));
+	m_gfxDirty = true;
+	return true;
+}
+
+
+
 bool CpuManager::SetRegisters(const size_t size)
 {
 	if (alloc_cpu_arr(size, m_cpu.registers))
@@ -97,39 +247,40 @@ bool CpuManager::SetRegisters(const size_t size)
 
 bool CpuManager::SetStack(const size_t size)
 {
-	if (alloc_cpu_arr(size, m_cpu.stack))
+	if (alloc_cpu_arr(pow2_size(size), m_cpu.stack))
 		return true;
 
-	LogError("Cannot allocate Cpu stack size: %zu", size);
+	LogError("Cannot allocate Cpu stack size: %zu", pow2_size(size));
 	return false;
 }
 
 
-bool CpuManager::SetGfxRes(const Vec2i& res)
+bool CpuManager::SetGfxModes(const Vec2i& lowRes, const Vec2i& highRes)
 {
-	if (alloc_cpu_arr(res.x * res.y, m_cpu.gfx)) 
-	{
-		m_gfxRes = res;
-		return true;
-	}
-
-	LogError("Cannot allocate Cpu memory size: %d", + res.x*res.y);
-	m_gfxRes = 0;
-	return false;
-}
-
+	// rows are packed in whole 64 pixels words
+	ASSERT_MSG((lowRes.x % 64) == 0 && (highRes.x % 64) == 0, "GFX width must be a multiple of 64");
 
+	const bool extended = m_cpu.gfx != nullptr && m_cpu.gfx == m_gfxModes[1];
 
-bool CpuManager::SetGfxRes(const int w, const int h)
-{
-	if (alloc_cpu_arr(w * h, m_cpu.gfx)) 
+	if (alloc_cpu_arr(GFX_PLANES * (lowRes.x / 64) * lowRes.y, m_gfxModes[0])
+		&& alloc_cpu_arr(GFX_PLANES * (highRes.x / 64) * highRes.y, m_gfxModes[1]))
 	{
-		m_gfxRes.x = w;
-		m_gfxRes.y = h;
+		if (m_gfxModesRes[0] != lowRes || m_gfxModesRes[1] != highRes)
+			m_gfxDirty = true;
+
+		m_gfxModesRes[0] = lowRes;
+		m_gfxModesRes[1] = highRes;
+		m_cpu.gfx = m_gfxModes[extended];
+		m_gfxRes = m_gfxModesRes[extended];
 		return true;
 	}
 
-	LogError("Cannot allocate Cpu memory size: %d", w*h);
+	LogError("Cannot allocate Cpu gfx modes: %dx%d, %dx%d", lowRes.x, lowRes.y, highRes.x, highRes.y);
+	free_cpu_arr(m_gfxModes[0]);
+	free_cpu_arr(m_gfxModes[1]);
+	m_cpu.gfx = nullptr;
+	m_gfxModesRes[0] = 0;
+	m_gfxModesRes[1] = 0;
 	m_gfxRes = 0;
 	return false;
 }
@@ -140,11 +291,46 @@ bool CpuManager::SetGfxRes(const int w, const int h)
 
 bool CpuManager::ResizeMemory(const std::size_t size)
 {
-	if (realloc_cpu_arr(size, m_cpu.memory)) 
+	if (size > MAX_MEMORY_SIZE) 
+	{
+		LogError("Cpu memory size: %zu is over the max: %zu", size, MAX_MEMORY_SIZE);
+		return false;
+	}
+
+	const size_t space = pow2_size(size);
+
+	if (m_memoryImage)
+	{
+		// a mapped view can't grow, move it to a private heap memory
+		uint8_t* heapMemory = nullptr;
+		if (!alloc_cpu_arr(space + MEMORY_GUARD_SIZE, heapMemory))
+		{
+			LogError("Cannot reallocate Cpu memory to size: %zu", space);
+			return false;
+		}
+
+		const size_t kept = space < m_memorySize ? space : m_memorySize;
+		memcpy(heapMemory, m_cpu.memory, kept);
+		memset(heapMemory + kept, 0, (space - kept) + MEMORY_GUARD_SIZE);
+		ReleaseMemory();
+		m_cpu.memory = heapMemory;
+		m_memorySize = space;
+		MarkMemoryClean();
 		return true;
+	}
+
+	const size_t oldSpace = m_memorySize;
+	if (realloc_cpu_arr(space + MEMORY_GUARD_SIZE, m_cpu.memory)) 
+	{
+		const size_t kept = space < oldSpace ? space : oldSpace;
+		memset(m_cpu.memory + kept, 0, (space - kept) + MEMORY_GUARD_SIZE);
+		m_memorySize = space;
+		MarkMemoryClean();
+		return true;
+	}
 
 
-	LogError("Cannot reallocate Cpu memory to size: %zu", size);
+	LogError("Cannot reallocate Cpu memory to size: %zu", space);
 	return false;
 }
 
@@ -164,10 +350,10 @@ bool CpuManager::ResizeRegisters(const size_t size)
 
 bool CpuManager::ResizeStack(const size_t size)
 {
-	if (realloc_cpu_arr(size, m_cpu.stack))
+	if (realloc_cpu_arr(pow2_size(size), m_cpu.stack))
 		return true;
 
-	LogError("Cannot reallocate Cpu stack to size: %zu", size);
+	LogError("Cannot reallocate Cpu stack to size: %zu", pow2_size(size));
 	return false;
 }
 
@@ -180,9 +366,10 @@ void CpuManager::LoadDefaultFont()
 	// default font : [0] -> [DEFAULT_FONT_SIZE - 1] 
 
 	ASSERT_MSG(m_cpu.memory != nullptr, "null Cpu::memory");
-	ASSERT_MSG((arr_size(m_cpu.memory) >= arr_size(chip8DefaultFont)), "Memory size is too low");
+	ASSERT_MSG((GetMemorySize() >= arr_size(chip8DefaultFont)), "Memory size is too low");
 
 	memcpy(m_cpu.memory, chip8DefaultFont, arr_size(chip8DefaultFont));
+	MarkMemoryDirty(0, arr_size(chip8DefaultFont));
 }
 
 void CpuManager::LoadHiResFont()
@@ -196,63 +383,100 @@ void CpuManager::LoadHiResFont()
 	constexpr const auto at = arr_size(chip8DefaultFont); 
 	
 	ASSERT_MSG(m_cpu.memory != nullptr, "null Cpu::memory");
-	ASSERT_MSG( arr_size(m_cpu.memory) >= ( at + arr_size(chip8HiResFont)), "Memory size is too low");
+	ASSERT_MSG( GetMemorySize() >= ( at + arr_size(chip8HiResFont)), "Memory size is too low");
 	ASSERT_MSG((at + arr_size(chip8HiResFont)) < 0x200, "Hi res font is over 0x200 memory area");
 
 	memcpy(m_cpu.memory + at, chip8HiResFont, arr_size(chip8HiResFont));
+	MarkMemoryDirty(at, arr_size(chip8HiResFont));
 }
 
 
-bool CpuManager::LoadRom(const char* fileName, const size_t at)
+LoadStatus CpuManager::LoadRom(const char* fileName, const size_t at)
+{
+	Log("Loading %s", fileName);
+
+	MappedFile file;
+	const auto status = file.Initialize(fileName);
+
+	if (status != LoadStatus::OK) 
+	{
+		LogError("Error loading ROM file \'%s\'", fileName);
+		return status;
+	}
+
+	return LoadRom(file.GetData(), file.GetSize(), at);
+}
+
+
+
+LoadStatus CpuManager::LoadRom(const uint8_t* data, const size_t size, const size_t at)
 {
 	// if the parameter 'at' is greater than m_cpu.memory array,
 	// or the m_cpu.memory ptr is null. It is the caller's error,
 	// so here's an assert for that purpose.
 
 	ASSERT_MSG(m_cpu.memory != nullptr, "null Cpu::memory");
-	ASSERT_MSG(arr_size(m_cpu.memory) > at, "parameter 'at' greater than Cpu::memory size");
+	ASSERT_MSG(GetMemorySize() > at, "parameter 'at' greater than Cpu::memory size");
 
-	Log("Loading %s", fileName);
+	if (!data || size == 0)
+	{
+		LogError("Error, empty ROM");
+		return LoadStatus::EMPTY;
+	}
 
-	auto *const file = fopen(fileName, "rb");
+	// check if the ROM size will not overflow emulated memory size
+	if ((GetMemorySize() - at) < size)
+	{
+		LogError("Error, ROM does not fit in memory at %zu! memory size: %zu, ROM size: %zu", 
+                   at, GetMemorySize(), size);
 
-	if (!file) {
-		LogError("Error opening ROM file \'%s\'", fileName);
-		return false;
+		return LoadStatus::DOES_NOT_FIT;
 	}
 
-	const auto fileClose = MakeScopeExit([file]() noexcept { 
-		fclose(file); 
-	});
+	memcpy(m_cpu.memory + at, data, size);
+	MarkMemoryDirty(at, size);
+	Log("Load Done!");
+	return LoadStatus::OK;
+}
+
 
-	// get file size
-	fseek(file, 0, SEEK_END);
-	const auto fileSize = static_cast<size_t>(ftell(file));
-	fseek(file, 0, SEEK_SET);
 
+void CpuManager::MarkMemoryClean()
+{
+	// the current memory and gfx become a new base for CloneInto
+	m_cloneBase = NewCloneBase();
+	memset(m_dirtyPages, 0, sizeof(m_dirtyPages));
+	m_gfxDirty = false;
+}
 
-	
-	
-	// check if file size will not overflow emulated memory size
-	if ( (arr_size(m_cpu.memory) - at) <= fileSize)
-	{
-		LogError("Error, size of \'%s\' does not fit in memory at %zu! memory size: %zu, file size: %zu", 
-                   fileName, at, arr_size(m_cpu.memory), fileSize);
 
-		return false;
-	}
 
-	const auto readSize = fread(m_cpu.memory + at, 1, fileSize, file);
+uint32_t CpuManager::NewCloneBase()
+{
+	// 0 is reserved for "no base"
+	static std::atomic<uint32_t> lastBase(0);
+	uint32_t base;
+	while ((base = ++lastBase) == 0)
+		continue;
+	return base;
+}
+
+
 
-	if( readSize != fileSize ) 
+void CpuManager::ReleaseMemory()
+{
+	if (m_memoryImage)
 	{
-		LogError("Could not read the file \'%s\' properly. bytes asked %zu , bytes read %zu", 
-                   fileName, fileSize, readSize);
-		return false;
+		m_memoryImage->UnmapPrivate(m_cpu.memory);
+		m_memoryImage = nullptr;
+		m_cpu.memory = nullptr;
+	}
+	else
+	{
+		free_cpu_arr(m_cpu.memory);
 	}
 
-	Log("Load Done!");
-	return true;
+	m_memorySize = 0;
 }
 
 
@@ -280,6 +504,48 @@ void CpuManager::SetSound(iSound* sound)
 
 
 
+// writes one palette index per pixel in dest, row by row: 
+// bit 0 from the first plane, bit 1 from the second one.
+// dest must hold GetGfxSize() bytes.
+void CpuManager::ComposeGfx(uint8_t* dest) const
+{
+	static_assert(GFX_PLANES == 2, "ComposeGfx handles two planes");
+	ASSERT_MSG(compose_table_ready, "compose table not initialized");
+
+	const size_t words = GetPlaneSize();
+	const uint64_t* const plane0 = m_cpu.gfx;
+	const uint64_t* const plane1 = m_cpu.gfx + words;
+
+	for (size_t w = 0; w < words; ++w)
+	{
+		const uint64_t bits0 = plane0[w];
+		const uint64_t bits1 = plane1[w];
+
+		for (int shift = 56; shift >= 0; shift -= 8, dest += 8)
+		{
+			const uint64_t pixels = compose_table[(bits0 >> shift) & 0xFF] 
+			                       | (compose_table[(bits1 >> shift) & 0xFF] << 1);
+
+			memcpy(dest, &pixels, 8);
+		}
+	}
+}
+
+
+
+
+// hands the XO-Chip audio state to the sound plugin, 
+// the plain tone when no pattern was loaded.
+void CpuManager::SyncSoundPattern()
+{
+	if (GetFlags(Cpu::BAD_SOUND))
+		return;
+
+	m_cpu.sound->SetPattern(GetFlags(Cpu::AUDIO_PATTERN) ? m_cpu.pattern : nullptr, m_cpu.pitch);
+}
+
+
+
 iRender* CpuManager::SwapRender(iRender* render)
 {
 	ASSERT_MSG(render != m_cpu.render, "trying to swap the same addresses");
@@ -331,6 +597,18 @@ inline void set_plugin_flag(Cpu::Flags flag, const iPlugin* plugin, CpuManager&
 }
 
 
+// memory and stack are addressed through masks, their sizes are powers of two
+inline size_t pow2_size(const size_t size)
+{
+	size_t space = 1;
+	while (space < size)
+		space <<= 1;
+
+	return space;
+}
+
+
+
 template<class T>
 inline bool alloc_cpu_arr(const size_t size, T*& arr)
 {
@@ -377,6 +655,23 @@ inline void free_cpu_arr(T*& arr)
 
 
 
+// maps 8 pixels bits to 8 bytes of 0 or 1, msb at the lowest address
+static bool init_compose_table()
+{
+	for (unsigned byte = 0; byte < 256; ++byte)
+	{
+		uint8_t pixels[8];
+		for (int i = 0; i < 8; ++i)
+			pixels[i] = (byte >> (7 - i)) & 0x1;
+
+		memcpy(&compose_table[byte], pixels, 8);
+	}
+
+	return true;
+}
+
+
+
 // helpers definitions
 inline bool __alloc_arr(const size_t bytes, void*& arr)
 {
@@ -0,0 +1,399 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstring>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/Assert.h>
+
+#include <XChip/Core/Debugger.h>
+#include <XChip/Core/Disassembler.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+constexpr size_t Debugger::MAX_ADDRESS;
+constexpr size_t Debugger::MAX_CONDITIONS;
+
+
+// local functions declarations
+inline bool compare(const uint16_t a, const Debugger::Compare cmp, const uint16_t b);
+
+
+
+
+
+Debugger::Debugger() noexcept
+{
+	Log("Creating Debugger object...");
+	memset(m_conditions, 0, sizeof(m_conditions));
+}
+
+
+Debugger::~Debugger()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying Debugger object...");
+}
+
+
+
+bool Debugger::Initialize() noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	m_breakpoints = static_cast<uint64_t*>(alloc_arr(MAX_ADDRESS / 8));
+	m_watchpoints = static_cast<uint8_t*>(alloc_arr(MAX_ADDRESS));
+
+	if (!m_breakpoints || !m_watchpoints)
+	{
+		LogError("Debugger: cannot allocate breakpoints");
+		this->Dispose();
+		return false;
+	}
+
+	m_initialized = true;
+	this->ClearAll();
+	m_breakInfo = { Reason::NONE, 0, 0 };
+	m_run = Run::RUNNING;
+	m_resuming = false;
+	m_breakRequest = false;
+	return true;
+}
+
+
+
+void Debugger::Dispose() noexcept
+{
+	if (m_breakpoints)
+	{
+		free_arr(m_breakpoints);
+		m_breakpoints = nullptr;
+	}
+
+	if (m_watchpoints)
+	{
+		free_arr(m_watchpoints);
+		m_watchpoints = nullptr;
+	}
+
+	m_run = Run::RUNNING;
+	m_initialized = false;
+}
+
+
+
+
+void Debugger::SetBreakpoint(const uint16_t address, const bool val)
+{
+	ASSERT_MSG(m_initialized, "Debugger is not initialized");
+
+	const auto bit = uint64_t(1) << (address % 64);
+	if (val)
+		m_breakpoints[address / 64] |= bit;
+	else
+		m_breakpoints[address / 64] &= ~bit;
+}
+
+
+
+void Debugger::SetWatchpoint(const uint16_t address, const size_t size, const uint8_t watch)
+{
+	ASSERT_MSG(m_initialized, "Debugger is not initialized");
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		auto& mask = m_watchpoints[(address + i) % MAX_ADDRESS];
+		m_watchCount -= mask != 0;
+		mask = watch & (WATCH_READ | WATCH_WRITE);
+		m_watchCount += mask != 0;
+	}
+}
+
+
+
+
+int Debugger::AddCondition(const uint8_t reg, const Compare cmp, const uint16_t value)
+{
+	if (reg > REG_SP)
+		return -1;
+
+	for (size_t i = 0; i < MAX_CONDITIONS; ++i)
+	{
+		auto& cond = m_conditions[i];
+		if (!cond.active)
+		{
+			cond = { value, reg, cmp, true, false };
+			++m_conditionsCount;
+			return static_cast<int>(i);
+		}
+	}
+
+	LogError("Debugger: no room for more than %zu conditions", MAX_CONDITIONS);
+	return -1;
+}
+
+
+
+bool Debugger::RemoveCondition(const int index)
+{
+	if (index < 0 || static_cast<size_t>(index) >= MAX_CONDITIONS || !m_conditions[index].active)
+		return false;
+
+	m_conditions[index].active = false;
+	--m_conditionsCount;
+	return true;
+}
+
+
+
+bool Debugger::GetCondition(const int index, uint8_t& reg, Compare& cmp, uint16_t& value) const
+{
+	if (index < 0 || static_cast<size_t>(index) >= MAX_CONDITIONS || !m_conditions[index].active)
+		return false;
+
+	const auto& cond = m_conditions[index];
+	reg = cond.reg;
+	cmp = cond.cmp;
+	value = cond.value;
+	return true;
+}
+
+
+
+void Debugger::ClearAll()
+{
+	ASSERT_MSG(m_initialized, "Debugger is not initialized");
+
+	memset(m_breakpoints, 0, MAX_ADDRESS / 8);
+	memset(m_watchpoints, 0, MAX_ADDRESS);
+	memset(m_conditions, 0, sizeof(m_conditions));
+	m_conditionsCount = 0;
+	m_watchCount = 0;
+}
+
+
+
+
+
+void Debugger::Break()
+{
+	// taken by the next BeforeInstr, which knows the PC
+	m_breakRequest = true;
+}
+
+
+void Debugger::Continue()
+{
+	m_resuming = m_run == Run::PAUSED;
+	m_run = Run::RUNNING;
+}
+
+
+void Debugger::Step()
+{
+	m_resuming = true;
+	m_run = Run::STEP;
+}
+
+
+void Debugger::StepOver(const CpuManager& cpuMan)
+{
+	const auto pc = cpuMan.GetPC();
+	if ((*cpuMan.GetMemoryAt(pc) & 0xF0) != 0x20)
+	{
+		this->Step();
+		return;
+	}
+
+	// 2NNN: run until it returns to the next instruction, at the 
+	// same stack depth so recursive calls don't stop it early.
+	m_stopPC = static_cast<uint16_t>(pc + 2);
+	m_stopSP = cpuMan.GetSP();
+	m_resuming = true;
+	m_run = Run::STEP_OVER;
+}
+
+
+void Debugger::RunTo(const uint16_t address)
+{
+	m_stopPC = address;
+	m_resuming = m_run == Run::PAUSED;
+	m_run = Run::RUN_TO;
+}
+
+
+
+
+bool Debugger::BeforeInstr(const CpuManager& cpuMan)
+{
+	const auto pc = static_cast<uint16_t>(cpuMan.GetPC());
+
+	if (m_breakRequest)
+	{
+		m_breakRequest = false;
+		Pause(Reason::PAUSE, pc, pc);
+		return false;
+	}
+
+	if (m_run == Run::PAUSED)
+		return false;
+
+
+	// the instruction a resume starts at already had its break
+	if (m_resuming)
+	{
+		m_resuming = false;
+		return true;
+	}
+
+	if (TestBit(m_breakpoints, pc))
+	{
+		Pause(Reason::BREAKPOINT, pc, pc);
+		return false;
+	}
+
+	if ((m_run == Run::RUN_TO && pc == m_stopPC)
+		|| (m_run == Run::STEP_OVER && pc == m_stopPC && cpuMan.GetSP() == m_stopSP))
+	{
+		Pause(Reason::STEP, pc, pc);
+		return false;
+	}
+
+	return m_watchCount == 0 || !CheckWatchpoints(cpuMan);
+}
+
+
+
+
+void Debugger::AfterInstr(const CpuManager& cpuMan)
+{
+	const auto pc = static_cast<uint16_t>(cpuMan.GetPC());
+
+	for (size_t i = 0, left = m_conditionsCount; left > 0; ++i)
+	{
+		auto& cond = m_conditions[i];
+		if (!cond.active)
+			continue;
+
+		// breaks when the condition becomes true, not while it stays so
+		const bool now = compare(ReadRegister(cpuMan, cond.reg), cond.cmp, cond.value);
+		if (now && !cond.last && m_run != Run::PAUSED)
+			Pause(Reason::CONDITION, pc, static_cast<uint16_t>(i));
+
+		cond.last = now;
+		--left;
+	}
+
+	if (m_run == Run::STEP)
+		Pause(Reason::STEP, pc, pc);
+}
+
+
+
+
+uint16_t Debugger::ReadRegister(const CpuManager& cpuMan, const uint8_t reg)
+{
+	switch (reg)
+	{
+		case REG_I: return static_cast<uint16_t>(cpuMan.GetIndexRegister());
+		case REG_DT: return cpuMan.GetDelayTimer();
+		case REG_SP: return static_cast<uint16_t>(cpuMan.GetSP());
+		default: return cpuMan.GetRegisters(reg & 0xF);
+	}
+}
+
+
+
+
+
+void Debugger::Pause(const Reason reason, const uint16_t pc, const uint16_t address)
+{
+	m_run = Run::PAUSED;
+	m_breakInfo = { reason, pc, address };
+}
+
+
+
+
+bool Debugger::CheckWatchpoints(const CpuManager& cpuMan)
+{
+	// decode what the next instruction will touch, before it runs
+	const auto pc = cpuMan.GetPC();
+	const uint8_t* const code = cpuMan.GetMemoryAt(pc);
+	const uint16_t opcode = (code[0] << 8) | code[1];
+	size_t size;
+	const auto type = disassembler::GetAccess(opcode, cpuMan.GetFlags(Cpu::EXTENDED_MODE) != 0, size);
+
+	// DXYN reads one sprite for each plane selected by FN01
+	if ((opcode & 0xF000) == 0xD000)
+		size *= (cpuMan.GetPlanes() & 0x1) + ((cpuMan.GetPlanes() >> 1) & 0x1);
+
+	const uint8_t access = type == disassembler::ACCESS_READ ? WATCH_READ
+	                     : type == disassembler::ACCESS_WRITE ? WATCH_WRITE : 0;
+
+	const auto I = cpuMan.GetIndexRegister();
+	for (size_t i = 0; i < size; ++i)
+	{
+		// the same wrap the instructions use
+		const auto address = static_cast<uint16_t>((I + i) & cpuMan.GetMemoryMask());
+		if (m_watchpoints[address] & access)
+		{
+			Pause(access == WATCH_READ ? Reason::WATCH_READ : Reason::WATCH_WRITE, static_cast<uint16_t>(pc), address);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+inline bool compare(const uint16_t a, const Debugger::Compare cmp, const uint16_t b)
+{
+	switch (cmp)
+	{
+		case Debugger::Compare::EQUAL: return a == b;
+		case Debugger::Compare::NOT_EQUAL: return a != b;
+		case Debugger::Compare::LESS: return a < b;
+		case Debugger::Compare::GREATER: return a > b;
+	}
+
+	return false;
+}
+
+
+
+
+}
@@ -0,0 +1,213 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdio>
+#include <cstring>
+
+#include <XChip/Core/Disassembler.h>
+
+
+
+namespace xchip { namespace disassembler {
+
+
+// ordered so the first match wins, operands in syntax are
+// {x}, {y}: register digit  {n}: decimal  {nn}, {nnn}, {op}: hex
+const OpcodeInfo opcodeTable[OPCODE_TABLE_SIZE] =
+{
+	{ 0xFFFF, 0x00E0, "00E0", "CLS",                 FLOW_NEXT },
+	{ 0xFFFF, 0x00EE, "00EE", "RET",                 FLOW_RETURN },
+	{ 0xFFF0, 0x00C0, "00CN", "SCD {n}",             FLOW_NEXT },
+	{ 0xFFF0, 0x00D0, "00DN", "SCU {n}",             FLOW_NEXT },
+	{ 0xFFFF, 0x00FB, "00FB", "SCR",                 FLOW_NEXT },
+	{ 0xFFFF, 0x00FC, "00FC", "SCL",                 FLOW_NEXT },
+	{ 0xFFFF, 0x00FD, "00FD", "EXIT",                FLOW_STOP },
+	{ 0xFFFF, 0x00FE, "00FE", "LOW",                 FLOW_NEXT },
+	{ 0xFFFF, 0x00FF, "00FF", "HIGH",                FLOW_NEXT },
+	{ 0xF000, 0x1000, "1NNN", "JP 0x{nnn}",          FLOW_JUMP },
+	{ 0xF000, 0x2000, "2NNN", "CALL 0x{nnn}",        FLOW_CALL },
+	{ 0xF000, 0x3000, "3XNN", "SE V{x}, 0x{nn}",     FLOW_SKIP },
+	{ 0xF000, 0x4000, "4XNN", "SNE V{x}, 0x{nn}",    FLOW_SKIP },
+	{ 0xF00F, 0x5000, "5XY0", "SE V{x}, V{y}",       FLOW_SKIP },
+	{ 0xF00F, 0x5002, "5XY2", "LD [I], V{x}-V{y}",   FLOW_NEXT },
+	{ 0xF00F, 0x5003, "5XY3", "LD V{x}-V{y}, [I]",   FLOW_NEXT },
+	{ 0xF000, 0x6000, "6XNN", "LD V{x}, 0x{nn}",     FLOW_NEXT },
+	{ 0xF000, 0x7000, "7XNN", "ADD V{x}, 0x{nn}",    FLOW_NEXT },
+	{ 0xF00F, 0x8000, "8XY0", "LD V{x}, V{y}",       FLOW_NEXT },
+	{ 0xF00F, 0x8001, "8XY1", "OR V{x}, V{y}",       FLOW_NEXT },
+	{ 0xF00F, 0x8002, "8XY2", "AND V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x8003, "8XY3", "XOR V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x8004, "8XY4", "ADD V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x8005, "8XY5", "SUB V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x8006, "8XY6", "SHR V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x8007, "8XY7", "SUBN V{x}, V{y}",     FLOW_NEXT },
+	{ 0xF00F, 0x800E, "8XYE", "SHL V{x}, V{y}",      FLOW_NEXT },
+	{ 0xF00F, 0x9000, "9XY0", "SNE V{x}, V{y}",      FLOW_SKIP },
+	{ 0xF000, 0xA000, "ANNN", "LD I, 0x{nnn}",       FLOW_NEXT },
+	{ 0xF000, 0xB000, "BNNN", "JP V0, 0x{nnn}",      FLOW_INDIRECT },
+	{ 0xF000, 0xC000, "CXNN", "RND V{x}, 0x{nn}",    FLOW_NEXT },
+	{ 0xF000, 0xD000, "DXYN", "DRW V{x}, V{y}, {n}", FLOW_NEXT },
+	{ 0xF0FF, 0xE09E, "EX9E", "SKP V{x}",            FLOW_SKIP },
+	{ 0xF0FF, 0xE0A1, "EXA1", "SKNP V{x}",           FLOW_SKIP },
+	{ 0xF0FF, 0xF007, "FX07", "LD V{x}, DT",         FLOW_NEXT },
+	{ 0xFFFF, 0xF000, "F000", "LD I, LONG",          FLOW_NEXT },
+	{ 0xF0FF, 0xF001, "FN01", "PLANE {x}",           FLOW_NEXT },
+	{ 0xFFFF, 0xF002, "F002", "AUDIO",               FLOW_NEXT },
+	{ 0xF0FF, 0xF00A, "FX0A", "LD V{x}, K",          FLOW_NEXT },
+	{ 0xF0FF, 0xF015, "FX15", "LD DT, V{x}",         FLOW_NEXT },
+	{ 0xF0FF, 0xF018, "FX18", "LD ST, V{x}",         FLOW_NEXT },
+	{ 0xF0FF, 0xF01E, "FX1E", "ADD I, V{x}",         FLOW_NEXT },
+	{ 0xF0FF, 0xF029, "FX29", "LD F, V{x}",          FLOW_NEXT },
+	{ 0xF0FF, 0xF030, "FX30", "LD HF, V{x}",         FLOW_NEXT },
+	{ 0xF0FF, 0xF033, "FX33", "LD B, V{x}",          FLOW_NEXT },
+	{ 0xF0FF, 0xF03A, "FX3A", "PITCH V{x}",          FLOW_NEXT },
+	{ 0xF0FF, 0xF055, "FX55", "LD [I], V{x}",        FLOW_NEXT },
+	{ 0xF0FF, 0xF065, "FX65", "LD V{x}, [I]",        FLOW_NEXT },
+	{ 0xF0FF, 0xF075, "FX75", "LD R, V{x}",          FLOW_NEXT },
+	{ 0xF0FF, 0xF085, "FX85", "LD V{x}, R",          FLOW_NEXT },
+	{ 0x0000, 0x0000, "????", "DW 0x{op}",           FLOW_STOP }
+};
+
+
+
+
+size_t GetOpcodeIndex(const uint16_t opcode)
+{
+	// the catch-all entry ends the search
+	size_t i = 0;
+	while ((opcode & opcodeTable[i].mask) != opcodeTable[i].value)
+		++i;
+
+	return i;
+}
+
+
+
+const OpcodeInfo& GetOpcodeInfo(const uint16_t opcode)
+{
+	return opcodeTable[GetOpcodeIndex(opcode)];
+}
+
+
+
+bool IsKnownOpcode(const uint16_t opcode)
+{
+	return GetOpcodeIndex(opcode) != (OPCODE_TABLE_SIZE - 1);
+}
+
+
+
+// F000 NNNN* XO-Chip: the address follows the opcode
+size_t GetInstrSize(const uint16_t opcode)
+{
+	return opcode == 0xF000 ? 4 : 2;
+}
+
+
+
+
+size_t Disassemble(const uint16_t opcode, char* buffer, const size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	const char* src = GetOpcodeInfo(opcode).syntax;
+	size_t len = 0;
+
+	while (*src && len + 1 < size)
+	{
+		if (*src != '{')
+		{
+			buffer[len++] = *src++;
+			continue;
+		}
+
+		const char* const end = strchr(src, '}');
+		const auto field = static_cast<size_t>(end - src) - 1;
+		char operand[8];
+
+		if (field == 1 && src[1] == 'x')
+			snprintf(operand, sizeof(operand), "%X", (opcode >> 8) & 0xF);
+		else if (field == 1 && src[1] == 'y')
+			snprintf(operand, sizeof(operand), "%X", (opcode >> 4) & 0xF);
+		else if (field == 1)
+			snprintf(operand, sizeof(operand), "%u", opcode & 0xF);
+		else if (field == 2 && src[1] == 'n')
+			snprintf(operand, sizeof(operand), "%02X", opcode & 0xFF);
+		else if (field == 3)
+			snprintf(operand, sizeof(operand), "%03X", opcode & 0xFFF);
+		else
+			snprintf(operand, sizeof(operand), "%04X", opcode);
+
+		for (const char* op = operand; *op && len + 1 < size; ++op)
+			buffer[len++] = *op;
+
+		src = end + 1;
+	}
+
+	buffer[len] = '\0';
+	return len;
+}
+
+
+
+
+Access GetAccess(const uint16_t opcode, const bool extended, size_t& size)
+{
+	const size_t x = (opcode >> 8) & 0xF;
+
+	switch (opcode & 0xF0FF)
+	{
+		case 0xF033: size = 3; return ACCESS_WRITE;
+		case 0xF055: size = x + 1; return ACCESS_WRITE;
+		case 0xF065: size = x + 1; return ACCESS_READ;
+		default: break;
+	}
+
+	// 5XY2, 5XY3: VX to VY, either way round
+	if ((opcode & 0xF00E) == 0x5002)
+	{
+		const size_t y = (opcode >> 4) & 0xF;
+		size = (x > y ? x - y : y - x) + 1;
+		return (opcode & 0x1) ? ACCESS_READ : ACCESS_WRITE;
+	}
+
+	if (opcode == 0xF002)
+	{
+		size = 16;
+		return ACCESS_READ;
+	}
+
+	// DXY0 draws a 16x16 sprite in extended mode, nothing otherwise
+	if ((opcode & 0xF000) == 0xD000)
+	{
+		const size_t n = opcode & 0xF;
+		size = n ? n : (extended ? 32 : 0);
+		return size ? ACCESS_READ : ACCESS_NONE;
+	}
+
+	size = 0;
+	return ACCESS_NONE;
+}
+
+
+
+
+}}
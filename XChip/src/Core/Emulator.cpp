@@ -18,6 +18,8 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 
 */
 
+#include <chrono>
+#include <cstring>
 #include <XChip/Core/Emulator.h>
 #include <Utix/Log.h>
 #include <Utix/ScopeExit.h>
@@ -33,6 +35,7 @@ using namespace utix;
 // local functions declarations
 inline void init_emu_timers(Timer& instrTimer, Timer& frameTimer, Timer& chDelayTimer);
 inline bool init_cpu_manager(CpuManager& m_manager);
+inline bool reserve_gfx_modes(iRender& rend, const CpuManager& manager);
 
 
 
@@ -40,6 +43,9 @@ inline bool init_cpu_manager(CpuManager& m_manager);
 
 
 Emulator::Emulator() noexcept
+	: m_requests(0),
+	m_keyMask(0),
+	m_workerRunning(false)
 {
 	Log("Creating XChip Emulator object...");
 }
@@ -121,6 +127,7 @@ bool Emulator::Initialize(UniqueRender&& render, UniqueInput&& input, UniqueSoun
 
 void Emulator::Dispose() noexcept
 {
+	this->StopWorker();
 	m_manager.Dispose();
 	m_initialized = false;
 }
@@ -129,13 +136,50 @@ void Emulator::Dispose() noexcept
 
 
 
+bool Emulator::Clone(Emulator& dest) const
+{
+	if (!this->CloneState(dest))
+		return false;
+
+	// plugins are left alone, the render only gets the cloned screen.
+	// the sound plugin only takes the audio pattern state.
+	if (!dest.m_manager.GetFlags(Cpu::BAD_RENDER))
+	{
+		dest.m_manager.ComposeGfx(dest.m_screen);
+		dest.SyncRender(dest.m_manager.GetGfxRes(), dest.m_screen);
+	}
+
+	dest.m_manager.SyncSoundPattern();
+	return true;
+}
+
+
+
+
+
 void Emulator::HaltForNextFlag() const
 {
-	if (! m_manager.GetFlags(Cpu::DRAW | Cpu::INSTR))
+	// in an idle loop, waiting a key or held by the host only the next delay 
+	// timer tick or frame can change anything, the instruction slots are not waited for
+	const bool idle = m_idle || m_manager.GetFlags(Cpu::WAIT_KEY | Cpu::HOLD);
+	const uint32_t waitFlags = idle ? Cpu::DRAW : (Cpu::DRAW | Cpu::INSTR);
+
+	if (! m_manager.GetFlags(waitFlags))
 	{
-		const auto instrRemain = m_instrTimer.GetRemain();
+		const auto instrRemain = idle ? m_chDelayTimer.GetRemain() : m_instrTimer.GetRemain();
 		const auto frameRemain = m_frameTimer.GetRemain();
-		utix::Sleep((instrRemain < frameRemain) ? instrRemain : frameRemain);
+		const auto remain = (instrRemain < frameRemain) ? instrRemain : frameRemain;
+
+		if (!m_stats.IsEnabled())
+		{
+			utix::Sleep(remain);
+			return;
+		}
+
+		const auto begin = StatsCollector::Now();
+		utix::Sleep(remain);
+		const auto asked = std::chrono::duration_cast<std::chrono::nanoseconds>(remain).count();
+		m_stats.AddSleep(asked > 0 ? asked : 0, StatsCollector::Now() - begin);
 	}
 }
 
@@ -147,35 +191,220 @@ void Emulator::UpdateTimers()
 	{
 		m_manager.SetFlags(Cpu::INSTR);
 		m_instrTimer.Start();
+
+		if (m_stats.IsEnabled())
+			m_stats.AddInstrSlot(StatsCollector::Now(), m_instrTimer.GetTargetHz());
 	}
 
 	if (!m_manager.GetFlags(Cpu::DRAW) && m_frameTimer.Finished())
 	{
 		m_manager.SetFlags(Cpu::DRAW);
 		m_frameTimer.Start();
+
+		if (m_stats.IsEnabled())
+			m_stats.AddFrameSlot(StatsCollector::Now(), m_frameTimer.GetTargetHz());
 	}
 
 	
 
 	if (m_chDelayTimer.Finished())
 	{
-		auto& delayTimer = m_manager.GetCpu().delayTimer;
-		if (delayTimer)
-			--delayTimer;
+		// the debugger and the host stop the time while paused
+		if (!m_manager.GetFlags(Cpu::PAUSE | Cpu::HOLD))
+			this->TickTimers();
 
 		m_chDelayTimer.Start();
+		m_idle = false;
 	}
 }
 
 
- 
-void Emulator::UpdateSystems()
+
+// one 60hz tick of emulated time. The sound plugin renders the 
+// tick's audio from the sound timer, so the sound follows the
+// emulated timeline: turbo, bursts and pauses included.
+void Emulator::TickTimers()
 {
-	ASSERT_MSG(!m_manager.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-	ASSERT_MSG(!m_manager.GetFlags(Cpu::BAD_INPUT),  "BAD INPUT");
-	m_manager.GetRender()->UpdateEvents();
-	m_manager.GetInput()->UpdateKeys();
-	this->UpdateTimers();
+	auto& cpu = m_manager.GetCpu();
+
+	if (!m_manager.GetFlags(Cpu::BAD_SOUND))
+		cpu.sound->Tick(cpu.soundTimer);
+
+	if (cpu.delayTimer)
+		--cpu.delayTimer;
+
+	if (cpu.soundTimer)
+		--cpu.soundTimer;
+}
+
+
+
+
+
+// runs one emulated frame without pacing: GetCpuFreq() / GetFps() 
+// instructions and the 60hz timers advanced by one frame. 
+// the wall clock timers are not used nor touched, so a run 
+// is reproducible. returns the instructions executed, idle
+// loop iterations skipped by SetIdleSkipEnabled included.
+// keys are not polled here, a FX0A wait ends the frame's work.
+size_t Emulator::RunFrameUncapped()
+{
+	if (m_requests.load(std::memory_order_relaxed))
+		this->ApplyRequests();
+
+	// held by the host, the frame passes with no emulated time
+	if (m_manager.GetFlags(Cpu::HOLD))
+		return 0;
+
+	const int fps = GetFps();
+
+	// carry the remainders, so non multiple rates are exact over time
+	m_uncappedInstrs += GetCpuFreq();
+	size_t executed = 0;
+
+	// hooks are checked once per frame, not per instruction
+	if (!m_hooks && !m_idleSkip)
+	{
+		for (; m_uncappedInstrs >= fps && !m_manager.GetFlags(Cpu::EXIT | Cpu::WAIT_KEY); m_uncappedInstrs -= fps, ++executed)
+			instructions::ExecuteInstruction(m_manager);
+	}
+	else if (!m_hooks)
+	{
+		for (; m_uncappedInstrs >= fps && !m_manager.GetFlags(Cpu::EXIT | Cpu::WAIT_KEY); m_uncappedInstrs -= fps, ++executed)
+		{
+			instructions::ExecuteInstruction(m_manager);
+			if (m_manager.GetOpcode(0xF000) != 0x1000)
+				continue;
+
+			// the delay timer and keys hold still until the frame ends, so
+			// whole iterations of an idle loop change nothing. Skipping only
+			// whole ones leaves the loop where running it would have.
+			const int length = this->CheckIdleLoop();
+			if (length)
+			{
+				const int remain = (m_uncappedInstrs / fps) - 1;
+				const int skip = remain - (remain % length);
+				m_uncappedInstrs -= skip * fps;
+				executed += skip;
+				m_stats.AddIdle(skip);
+			}
+		}
+	}
+	else
+	{
+		for (; m_uncappedInstrs >= fps && !m_manager.GetFlags(Cpu::EXIT | Cpu::WAIT_KEY); m_uncappedInstrs -= fps, ++executed)
+		{
+			if (!this->ExecuteHooked())
+			{
+				// paused by the debugger, the time stops with it
+				m_uncappedInstrs = 0;
+				break;
+			}
+		}
+	}
+
+	// the slots left while waiting a key are lost, as they are paced
+	if (m_manager.GetFlags(Cpu::WAIT_KEY))
+		m_uncappedInstrs %= fps;
+
+	m_manager.UnsetFlags(Cpu::INSTR);
+	m_stats.AddInstr(executed);
+
+	// no frames are drawn here, the window is checked per run
+	if (m_stats.IsEnabled())
+		m_stats.Update(StatsCollector::Now());
+
+	if (m_manager.GetFlags(Cpu::PAUSE))
+		return executed;
+
+	for (m_uncappedTicks += 60; m_uncappedTicks >= fps; m_uncappedTicks -= fps)
+		this->TickTimers();
+
+	return executed;
+}
+
+
+
+
+// the instrumented path: trace and debugger. returns 
+// false when the debugger kept the instruction from running.
+bool Emulator::ExecuteHooked()
+{
+	if (m_hooks & HOOK_DEBUGGER)
+	{
+		if (!m_debugger.BeforeInstr(m_manager))
+		{
+			m_manager.SetFlags(Cpu::PAUSE);
+			return false;
+		}
+
+		m_manager.UnsetFlags(Cpu::PAUSE);
+	}
+
+	if (m_hooks & HOOK_TRACE)
+		m_trace.Execute(m_manager);
+	else
+		instructions::ExecuteInstruction(m_manager);
+
+	if (m_hooks & HOOK_DEBUGGER)
+	{
+		m_debugger.AfterInstr(m_manager);
+		if (m_debugger.IsPaused())
+			m_manager.SetFlags(Cpu::PAUSE);
+	}
+
+	return true;
+}
+
+
+
+
+// instructions in the idle loop at PC, or 0. The loops waiting on
+// the delay timer or a key change nothing while what they wait on 
+// stays the same, so they can be skipped up to the next timer tick
+// or key poll. FX07 loops are left as one iteration would leave
+// them, VX holding the delay timer:
+//	1NNN (NNN = PC)                  forever
+//	EX9E / EXA1, 1NNN (NNN = PC)     until key VX is pressed / released
+//	FX07, 3XNN / 4XNN, 1NNN (NNN = PC) until the delay timer is / is not NN
+int Emulator::CheckIdleLoop()
+{
+	// 1NNN reaches 12 bits only
+	const auto pc = m_manager.GetPC();
+	if (pc > 0xFFF || pc + 6 > m_manager.GetMemorySize())
+		return 0;
+
+	const uint8_t* const code = &m_manager.GetMemory(pc);
+	const auto op = [code](const size_t i) { return static_cast<uint16_t>((code[i * 2] << 8) | code[(i * 2) + 1]); };
+	const uint16_t jumpBack = 0x1000 | static_cast<uint16_t>(pc);
+	const uint16_t kind = op(0) & 0xF0FF;
+	const uint16_t x = op(0) & 0x0F00;
+
+	if (op(0) == jumpBack)
+		return 1;
+
+	if ((kind == 0xE09E || kind == 0xE0A1) && op(1) == jumpBack)
+	{
+		const bool pressed = ((m_manager.GetKeys() >> (m_manager.GetRegisters(x >> 8) & 0xF)) & 0x1) != 0;
+		return ((kind == 0xE09E) != pressed) ? 2 : 0;
+	}
+
+	if (kind == 0xF007 && op(2) == jumpBack && (op(1) & 0x0F00) == x)
+	{
+		const auto nn = op(1) & 0x00FF;
+		const auto delayTimer = m_manager.GetDelayTimer();
+
+		const bool idle = ((op(1) & 0xF000) == 0x3000 && delayTimer != nn)
+		               || ((op(1) & 0xF000) == 0x4000 && delayTimer == nn);
+
+		if (idle)
+		{
+			m_manager.GetRegisters(x >> 8) = delayTimer;
+			return 3;
+		}
+	}
+
+	return 0;
 }
 
 
@@ -183,8 +412,8 @@ void Emulator::UpdateSystems()
 
 void Emulator::CleanFlags()
 {
-	// clean flags but keep bad flags.
-	const auto badFlags = m_manager.GetFlags(Cpu::BAD_RENDER | Cpu::BAD_INPUT | Cpu::BAD_SOUND);
+	// clean flags but keep bad flags and the host's pause.
+	const auto badFlags = m_manager.GetFlags(Cpu::BAD_RENDER | Cpu::BAD_INPUT | Cpu::BAD_SOUND | Cpu::HOLD);
 	m_manager.CleanFlags();
 	m_manager.SetFlags(badFlags);
 }
@@ -197,10 +426,13 @@ void Emulator::Reset()
 		m_soundPlugin->Stop();
 
 	CleanFlags();
+	m_manager.SetExtendedGfx(false);
 	m_manager.CleanGfx();
 	m_manager.CleanStack();
 	m_manager.CleanRegisters();
+	m_manager.SyncSoundPattern();
 	m_manager.SetPC(0x200);
+	m_idle = false;
 }
 
 
@@ -310,14 +542,18 @@ bool Emulator::InitRender()
 		return false;
 	} 
 	else if (rend->IsInitialized()) {
-		return true;
+		return reserve_gfx_modes(*rend, m_manager);
 	} 
-	else if (!rend->Initialize({512, 256}, m_manager.GetGfxRes())) {
+	else if (!rend->Initialize({512, 256}, m_manager.GetGfxRes()) 
+		|| !reserve_gfx_modes(*rend, m_manager)) {
 		return false;
 	}
 
-	rend->SetBuffer(m_manager.GetGfx());
-	rend->SetWinCloseCallback(&m_manager, [](const void* man) { ((CpuManager*)man)->SetFlags(Cpu::EXIT); });
+	m_manager.ComposeGfx(m_screen);
+	rend->SetBuffer(m_screen);
+	rend->SetWinCloseCallback(this, [](const void* _this) { ((Emulator*)_this)->PostRequest(REQ_EXIT); });
+	m_renderGfx = m_screen;
+	m_renderRes = m_manager.GetGfxRes();
 	return true;
 }
 
@@ -344,31 +580,10 @@ bool Emulator::InitInput()
 	}
 
 
-	input->SetEscapeKeyCallback(&m_manager, [](const void* man){ ((CpuManager*)man)->SetFlags(Cpu::EXIT); });
-	input->SetResetKeyCallback(this, [](const void* _this) { ((Emulator*)_this)->Reset(); });
-	input->SetWaitKeyCallback(this, [](const void* g_emulator)
-	{
-		auto* const emulator = (Emulator*) g_emulator;
-		
-		do
-		{		
-			emulator->GetRender()->UpdateEvents();
-			emulator->UpdateTimers();
-			
-			if (emulator->GetExitFlag())
-				return false;
-
-			if (emulator->GetDrawFlag())
-				emulator->Draw();
-
-
-			emulator->HaltForNextFlag();
-
-		}while(!emulator->GetInstrFlag());
-
-
-		return true;
-	});
+	// callbacks run on the thread updating the plugins, which may not
+	// be the emulation one: they only post requests for it to take.
+	input->SetEscapeKeyCallback(this, [](const void* _this) { ((Emulator*)_this)->PostRequest(REQ_EXIT); });
+	input->SetResetKeyCallback(this, [](const void* _this) { ((Emulator*)_this)->PostRequest(REQ_RESET); });
 
 	return true;
 }
@@ -403,6 +618,275 @@ bool Emulator::InitSound()
 
 
 
+void Emulator::RequestExit()
+{
+	this->PostRequest(REQ_EXIT);
+}
+
+
+
+void Emulator::RequestReset()
+{
+	this->PostRequest(REQ_RESET);
+}
+
+
+
+void Emulator::RequestPause(const bool val)
+{
+	// the last one posted wins, pause and resume are never both pending
+	const uint32_t request = val ? REQ_PAUSE : REQ_RESUME;
+	auto requests = m_requests.load(std::memory_order_relaxed);
+	while (!m_requests.compare_exchange_weak(requests, (requests & ~(REQ_PAUSE | REQ_RESUME)) | request,
+	                                         std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+
+
+bool Emulator::PostCommand(const Command& command)
+{
+	if (!m_commands.Push(command))
+		return false;
+
+	// after the push, so the emulation thread finds it once it sees the bit
+	this->PostRequest(REQ_COMMAND);
+	return true;
+}
+
+
+
+void Emulator::PostRequest(const uint32_t request)
+{
+	m_requests.fetch_or(request, std::memory_order_release);
+}
+
+
+
+void Emulator::ApplyRequests()
+{
+	const auto requests = m_requests.exchange(0, std::memory_order_acquire);
+
+	if (requests & REQ_RESET)
+		this->Reset();
+
+	if (requests & REQ_PAUSE)
+		m_manager.SetFlags(Cpu::HOLD);
+	else if (requests & REQ_RESUME)
+		m_manager.UnsetFlags(Cpu::HOLD);
+
+	// commands pushed after the bit was taken post it again
+	if (requests & REQ_COMMAND)
+	{
+		Command command;
+		while (m_commands.Pop(command))
+			this->ApplyCommand(command);
+	}
+
+	if (requests & REQ_EXIT)
+		m_manager.SetFlags(Cpu::EXIT);
+}
+
+
+
+// the machine and the timing state only, dest plugins are not touched.
+// So it can run on the emulation thread for a dest owned by another one.
+bool Emulator::CloneState(Emulator& dest) const
+{
+	ASSERT_MSG(&dest != this, "trying to clone into itself");
+	ASSERT_MSG(m_initialized, "cloning an uninitialized Emulator");
+
+	if (!m_manager.CloneInto(dest.m_manager))
+		return false;
+
+	dest.m_instrTimer = m_instrTimer;
+	dest.m_frameTimer = m_frameTimer;
+	dest.m_chDelayTimer = m_chDelayTimer;
+	// and the uncapped remainders and idle state, so a clone run with
+	// RunFrameUncapped() steps the same instructions as its source
+	dest.m_uncappedInstrs = m_uncappedInstrs;
+	dest.m_uncappedTicks = m_uncappedTicks;
+	dest.m_idleSkip = m_idleSkip;
+	dest.m_idle = m_idle;
+
+	dest.m_initialized = true;
+	return true;
+}
+
+
+
+
+void Emulator::ApplyCommand(const Command& command)
+{
+	switch (command.type)
+	{
+		case Command::SET_CPU_FREQ: this->SetCpuFreq(command.value); break;
+		case Command::SET_FPS: this->SetFps(command.value); break;
+		case Command::SAVE_STATE:
+		{
+			// taken between bursts, the state is consistent. dest
+			// plugins belong to the host thread, they are not synced
+			const bool success = this->CloneState(*command.dest);
+			if (command.done)
+				command.done(command.arg, success);
+			break;
+		}
+	}
+}
+
+
+
+bool Emulator::SyncRender(const Vec2i& res, const uint8_t* gfx)
+{
+	iRender* const rend = m_manager.GetRender();
+
+	if (m_renderRes != res && !rend->SetResolution(res))
+	{
+		LogError("Could not set the render resolution to %dx%d", res.x, res.y);
+		return false;
+	}
+
+	rend->SetBuffer(gfx);
+	m_renderGfx = gfx;
+	m_renderRes = res;
+	return true;
+}
+
+
+
+
+
+
+bool Emulator::StartWorker()
+{
+	ASSERT_MSG(m_initialized && Good(), "starting the worker of a not ready Emulator");
+	ASSERT_MSG(!m_worker.joinable(), "the worker is already running");
+
+	// room for SuperChip's extended mode, whatever the gfx is now
+	if (!m_frames.Initialize(CpuManager::MAX_GFX_SIZE))
+		return false;
+
+	m_keyMask.store(m_manager.GetKeys(), std::memory_order_relaxed);
+	m_presentTimer.SetTargetHz(GetFps());
+	m_presentTimer.Start();
+	m_workerRunning.store(true, std::memory_order_relaxed);
+	m_worker = std::thread(&Emulator::WorkerLoop, this);
+	return true;
+}
+
+
+
+void Emulator::StopWorker()
+{
+	if (!m_worker.joinable())
+		return;
+
+	m_workerRunning.store(false, std::memory_order_relaxed);
+	m_worker.join();
+
+	// Draw() presents from the gfx again
+	m_frames.Dispose();
+	if (!m_manager.GetFlags(Cpu::BAD_RENDER))
+	{
+		m_manager.ComposeGfx(m_screen);
+		this->SyncRender(m_manager.GetGfxRes(), m_screen);
+	}
+}
+
+
+
+// the presentation side of the threaded mode. The plugins stay on this
+// thread: window events, keys and drawing. Returns false once the 
+// worker stopped, on exit or StopWorker().
+bool Emulator::UpdatePresentation()
+{
+	ASSERT_MSG(m_worker.joinable(), "the worker is not running");
+
+	// at the frame rate, a frame can't come any sooner
+	utix::Sleep(m_presentTimer.GetRemain());
+	m_presentTimer.Start();
+
+	iInput* const input = m_manager.GetInput();
+	m_manager.GetRender()->UpdateEvents();
+	input->UpdateKeys();
+	m_keyMask.store(input->GetKeyMask(), std::memory_order_relaxed);
+
+	const Frame* const frame = m_frames.Acquire();
+	if (frame)
+	{
+		// a slow present or a vsync wait only holds this thread
+		if (!this->SyncRender(frame->res, frame->pixels))
+		{
+			this->PostRequest(REQ_EXIT);
+		}
+		else if (m_stats.IsEnabled())
+		{
+			const auto begin = StatsCollector::Now();
+			m_manager.GetRender()->DrawBuffer();
+			m_stats.AddPresent(StatsCollector::Now() - begin);
+		}
+		else
+		{
+			m_manager.GetRender()->DrawBuffer();
+		}
+	}
+
+	return m_workerRunning.load(std::memory_order_acquire);
+}
+
+
+
+
+void Emulator::PublishFrame()
+{
+	Frame& frame = m_frames.GetBack();
+	ASSERT_MSG(m_manager.GetGfxSize() <= m_frames.GetMaxPixels(), "gfx bigger than the frames");
+
+	m_manager.ComposeGfx(frame.pixels);
+	frame.res = m_manager.GetGfxRes();
+	m_frames.Publish();
+
+	// the stats count frames handed to the presentation thread,
+	// their draw time is taken there by UpdatePresentation()
+	if (m_stats.IsEnabled())
+		m_stats.AddFrame(0, StatsCollector::Now());
+
+	m_manager.UnsetFlags(Cpu::DRAW);
+}
+
+
+
+// the emulation thread: UpdateSystems() with the plugins left to the 
+// presentation thread, and frames published instead of drawn.
+void Emulator::WorkerLoop()
+{
+	while (m_workerRunning.load(std::memory_order_relaxed) && !m_manager.GetFlags(Cpu::EXIT))
+	{
+		if (m_requests.load(std::memory_order_relaxed))
+			this->ApplyRequests();
+
+		m_manager.SetKeys(m_keyMask.load(std::memory_order_relaxed));
+		if (m_manager.GetFlags(Cpu::WAIT_KEY))
+			instructions::PollWaitKey(m_manager);
+
+		this->UpdateTimers();
+		this->HaltForNextFlag();
+
+		if (m_manager.GetFlags(Cpu::INSTR))
+			this->ExecuteInstr();
+
+		if (m_manager.GetFlags(Cpu::DRAW))
+			this->PublishFrame();
+	}
+
+	m_workerRunning.store(false, std::memory_order_release);
+}
+
+
+
+
+
 
 
 
@@ -426,10 +910,10 @@ inline void init_emu_timers(Timer& instrTimer, Timer& frameTimer, Timer& chDelay
 inline bool init_cpu_manager(CpuManager& manager)
 {
 	// init the CPU
-	if (manager.SetMemory(0xFFFF)
+	if (manager.SetMemory(CpuManager::MAX_MEMORY_SIZE)
 		&& manager.SetRegisters(0x10)
 		&& manager.SetStack(0x10)
-		&& manager.SetGfxRes(64, 32))
+		&& manager.SetGfxModes({64, 32}, {128, 64}))
 	{
 		manager.SetPC(0x200);
 		manager.LoadDefaultFont();
@@ -442,6 +926,21 @@ inline bool init_cpu_manager(CpuManager& manager)
 
 
 
+// 00FE/00FF switch the render between these, no texture is made then
+inline bool reserve_gfx_modes(iRender& rend, const CpuManager& manager)
+{
+	if (rend.ReserveResolution(manager.GetGfxModeRes(false))
+		&& rend.ReserveResolution(manager.GetGfxModeRes(true)))
+	{
+		return true;
+	}
+
+	LogError("Could not reserve the render resolutions");
+	return false;
+}
+
+
+
 
 
 
@@ -21,6 +21,10 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #include <XChip/Plugins.h>
 #include <XChip/Core.h>
 
+#ifdef XCHIP_PROFILER
+#include <XChip/Core/Profiler.h>
+#endif
+
 
 
 namespace xchip { namespace instructions {
@@ -42,7 +46,7 @@ using namespace utix;
 InstrTable instrTable[16] =
 {
 	op_0xxx, op_1NNN, op_2NNN, op_3XNN,
-	op_4XNN, op_5XY0, op_6XNN, op_7XNN,
+	op_4XNN, op_5XYx, op_6XNN, op_7XNN,
 	op_8XYx, op_9XY0, op_ANNN, op_BNNN,
 	op_CXNN, op_DXYN, op_EXxx, op_FXxx
 };
@@ -54,6 +58,7 @@ void UnknownOpcode(CpuManager& cpuMan)
 {
 	LogError("Unknown Opcode: $%X", cpuMan.GetOpcode());
 	cpuMan.SetFlags(Cpu::EXIT);
+	TraceBuffer::DumpCrash(&cpuMan);
 }
 
 
@@ -66,35 +71,80 @@ void ExecuteInstruction(CpuManager& cpuMan)
 
 	ASSERT_MSG(static_cast<size_t>(OPMSN) < arr_size(instrTable), "Instruction Table Overflow!");
 	
+#ifdef XCHIP_PROFILER
+	const auto pc = static_cast<uint16_t>(cpuMan.GetPC() - 2);
+	const auto opcode = cpuMan.GetOpcode();
+	const auto begin = profiler::Now();
+	instrTable[OPMSN](cpuMan);
+	profiler::Record(pc, opcode, profiler::Now() - begin);
+#else
 	// send the opcode most significant nibble to the first instruction table
 	instrTable[OPMSN](cpuMan);
+#endif
+}
+
+
+
+
+bool PollWaitKey(CpuManager& cpuMan)
+{
+	ASSERT_MSG(cpuMan.GetFlags(Cpu::WAIT_KEY), "Cpu is not waiting for a key");
+
+	// keys held since FX0A must be released before they count again
+	auto& cpu = cpuMan.GetCpu();
+	const uint16_t pressed = cpu.keys;
+	const uint16_t newKeys = pressed & ~cpu.waitKeys;
+	cpu.waitKeys &= pressed;
+
+	if (newKeys == 0)
+		return false;
+
+	uint8_t key = 0;
+	while (!(newKeys & (1 << key)))
+		++key;
+
+	// the opcode stays FX0A while the cpu waits
+	VX = key;
+	cpuMan.UnsetFlags(Cpu::WAIT_KEY);
+	return true;
 }
 
 
 
 
+// gfx helpers, they act on the planes selected by FN01.
+// rows are words of 64 pixels, the leftmost pixel in the msb
+static void clear_planes(CpuManager& cpuMan);
+static void scroll_rows(CpuManager& cpuMan, const int lines);
+static void scroll_pixels(CpuManager& cpuMan, const int pixels);
+static void draw_sprite(CpuManager& cpuMan, const int width, const int height);
+
+// memory copies to and from the registers wrap into the memory start, so
+// what FX55 wrote FX65 reads back. Sprites read through GetMemoryAt, which
+// wraps the address only and leaves the guard tail readable.
+static inline void write_memory(CpuManager& cpuMan, const size_t address, const uint8_t* data, const size_t size);
+static inline void read_memory(const CpuManager& cpuMan, const size_t address, uint8_t* dest, const size_t size);
+
+
+
+
 void op_0xxx(CpuManager& cpuMan)
 {
 	switch (cpuMan.GetOpcode())
 	{
 		case 0x00E0: // clear screen
-			cpuMan.CleanGfx();
+			clear_planes(cpuMan);
 			break;
 
-		case 0x00EE: // return from a subroutine ( unwind stack )
-			cpuMan.SetSP(cpuMan.GetSP() - 1);
+		case 0x00EE: // return from a subroutine ( unwind stack ), SP wraps around the stack
+			cpuMan.SetSP((cpuMan.GetSP() - 1) & cpuMan.GetStackMask());
 			cpuMan.SetPC(cpuMan.GetStack(cpuMan.GetSP()));
 			break;
 
 		case 0x00FB: // 0x00FB* SuperChip: scrolls display 4 pixels right:
 		{
 			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-			const auto res = cpuMan.GetGfxRes();
-			for (int y = 0; y < res.y; ++y) {
-				uint32_t* const lineBeg = cpuMan.GetGfx() + res.x * y;
-				std::copy_n(lineBeg, res.x - 4, lineBeg+4);
-				std::fill_n(lineBeg, 4, 0);
-			}
+			scroll_pixels(cpuMan, 4);
 			break;
 		}
 
@@ -102,12 +152,7 @@ void op_0xxx(CpuManager& cpuMan)
 		case 0x00FC: // 0x00FC* SuperChip: scrolls display 4 pixels left:
 		{
 			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-			const auto res = cpuMan.GetGfxRes();
-			for (int y = 0; y < res.y; ++y) {
-				uint32_t* const lineBeg = cpuMan.GetGfx() + res.x * y;
-				std::copy_n(lineBeg+4, res.x-4, lineBeg);
-				std::fill_n(lineBeg + res.x-4, 4, 0); 
-			}
+			scroll_pixels(cpuMan, -4);
 			break;
 		}
 
@@ -118,61 +163,28 @@ void op_0xxx(CpuManager& cpuMan)
 
 
 
+		// the render is not touched here, it follows the gfx on the next draw
 		case 0x00FE: // 0x00FE* SuperChip:  Disable extended screen mode
-		{
-			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-			
-			constexpr Vec2i defaultRes(64,32);
-		
-			if (!cpuMan.GetRender()->SetResolution(defaultRes))
-			{
-				LogError("Could not unset extended resolution mode!");
-				cpuMan.SetFlags(Cpu::EXIT);
-			}
-
-			cpuMan.SetGfxRes(defaultRes);
-			cpuMan.GetRender()->SetBuffer(cpuMan.GetGfx());
-			cpuMan.UnsetFlags(Cpu::EXTENDED_MODE);
-			
-			instrTable[0xD] = &op_DXYN;
-
+			cpuMan.SetExtendedGfx(false);
 			break;
 
-		}
-
 
 		case 0x00FF: // 0x00FF* SuperChip: Enable extended screen mode 
-		{
-			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-			
-			constexpr Vec2i extendedRes(128, 64);
-		
-			if(!cpuMan.GetRender()->SetResolution( extendedRes ))
-			{
-				LogError("Could not set extended resolution mode!");
-				cpuMan.SetFlags(Cpu::EXIT);
-			}
-
-			cpuMan.SetGfxRes(extendedRes);
-			cpuMan.GetRender()->SetBuffer(cpuMan.GetGfx());
-			cpuMan.SetFlags(Cpu::EXTENDED_MODE);
-			
-			instrTable[0xD] = &op_DXYN_ex;
-
+			cpuMan.SetExtendedGfx(true);
 			break;
-		}
 
 
-		default: // 0NNN or 00CN
+		default: // 0NNN, 00CN or 00DN
 		{
 			if( (cpuMan.GetOpcode(0x00F0)) == 0x00C0 ) {
 				ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
 				// 00CN* SuperChip: Scroll display N lines down:
-				const auto res = cpuMan.GetGfxRes();
-				uint32_t* const gfx = cpuMan.GetGfx();
-				const int lines = N;
-				std::copy_n(gfx, (res.y-lines) * res.x, gfx + (lines * res.x));
-				std::fill_n(gfx, lines * res.x, 0);
+				scroll_rows(cpuMan, N);
+
+			} else if( (cpuMan.GetOpcode(0xFFF0)) == 0x00D0 ) {
+				ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
+				// 00DN* XO-Chip: Scroll display N lines up:
+				scroll_rows(cpuMan, -N);
 
 			} else {
 				UnknownOpcode(cpuMan);
@@ -195,10 +207,11 @@ void op_1NNN(CpuManager& cpuMan)
 
 
 // 2NNN: Calls subroutine at address NNN
+// too deep calls wrap around, overwriting the oldest return addresses
 void op_2NNN(CpuManager& cpuMan)
 {
 	cpuMan.GetStack(cpuMan.GetSP()) = cpuMan.GetPC();
-	cpuMan.SetSP( cpuMan.GetSP() + 1 );
+	cpuMan.SetSP( (cpuMan.GetSP() + 1) & cpuMan.GetStackMask() );
 	cpuMan.SetPC( NNN );
 }
 
@@ -208,7 +221,7 @@ void op_2NNN(CpuManager& cpuMan)
 void op_3XNN(CpuManager& cpuMan)
 {
 	if (VX == NN)
-		cpuMan.SetPC( cpuMan.GetPC() + 2 );
+		cpuMan.SkipInstruction();
 }
 
 
@@ -217,7 +230,24 @@ void op_3XNN(CpuManager& cpuMan)
 void op_4XNN(CpuManager& cpuMan)
 {
 	if (VX != NN)
-		cpuMan.SetPC( cpuMan.GetPC() + 2 );
+		cpuMan.SkipInstruction();
+}
+
+
+
+// 5XYx Subtable
+static InstrTable op_5XYx_Table[16] =
+{
+	op_5XY0, UnknownOpcode, op_5XY2, op_5XY3,
+	UnknownOpcode, UnknownOpcode, UnknownOpcode, UnknownOpcode,
+	UnknownOpcode, UnknownOpcode, UnknownOpcode, UnknownOpcode,
+	UnknownOpcode, UnknownOpcode, UnknownOpcode, UnknownOpcode
+};
+
+
+void op_5XYx(CpuManager& cpuMan)
+{
+	op_5XYx_Table[N](cpuMan);
 }
 
 
@@ -226,10 +256,58 @@ void op_4XNN(CpuManager& cpuMan)
 void op_5XY0(CpuManager& cpuMan)
 {
 	if (VX == VY)
-		cpuMan.SetPC( cpuMan.GetPC() + 2 );
+		cpuMan.SkipInstruction();
+}
+
+
+// 5XY2* XO-Chip: Stores VX to VY in memory starting at address I, 
+// in descending order when X > Y. I is not changed
+void op_5XY2(CpuManager& cpuMan)
+{
+	const auto x = X;
+	const auto y = Y;
+	const auto I = cpuMan.GetIndexRegister();
+	const size_t count = (x > y ? x - y : y - x) + 1;
+	const uint8_t* const registers = cpuMan.GetRegisters();
+
+	if (x <= y)
+	{
+		write_memory(cpuMan, I, registers + x, count);
+	}
+	else
+	{
+		uint8_t reversed[16];
+		std::reverse_copy(registers + y, registers + x + 1, reversed);
+		write_memory(cpuMan, I, reversed, count);
+	}
+}
+
+
+
+// 5XY3* XO-Chip: Fills VX to VY with values from memory starting at address I,
+// in descending order when X > Y. I is not changed
+void op_5XY3(CpuManager& cpuMan)
+{
+	const auto x = X;
+	const auto y = Y;
+	const auto I = cpuMan.GetIndexRegister();
+	const size_t count = (x > y ? x - y : y - x) + 1;
+
+	uint8_t* const registers = cpuMan.GetRegisters();
+	if (x <= y)
+	{
+		read_memory(cpuMan, I, registers + x, count);
+	}
+	else
+	{
+		uint8_t memory[16];
+		read_memory(cpuMan, I, memory, count);
+		std::reverse_copy(memory, memory + count, registers + y);
+	}
 }
 
 
+
 // 6XNN: store number NN in register VX
 void op_6XNN(CpuManager& cpuMan)
 {
@@ -250,7 +328,7 @@ void op_7XNN(CpuManager& cpuMan)
 void op_9XY0(CpuManager& cpuMan)
 {
 	if (VX != VY)
-		cpuMan.SetPC(cpuMan.GetPC() + 2 );
+		cpuMan.SkipInstruction();
 }
 
 
@@ -285,56 +363,11 @@ void op_DXYN(CpuManager& cpuMan)
 {
 	ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
 
-	VF = 0;
-	const auto res = cpuMan.GetGfxRes() - 1;
-	const auto vx = VX;
-	const auto vy = VY;
-	const int height = N;
-	const uint8_t* data =  cpuMan.GetMemory() + cpuMan.GetIndexRegister();
-
-	for (int y = 0; y < height; ++y) {
-		const uint8_t byte = *data++;
-		for (int pix = 0; pix < 8; ++pix) {
-			const bool bit = (byte & (0x80 >> pix)) != 0;
-			const auto xpos = (vx + pix) & res.x;
-			const auto ypos = (vy + y) & res.y;
-			auto& gfxPixel = cpuMan.GetGfx(xpos, ypos);
-			VF |= ((gfxPixel != 0) && bit);
-			gfxPixel ^= bit ? ~0 : 0;
-		}
-	}
-}
-
-
-
-// EXTENDED_MODE
-void op_DXYN_ex(CpuManager& cpuMan)
-{
-	ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_RENDER), "BAD RENDER");
-
-	if (N) {
-		op_DXYN(cpuMan);
-		return; 
-	}
-
-	VF = 0;
-	const auto vx = VX;
-	const auto vy = VY;
-	const auto res = cpuMan.GetGfxRes() - 1;
-	const uint8_t* data = cpuMan.GetMemory() + cpuMan.GetIndexRegister();
-	for (int y = 0; y < 16; ++y) {
-		for (int x = 0; x < 2; ++x) {
-			const uint8_t byte = *data++;
-			for (int pix = 0; pix < 8; ++pix) {
-				const bool bit = byte & (0x80 >> pix);
-				const auto xpos = (vx + (x * 8) + pix) & res.x;
-				const auto ypos = (vy + y) & res.y;
-				auto& gfxPix = cpuMan.GetGfx(xpos, ypos);
-				VF |= ((gfxPix!=0) && bit);
-				gfxPix ^= bit ? ~0 : 0;
-			}
-		}
-	}
+	// DXY0* SuperChip: 16x16 sprite in extended mode
+	if (N == 0 && cpuMan.GetFlags(Cpu::EXTENDED_MODE))
+		draw_sprite(cpuMan, 16, 16);
+	else
+		draw_sprite(cpuMan, 8, N);
 }
 
 
@@ -347,20 +380,17 @@ void op_EXxx(CpuManager& cpuMan)
 {
 	switch (N)
 	{
+		// the keypad is read from the mask UpdateSystems copies from the input
 		case 0xE: // EX9E  Skips the next instruction if the key stored in VX is pressed.
-			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_INPUT), "Cpu::Input, null or not initialized!");
-			
-			if (cpuMan.GetInput()->IsKeyPressed((Key)VX))
-				cpuMan.SetPC( cpuMan.GetPC() + 2 );
+			if ((cpuMan.GetKeys() >> (VX & 0xF)) & 0x1)
+				cpuMan.SkipInstruction();
 			
 			break;
 
 
 		case 0x1: // 0xEXA1  Skips the next instruction if the key stored in VX isn't pressed.
-			ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_INPUT), "Cpu::Input, null or not initialized!");
-			
-			if (!cpuMan.GetInput()->IsKeyPressed((Key)VX))
-				cpuMan.SetPC( cpuMan.GetPC() + 2 );
+			if (!((cpuMan.GetKeys() >> (VX & 0xF)) & 0x1))
+				cpuMan.SkipInstruction();
 			
 			break;
 
@@ -526,18 +556,19 @@ void op_8XYE(CpuManager& cpuMan)
 /******** OP_FXxx START *********/
 
 // FXxxx subtable start
-static InstrTable op_FXxx_Table[] =
+// every N has an entry, FXxF included
+static InstrTable op_FXxx_Table[16] =
 {
-	op_FX30, UnknownOpcode, UnknownOpcode,
+	op_FXx0, op_FN01, op_F002,
 	op_FX33, UnknownOpcode, op_FXx5, UnknownOpcode,
-	op_FX07, op_FX18, op_FX29, op_FX0A, UnknownOpcode,
-	UnknownOpcode, UnknownOpcode, op_FX1E
+	op_FX07, op_FX18, op_FX29, op_FXxA, UnknownOpcode,
+	UnknownOpcode, UnknownOpcode, op_FX1E, UnknownOpcode
 };
 
 
 
 
-void op_FXxx(CpuManager& cpuMan) // 9 instructions.
+void op_FXxx(CpuManager& cpuMan) // 11 instructions.
 {
 	ASSERT_MSG(static_cast<size_t>(N) < arr_size(op_FXxx_Table), 
                "op_FXxx_Table overflow...");
@@ -546,6 +577,38 @@ void op_FXxx(CpuManager& cpuMan) // 9 instructions.
 }
 
 
+void op_FXx0(CpuManager& cpuMan)
+{
+	switch (NN)
+	{
+		case 0x00: 
+			if (X == 0)
+				op_F000(cpuMan);
+			else
+				UnknownOpcode(cpuMan);
+			break;
+
+		case 0x30: op_FX30(cpuMan); break;
+		default: UnknownOpcode(cpuMan); break;
+	}
+}
+
+
+
+
+// F000 NNNN* XO-Chip: Sets I to the 16 bits address NNNN, after the opcode
+void op_F000(CpuManager& cpuMan)
+{
+	const auto pc = cpuMan.GetPC();
+	const uint8_t* const address = cpuMan.GetMemoryAt(pc);
+
+	cpuMan.SetIndexRegister((address[0] << 8) | address[1]);
+	cpuMan.SetPC(pc + 2);
+}
+
+
+
+
 // Set I to the Hi Res font corresponding the digit in VX
 void op_FX30(CpuManager& cpuMan)
 {
@@ -554,6 +617,21 @@ void op_FX30(CpuManager& cpuMan)
 
 
 
+// FN01* XO-Chip: select the planes N drawn, scrolled and cleared
+void op_FN01(CpuManager& cpuMan)
+{
+	if (NN != 0x01)
+	{
+		UnknownOpcode(cpuMan);
+		return;
+	}
+
+	cpuMan.SetPlanes(X & 0x3);
+}
+
+
+
+
 // FX07   Sets VX to the value of the delay timer.
 void op_FX07(CpuManager& cpuMan)
 {
@@ -563,12 +641,44 @@ void op_FX07(CpuManager& cpuMan)
 
 
 
+// F002* XO-Chip: load the 16 bytes audio pattern from I
+void op_F002(CpuManager& cpuMan)
+{
+	if (NNN != 0x002)
+	{
+		UnknownOpcode(cpuMan);
+		return;
+	}
+
+	auto& cpu = cpuMan.GetCpu();
+	read_memory(cpuMan, cpuMan.GetIndexRegister(), cpu.pattern, sizeof(cpu.pattern));
+	cpuMan.SetFlags(Cpu::AUDIO_PATTERN);
+	cpuMan.SyncSoundPattern();
+}
+
+
+
+
+void op_FXxA(CpuManager& cpuMan)
+{
+	switch (NN)
+	{
+		case 0x0A: op_FX0A(cpuMan); break;
+		case 0x3A: op_FX3A(cpuMan); break;
+		default: UnknownOpcode(cpuMan); break;
+	}
+}
+
+
+
+
 // FX0A   A key press is awaited, and then stored in VX.
+// the cpu is only halted here, PollWaitKey delivers the key
+// from the emulator's regular input update.
 void op_FX0A(CpuManager& cpuMan)
 {
-	ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_INPUT), "Cpu::input, null or not initialized!");
-
-	VX = static_cast<uint8_t>(cpuMan.GetInput()->WaitKeyPress());
+	cpuMan.GetCpu().waitKeys = cpuMan.GetKeys();
+	cpuMan.SetFlags(Cpu::WAIT_KEY);
 }
 
 
@@ -586,29 +696,24 @@ void op_FXx5(CpuManager& cpuMan)
 
 
 		case 0x55: //FX55  Stores V0 to VX in memory starting at address I
-			ASSERT_MSG(static_cast<size_t>(X+1) < (cpuMan.GetMemorySize() - cpuMan.GetIndexRegister()),
-                                     "memory overflow");
-
-			std::copy_n(cpuMan.GetRegisters(), X+1, &cpuMan.GetMemory(cpuMan.GetIndexRegister()));
+			write_memory(cpuMan, cpuMan.GetIndexRegister(), cpuMan.GetRegisters(), X+1);
 			break;
 
 		case 0x65: //FX65  Fills V0 to VX with values from memory starting at address I.
-			ASSERT_MSG(static_cast<size_t>(X+1) < cpuMan.GetRegistersSize(),
-                                    "registers overflow");
-
-			std::copy_n(&cpuMan.GetMemory(cpuMan.GetIndexRegister()), X+1, cpuMan.GetRegisters());
+			read_memory(cpuMan, cpuMan.GetIndexRegister(), cpuMan.GetRegisters(), X+1);
 			break;
 
+		// the flags count is X + 1, not VX, which could run over the registers
 		case 0x75: // 0xFX75* SuperChip: Store V0...VX in RPL user flags ( X <= 7 )
 		{
 			constexpr auto rplOffset = arr_size(fonts::chip8DefaultFont) + arr_size(fonts::chip8HiResFont);
-			std::copy_n(cpuMan.GetRegisters(),  VX, cpuMan.GetMemory() + rplOffset);
+			write_memory(cpuMan, rplOffset, cpuMan.GetRegisters(), X+1);
 			break;
 		}
 		case 0x85: // 0xFX85* SuperChip: Read V0...VX from RPL user flags ( X <= 7 )
 		{
 			constexpr auto rplOffset = arr_size(fonts::chip8DefaultFont) + arr_size(fonts::chip8HiResFont);
-			std::copy_n(cpuMan.GetMemory() + rplOffset, VX, cpuMan.GetRegisters());
+			std::copy_n(cpuMan.GetMemoryAt(rplOffset), X+1, cpuMan.GetRegisters());
 			break;
 		}
 		default: 
@@ -623,15 +728,21 @@ void op_FXx5(CpuManager& cpuMan)
 
 
 
+// FX3A* XO-Chip: set the audio pattern pitch to VX
+void op_FX3A(CpuManager& cpuMan)
+{
+	cpuMan.GetCpu().pitch = VX;
+	cpuMan.SyncSoundPattern();
+}
+
+
+
+
 // FX18   Sets the sound timer to VX.
+// the tone is rendered tick by tick while it counts down, see Emulator::TickTimers
 void op_FX18(CpuManager& cpuMan)
 {
-	ASSERT_MSG(!cpuMan.GetFlags(Cpu::BAD_SOUND), "Cpu::sound, null or not initialized");
-
 	cpuMan.SetSoundTimer(VX);
-
-	if (cpuMan.GetSoundTimer() > 0)
-		cpuMan.GetSound()->Play(cpuMan.GetSoundTimer());
 }
 
 
@@ -662,15 +773,15 @@ void op_FX29(CpuManager& cpuMan)
 //  the tens digit at location I+1, and the ones digit at location I+2.)
 void op_FX33(CpuManager& cpuMan)
 {
-	ASSERT_MSG(cpuMan.GetMemorySize() > (cpuMan.GetIndexRegister() + 2),
-                "Cpu::I + 2 overflows Cpu::memory!");
-
-	auto* memory = cpuMan.GetMemory() + cpuMan.GetIndexRegister();
+	// each digit wraps on its own
+	uint8_t* const memory = cpuMan.GetMemory();
+	const size_t mask = cpuMan.GetMemoryMask();
+	const size_t I = cpuMan.GetIndexRegister();
 	const uint8_t vx = VX;
-	memory[2] = vx % 10;
-	memory[1] = (vx / 10) % 10;
-	memory[0] = (vx / 100);
-
+	memory[I & mask] = vx / 100;
+	memory[(I + 1) & mask] = (vx / 10) % 10;
+	memory[(I + 2) & mask] = vx % 10;
+	cpuMan.MarkMemoryDirty(I & mask, 3);
 }
 
 
@@ -690,6 +801,171 @@ void op_FX33(CpuManager& cpuMan)
 
 
 
+// gfx helpers definitions
+static void clear_planes(CpuManager& cpuMan)
+{
+	const size_t words = cpuMan.GetPlaneSize();
+	for (size_t plane = 0; plane < CpuManager::GFX_PLANES; ++plane)
+	{
+		if (cpuMan.GetPlanes() & (1 << plane))
+			std::fill_n(cpuMan.GetPlane(plane), words, 0);
+	}
+
+	cpuMan.MarkGfxDirty();
+}
+
+
+
+// lines > 0 scrolls down, lines < 0 scrolls up
+static void scroll_rows(CpuManager& cpuMan, const int lines)
+{
+	const int height = cpuMan.GetGfxRes().y;
+	const size_t pitch = cpuMan.GetGfxPitch();
+	const int count = std::min(lines < 0 ? -lines : lines, height);
+	const size_t moved = (height - count) * pitch;
+	const size_t cleared = count * pitch;
+
+	for (size_t plane = 0; plane < CpuManager::GFX_PLANES; ++plane)
+	{
+		if (!(cpuMan.GetPlanes() & (1 << plane)))
+			continue;
+
+		uint64_t* const gfx = cpuMan.GetPlane(plane);
+		if (lines > 0) {
+			std::copy_backward(gfx, gfx + moved, gfx + moved + cleared);
+			std::fill_n(gfx, cleared, 0);
+		} else {
+			std::copy_n(gfx + cleared, moved, gfx);
+			std::fill_n(gfx + moved, cleared, 0);
+		}
+	}
+
+	cpuMan.MarkGfxDirty();
+}
+
+
+
+// pixels > 0 scrolls right, pixels < 0 scrolls left. |pixels| < 64
+static void scroll_pixels(CpuManager& cpuMan, const int pixels)
+{
+	const int height = cpuMan.GetGfxRes().y;
+	const int pitch = static_cast<int>(cpuMan.GetGfxPitch());
+	const int shift = pixels < 0 ? -pixels : pixels;
+
+	for (size_t plane = 0; plane < CpuManager::GFX_PLANES; ++plane)
+	{
+		if (!(cpuMan.GetPlanes() & (1 << plane)))
+			continue;
+
+		uint64_t* line = cpuMan.GetPlane(plane);
+		for (int y = 0; y < height; ++y, line += pitch) {
+			if (pixels > 0) {
+				for (int w = pitch - 1; w >= 0; --w)
+					line[w] = (line[w] >> shift) | (w > 0 ? line[w - 1] << (64 - shift) : 0);
+			} else {
+				for (int w = 0; w < pitch; ++w)
+					line[w] = (line[w] << shift) | (w + 1 < pitch ? line[w + 1] >> (64 - shift) : 0);
+			}
+		}
+	}
+
+	cpuMan.MarkGfxDirty();
+}
+
+
+
+// draws a sprite of width 8 or 16 from I, wrapping around the screen edges.
+// each selected plane takes its own sprite data, right after the previous one.
+static void draw_sprite(CpuManager& cpuMan, const int width, const int height)
+{
+	const auto res = cpuMan.GetGfxRes();
+	const size_t pitch = cpuMan.GetGfxPitch();
+	const int vx = VX & (res.x - 1);
+	const int vy = VY & (res.y - 1);
+
+	// the sprite row spills from its word into the next, or the row's first one
+	const size_t word = vx / 64;
+	const size_t nextWord = (word + 1) & (pitch - 1);
+	const int shift = vx % 64;
+
+	const uint8_t* data = cpuMan.GetMemoryAt(cpuMan.GetIndexRegister());
+	bool collision = false;
+
+	for (size_t plane = 0; plane < CpuManager::GFX_PLANES; ++plane)
+	{
+		if (!(cpuMan.GetPlanes() & (1 << plane)))
+			continue;
+
+		uint64_t* const gfx = cpuMan.GetPlane(plane);
+		for (int y = 0; y < height; ++y) {
+			uint64_t row = *data++;
+			if (width == 16)
+				row = (row << 8) | *data++;
+
+			const uint64_t bits = row << (64 - width);
+			const uint64_t low = bits >> shift;
+			const uint64_t high = shift ? bits << (64 - shift) : 0;
+			uint64_t* const line = gfx + ((vy + y) & (res.y - 1)) * pitch;
+
+			collision |= ((line[word] & low) | (line[nextWord] & high)) != 0;
+			line[word] ^= low;
+			line[nextWord] ^= high;
+		}
+	}
+
+	VF = collision;
+	cpuMan.MarkGfxDirty();
+}
+
+
+
+
+static inline void write_memory(CpuManager& cpuMan, const size_t address, const uint8_t* data, const size_t size)
+{
+	uint8_t* const memory = cpuMan.GetMemory();
+	const size_t start = address & cpuMan.GetMemoryMask();
+	const size_t room = cpuMan.GetMemorySize() - start;
+
+	if (size <= room)
+	{
+		std::copy_n(data, size, memory + start);
+	}
+	else
+	{
+		// the part running over the memory end lands at its start
+		std::copy_n(data, room, memory + start);
+		std::copy_n(data + room, size - room, memory);
+	}
+
+	cpuMan.MarkMemoryDirty(start, size);
+}
+
+
+
+static inline void read_memory(const CpuManager& cpuMan, const size_t address, uint8_t* dest, const size_t size)
+{
+	const uint8_t* const memory = cpuMan.GetMemory();
+	const size_t start = address & cpuMan.GetMemoryMask();
+	const size_t room = cpuMan.GetMemorySize() - start;
+
+	if (size <= room)
+	{
+		std::copy_n(memory + start, size, dest);
+	}
+	else
+	{
+		std::copy_n(memory + start, room, dest);
+		std::copy_n(memory, size - room, dest + room);
+	}
+}
+
+
+
+
+
+
+
+
 
 
 
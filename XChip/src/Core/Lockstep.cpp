@@ -0,0 +1,759 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <algorithm>
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/Assert.h>
+
+#include <XChip/Core/Lockstep.h>
+#include <XChip/Core/Instructions.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XCHIP_LOCKSTEP_SSE2
+#include <emmintrin.h>
+#endif
+
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+// how many distinct opcode groups are pulled out of the lanes per step,
+// whatever diverges further than this runs on the scalar tables.
+static constexpr int MAX_VECTOR_GROUPS = 4;
+
+constexpr size_t LockstepRunner::MAX_LANES;
+constexpr size_t LockstepRunner::MIN_VECTOR_LANES;
+constexpr size_t LockstepRunner::BLOCK_LANES;
+constexpr size_t LockstepRunner::BLOCK_SIZE;
+
+
+// a register row of one block, BLOCK_LANES bytes.
+// SSE2 when the target has it, plain byte loops otherwise
+#if defined(XCHIP_LOCKSTEP_SSE2)
+using LaneVec = __m128i;
+#else
+struct LaneVec { uint8_t bytes[LockstepRunner::BLOCK_LANES]; };
+#endif
+
+
+// local functions declarations
+template<class T>
+inline bool alloc_lane_arr(const size_t size, T*& arr);
+template<class T>
+inline void free_lane_arr(T*& arr);
+inline void set_lanes(size_t* dest, const uint8_t* mask, const size_t count, const size_t value);
+inline LaneVec vec_load(const uint8_t* src);
+inline void vec_store(uint8_t* dest, const LaneVec& v);
+inline LaneVec vec_set(const uint8_t value);
+inline LaneVec vec_add(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_sub(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_and(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_or(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_xor(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_eq(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_ge(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_carry(const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_shr(const LaneVec& a, const int bits);
+inline LaneVec vec_select(const LaneVec& mask, const LaneVec& a, const LaneVec& b);
+inline LaneVec vec_match(const uint16_t* opcodes, const uint16_t opcode);
+inline unsigned vec_bits(const LaneVec& mask);
+inline size_t bit_count(unsigned bits);
+
+
+
+
+
+LockstepRunner::LockstepRunner() noexcept
+{
+	Log("Creating LockstepRunner object...");
+}
+
+
+LockstepRunner::~LockstepRunner()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying LockstepRunner object...");
+}
+
+
+
+bool LockstepRunner::Initialize(CpuManager* const* lanes, const size_t count) noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	if (count == 0 || count > MAX_LANES)
+	{
+		LogError("LockstepRunner: invalid lane count: %zu", count);
+		return false;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (!lanes[i]->GetMemory() || lanes[i]->GetRegisters() == nullptr 
+			|| lanes[i]->GetRegistersSize() < 16)
+		{
+			LogError("LockstepRunner: lane %zu has no memory or registers", i);
+			return false;
+		}
+	}
+
+	// the arrays cover whole blocks, the lanes past
+	// count are never running and never match a group
+	const size_t blocks = (count + BLOCK_LANES - 1) / BLOCK_LANES;
+	const size_t padded = blocks * BLOCK_LANES;
+
+	if (!alloc_lane_arr(count, m_lanes) || !alloc_lane_arr(padded, m_memory)
+		|| !alloc_lane_arr(padded, m_memoryMask) || !alloc_lane_arr(padded, m_pc)
+		|| !alloc_lane_arr(padded, m_index) || !alloc_lane_arr(padded, m_opcodes)
+		|| !alloc_lane_arr(blocks * BLOCK_SIZE, m_regs) || !alloc_lane_arr(padded, m_running)
+		|| !alloc_lane_arr(padded, m_pending) || !alloc_lane_arr(padded, m_mask))
+	{
+		LogError("LockstepRunner: cannot allocate buffers for %zu lanes", count);
+		this->Dispose();
+		return false;
+	}
+
+	std::copy_n(lanes, count, m_lanes);
+	std::fill_n(m_opcodes, padded, uint16_t(0));
+	std::fill_n(m_running, padded, uint8_t(0));
+	std::fill_n(m_pending, padded, uint8_t(0));
+	std::fill_n(m_mask, padded, uint8_t(0));
+	m_laneCount = count;
+	m_blockCount = blocks;
+	m_runningCount = 0;
+	m_vectorInstrs = 0;
+	m_scalarInstrs = 0;
+	m_flushed = true;
+	m_initialized = true;
+	return true;
+}
+
+
+
+void LockstepRunner::Dispose() noexcept
+{
+	if (m_initialized)
+		this->Flush();
+
+	free_lane_arr(m_mask);
+	free_lane_arr(m_pending);
+	free_lane_arr(m_running);
+	free_lane_arr(m_regs);
+	free_lane_arr(m_opcodes);
+	free_lane_arr(m_index);
+	free_lane_arr(m_pc);
+	free_lane_arr(m_memoryMask);
+	free_lane_arr(m_memory);
+	free_lane_arr(m_lanes);
+	m_laneCount = 0;
+	m_blockCount = 0;
+	m_runningCount = 0;
+	m_initialized = false;
+}
+
+
+
+
+void LockstepRunner::Step()
+{
+	ASSERT_MSG(m_initialized, "LockstepRunner is not initialized");
+
+	if (m_flushed)
+		this->LoadLanes();
+
+	if (m_runningCount == 0)
+		return;
+
+	// fetch the next opcode of every lane, as CpuManager::FetchOpcode. 
+	// the arrays are read through locals, the stores can't alias them.
+	// with halted lanes these read one too, so the loop has no branch 
+	// to take, but they keep their PC and opcode.
+	const uint8_t* const* const memories = m_memory;
+	const size_t* const memoryMasks = m_memoryMask;
+	const uint8_t* const running = m_running;
+	uint16_t* const opcodes = m_opcodes;
+	size_t* const pcs = m_pc;
+	const size_t laneCount = m_laneCount;
+
+	if (m_runningCount == laneCount)
+	{
+		for (size_t i = 0; i < laneCount; ++i)
+		{
+			const uint8_t* const memory = memories[i];
+			const size_t pc = pcs[i] & memoryMasks[i];
+			opcodes[i] = (memory[pc] << 8) | memory[pc + 1];
+			pcs[i] = pc + 2;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < laneCount; ++i)
+		{
+			const uint8_t* const memory = memories[i];
+			const size_t pc = pcs[i] & memoryMasks[i];
+			const uint16_t opcode = (memory[pc] << 8) | memory[pc + 1];
+			opcodes[i] = running[i] ? opcode : opcodes[i];
+			pcs[i] = running[i] ? pc + 2 : pcs[i];
+		}
+	}
+
+
+	// pull out the lanes sharing the leading opcode, run them as one 
+	// group, and repeat on what is left. Lanes in lockstep usually share
+	// the PC, so the first group tends to hold almost all of them.
+	std::copy_n(m_running, m_blockCount * BLOCK_LANES, m_pending);
+	size_t active = m_runningCount;
+	size_t leader = 0;
+	for (int round = 0; round < MAX_VECTOR_GROUPS && active >= MIN_VECTOR_LANES; ++round)
+	{
+		while (!m_pending[leader])
+			++leader;
+
+		const uint16_t opcode = m_opcodes[leader];
+		const size_t size = this->MatchLanes(opcode);
+		this->RunGroup(opcode, m_mask, size);
+		active -= size;
+	}
+
+	// divergent lanes
+	if (active)
+		this->ExecuteScalar(m_pending);
+}
+
+
+
+void LockstepRunner::Flush()
+{
+	ASSERT_MSG(m_initialized, "LockstepRunner is not initialized");
+
+	if (m_flushed)
+		return;
+
+	for (size_t i = 0; i < m_laneCount; ++i)
+		this->StoreLane(i);
+
+	m_flushed = true;
+}
+
+
+
+void LockstepRunner::TickTimers()
+{
+	ASSERT_MSG(m_initialized, "LockstepRunner is not initialized");
+
+	// the timers are not kept by the runner
+	for (size_t i = 0; i < m_laneCount; ++i)
+	{
+		auto& cpu = m_lanes[i]->GetCpu();
+		if (cpu.delayTimer)
+			--cpu.delayTimer;
+
+		if (cpu.soundTimer)
+			--cpu.soundTimer;
+	}
+}
+
+
+
+
+
+
+inline void LockstepRunner::RunGroup(const uint16_t opcode, const uint8_t* mask, const size_t size)
+{
+	if (size >= MIN_VECTOR_LANES && this->ExecuteVector(opcode, mask))
+		m_vectorInstrs += size;
+	else
+		this->ExecuteScalar(mask);
+}
+
+
+
+
+bool LockstepRunner::ExecuteVector(const uint16_t opcode, const uint8_t* mask)
+{
+	const size_t x = (opcode & 0x0F00) >> 8;
+	const size_t y = (opcode & 0x00F0) >> 4;
+	const size_t nnn = opcode & 0x0FFF;
+	const uint8_t n = opcode & 0x000F;
+	const LaneVec nn = vec_set(opcode & 0x00FF);
+	const LaneVec one = vec_set(1);
+
+	switch (opcode >> 12)
+	{
+		case 0x1: // 1NNN
+			set_lanes(m_pc, mask, m_laneCount, nnn);
+			return true;
+
+
+		case 0xA: // ANNN
+			set_lanes(m_index, mask, m_laneCount, nnn);
+			return true;
+
+
+		case 0x3: // 3XNN
+			this->RunSkip(mask, x, x, [&](const LaneVec& vx, const LaneVec&) {
+				return vec_eq(vx, nn);
+			});
+			return true;
+
+
+		case 0x4: // 4XNN
+			this->RunSkip(mask, x, x, [&](const LaneVec& vx, const LaneVec&) {
+				return vec_xor(vec_eq(vx, nn), vec_set(0xFF));
+			});
+			return true;
+
+
+		case 0x5: // 5XY0
+			if (n != 0)
+				return false;
+
+			this->RunSkip(mask, x, y, [](const LaneVec& vx, const LaneVec& vy) {
+				return vec_eq(vx, vy);
+			});
+			return true;
+
+
+		case 0x9: // 9XY0
+			if (n != 0)
+				return false;
+
+			this->RunSkip(mask, x, y, [](const LaneVec& vx, const LaneVec& vy) {
+				return vec_xor(vec_eq(vx, vy), vec_set(0xFF));
+			});
+			return true;
+
+
+		case 0x6: // 6XNN
+			this->RunAlu(mask, x, x, [&](const LaneVec&, const LaneVec&, LaneVec&) {
+				return nn;
+			});
+			return true;
+
+
+		case 0x7: // 7XNN
+			this->RunAlu(mask, x, x, [&](const LaneVec& vx, const LaneVec&, LaneVec&) {
+				return vec_add(vx, nn);
+			});
+			return true;
+
+
+		case 0x8: // 8XYN
+			break;
+
+
+		default:
+			return false;
+	}
+
+
+
+	// 8XYN: ops from 8XY4 up write VF. When X is VF itself the scalar
+	// handlers read the freshly written flag back, leave those to them.
+	if (n >= 0x4 && x == 0xF)
+		return false;
+
+	switch (n)
+	{
+		case 0x0:
+			this->RunAlu(mask, x, y, [](const LaneVec&, const LaneVec& vy, LaneVec&) {
+				return vy;
+			});
+			return true;
+
+		case 0x1:
+			this->RunAlu(mask, x, y, [](const LaneVec& vx, const LaneVec& vy, LaneVec&) {
+				return vec_or(vx, vy);
+			});
+			return true;
+
+		case 0x2:
+			this->RunAlu(mask, x, y, [](const LaneVec& vx, const LaneVec& vy, LaneVec&) {
+				return vec_and(vx, vy);
+			});
+			return true;
+
+		case 0x3:
+			this->RunAlu(mask, x, y, [](const LaneVec& vx, const LaneVec& vy, LaneVec&) {
+				return vec_xor(vx, vy);
+			});
+			return true;
+
+		case 0x4:
+			this->RunAlu(mask, x, y, [&](const LaneVec& vx, const LaneVec& vy, LaneVec& vf) {
+				vf = vec_and(vec_carry(vx, vy), one);
+				return vec_add(vx, vy);
+			});
+			return true;
+
+		case 0x5:
+			this->RunAlu(mask, x, y, [&](const LaneVec& vx, const LaneVec& vy, LaneVec& vf) {
+				vf = vec_and(vec_ge(vx, vy), one);
+				return vec_sub(vx, vy);
+			});
+			return true;
+
+		case 0x6:
+			this->RunAlu(mask, x, y, [&](const LaneVec& vx, const LaneVec&, LaneVec& vf) {
+				vf = vec_and(vx, one);
+				return vec_shr(vx, 1);
+			});
+			return true;
+
+		case 0x7:
+			this->RunAlu(mask, x, y, [&](const LaneVec& vx, const LaneVec& vy, LaneVec& vf) {
+				vf = vec_and(vec_ge(vy, vx), one);
+				return vec_sub(vy, vx);
+			});
+			return true;
+
+		case 0xE:
+			this->RunAlu(mask, x, y, [](const LaneVec& vx, const LaneVec&, LaneVec& vf) {
+				vf = vec_shr(vx, 7);
+				return vec_add(vx, vx);
+			});
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+
+
+void LockstepRunner::ExecuteScalar(const uint8_t* mask)
+{
+	// the lane gets its registers for the handler, and
+	// the runner takes them back with whatever flags it set
+	for (size_t i = 0; i < m_laneCount; ++i)
+	{
+		if (!mask[i])
+			continue;
+
+		CpuManager& lane = *m_lanes[i];
+		this->StoreLane(i);
+		instructions::instrTable[lane.GetOpcode() >> 12](lane);
+		this->LoadLane(i);
+		++m_scalarInstrs;
+	}
+}
+
+
+
+
+// sets m_mask to the pending lanes which fetched 'opcode', 
+// takes them out of m_pending and returns how many they are
+inline size_t LockstepRunner::MatchLanes(const uint16_t opcode)
+{
+	const uint16_t* const opcodes = m_opcodes;
+	uint8_t* const pendingLanes = m_pending;
+	uint8_t* const maskLanes = m_mask;
+	const size_t blockCount = m_blockCount;
+
+	size_t size = 0;
+	for (size_t b = 0; b < blockCount; ++b)
+	{
+		const size_t first = b * BLOCK_LANES;
+		const LaneVec pending = vec_load(pendingLanes + first);
+		const LaneVec match = vec_and(vec_match(opcodes + first, opcode), pending);
+		vec_store(maskLanes + first, match);
+		vec_store(pendingLanes + first, vec_xor(pending, match));
+		size += bit_count(vec_bits(match));
+	}
+
+	return size;
+}
+
+
+
+
+template<class Op>
+inline void LockstepRunner::RunAlu(const uint8_t* mask, const size_t x, const size_t y, Op op)
+{
+	// VF is stored before VX, 8XY0-8XY3 with X = F keep their result
+	uint8_t* const blocks = m_regs;
+	const size_t blockCount = m_blockCount;
+	for (size_t b = 0; b < blockCount; ++b)
+	{
+		const LaneVec lanes = vec_load(mask + (b * BLOCK_LANES));
+		if (!vec_bits(lanes))
+			continue;
+
+		uint8_t* const regs = blocks + (b * BLOCK_SIZE);
+		const LaneVec vx = vec_load(regs + (x * BLOCK_LANES));
+		const LaneVec vy = vec_load(regs + (y * BLOCK_LANES));
+		const LaneVec oldVF = vec_load(regs + (0xF * BLOCK_LANES));
+		LaneVec vf = oldVF;
+		const LaneVec result = op(vx, vy, vf);
+		vec_store(regs + (0xF * BLOCK_LANES), vec_select(lanes, vf, oldVF));
+		vec_store(regs + (x * BLOCK_LANES), vec_select(lanes, result, vx));
+	}
+}
+
+
+
+
+template<class Cond>
+inline void LockstepRunner::RunSkip(const uint8_t* mask, const size_t x, const size_t y, Cond cond)
+{
+	for (size_t b = 0; b < m_blockCount; ++b)
+	{
+		const LaneVec lanes = vec_load(mask + (b * BLOCK_LANES));
+		if (!vec_bits(lanes))
+			continue;
+
+		const uint8_t* const regs = m_regs + (b * BLOCK_SIZE);
+		const LaneVec vx = vec_load(regs + (x * BLOCK_LANES));
+		const LaneVec vy = vec_load(regs + (y * BLOCK_LANES));
+		unsigned skips = vec_bits(vec_and(lanes, cond(vx, vy)));
+
+		for (size_t lane = b * BLOCK_LANES; skips; ++lane, skips >>= 1)
+		{
+			if (skips & 1)
+				this->SkipLane(lane);
+		}
+	}
+}
+
+
+
+
+// as CpuManager::SkipInstruction, F000 NNNN is skipped whole
+inline void LockstepRunner::SkipLane(const size_t lane)
+{
+	const uint8_t* const memory = m_memory[lane];
+	const size_t pc = m_pc[lane] & m_memoryMask[lane];
+	const bool longInstr = ((memory[pc] ^ 0xF0) | memory[pc + 1]) == 0;
+	m_pc[lane] = pc + 2 + (size_t(longInstr) << 1);
+}
+
+
+
+
+void LockstepRunner::LoadLanes()
+{
+	for (size_t i = 0; i < m_laneCount; ++i)
+		this->LoadLane(i);
+
+	m_flushed = false;
+}
+
+
+
+inline void LockstepRunner::LoadLane(const size_t lane)
+{
+	const CpuManager& cpu = *m_lanes[lane];
+	const uint8_t* const src = cpu.GetRegisters();
+	uint8_t* const dest = m_regs + ((lane / BLOCK_LANES) * BLOCK_SIZE) + (lane % BLOCK_LANES);
+	for (size_t r = 0; r < 16; ++r)
+		dest[r * BLOCK_LANES] = src[r];
+
+	m_memory[lane] = cpu.GetMemory();
+	m_memoryMask[lane] = cpu.GetMemoryMask();
+	m_pc[lane] = cpu.GetPC();
+	m_index[lane] = cpu.GetIndexRegister();
+	m_opcodes[lane] = cpu.GetOpcode();
+
+	const bool running = !cpu.GetFlags(Cpu::EXIT | Cpu::WAIT_KEY);
+	m_runningCount += size_t(running) - size_t(m_running[lane] != 0);
+	m_running[lane] = running ? 0xFF : 0x00;
+}
+
+
+
+inline void LockstepRunner::StoreLane(const size_t lane)
+{
+	CpuManager& cpu = *m_lanes[lane];
+	const uint8_t* const src = m_regs + ((lane / BLOCK_LANES) * BLOCK_SIZE) + (lane % BLOCK_LANES);
+	uint8_t* const dest = cpu.GetRegisters();
+	for (size_t r = 0; r < 16; ++r)
+		dest[r] = src[r * BLOCK_LANES];
+
+	cpu.SetPC(m_pc[lane]);
+	cpu.SetIndexRegister(m_index[lane]);
+	cpu.SetOpcode(m_opcodes[lane]);
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+template<class T>
+inline bool alloc_lane_arr(const size_t size, T*& arr)
+{
+	arr = static_cast<T*>(alloc_arr(sizeof(T) * size));
+	return arr != nullptr;
+}
+
+
+template<class T>
+inline void free_lane_arr(T*& arr)
+{
+	if (arr != nullptr)
+	{
+		free_arr(arr);
+		arr = nullptr;
+	}
+}
+
+
+
+
+// whole blocks are filled, only the blocks a divergence split go lane by lane
+inline void set_lanes(size_t* dest, const uint8_t* mask, const size_t count, const size_t value)
+{
+	constexpr size_t BLOCK = LockstepRunner::BLOCK_LANES;
+	for (size_t first = 0; first < count; first += BLOCK)
+	{
+		const unsigned lanes = vec_bits(vec_load(mask + first));
+		if (lanes == 0xFFFF)
+		{
+			std::fill_n(dest + first, BLOCK, value);
+		}
+		else if (lanes)
+		{
+			for (size_t i = first; i < first + BLOCK; ++i)
+				dest[i] = mask[i] ? value : dest[i];
+		}
+	}
+}
+
+
+
+
+#if defined(XCHIP_LOCKSTEP_SSE2)
+
+inline LaneVec vec_load(const uint8_t* src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+inline void vec_store(uint8_t* dest, const LaneVec& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), v); }
+inline LaneVec vec_set(const uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+inline LaneVec vec_add(const LaneVec& a, const LaneVec& b) { return _mm_add_epi8(a, b); }
+inline LaneVec vec_sub(const LaneVec& a, const LaneVec& b) { return _mm_sub_epi8(a, b); }
+inline LaneVec vec_and(const LaneVec& a, const LaneVec& b) { return _mm_and_si128(a, b); }
+inline LaneVec vec_or(const LaneVec& a, const LaneVec& b) { return _mm_or_si128(a, b); }
+inline LaneVec vec_xor(const LaneVec& a, const LaneVec& b) { return _mm_xor_si128(a, b); }
+inline LaneVec vec_eq(const LaneVec& a, const LaneVec& b) { return _mm_cmpeq_epi8(a, b); }
+inline unsigned vec_bits(const LaneVec& mask) { return static_cast<unsigned>(_mm_movemask_epi8(mask)); }
+
+// unsigned a >= b
+inline LaneVec vec_ge(const LaneVec& a, const LaneVec& b) 
+{
+	return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a); 
+}
+
+// a + b overflows a byte when the saturated sum differs from the wrapped one
+inline LaneVec vec_carry(const LaneVec& a, const LaneVec& b) 
+{
+	return _mm_andnot_si128(_mm_cmpeq_epi8(_mm_adds_epu8(a, b), _mm_add_epi8(a, b)), _mm_set1_epi8(-1));
+}
+
+// there is no byte shift, the bits crossing from the upper byte are masked out
+inline LaneVec vec_shr(const LaneVec& a, const int bits) 
+{
+	return _mm_and_si128(_mm_srli_epi16(a, bits), _mm_set1_epi8(static_cast<char>(0xFF >> bits)));
+}
+
+inline LaneVec vec_select(const LaneVec& mask, const LaneVec& a, const LaneVec& b) 
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline LaneVec vec_match(const uint16_t* opcodes, const uint16_t opcode)
+{
+	const __m128i value = _mm_set1_epi16(static_cast<short>(opcode));
+	const __m128i lo = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(opcodes)), value);
+	const __m128i hi = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(opcodes + 8)), value);
+	return _mm_packs_epi16(lo, hi);
+}
+
+#else
+
+template<class F>
+inline LaneVec vec_map(const LaneVec& a, const LaneVec& b, F f)
+{
+	LaneVec r;
+	for (size_t i = 0; i < LockstepRunner::BLOCK_LANES; ++i)
+		r.bytes[i] = static_cast<uint8_t>(f(a.bytes[i], b.bytes[i]));
+	return r;
+}
+
+inline LaneVec vec_load(const uint8_t* src) { LaneVec r; std::copy_n(src, LockstepRunner::BLOCK_LANES, r.bytes); return r; }
+inline void vec_store(uint8_t* dest, const LaneVec& v) { std::copy_n(v.bytes, LockstepRunner::BLOCK_LANES, dest); }
+inline LaneVec vec_set(const uint8_t value) { LaneVec r; std::fill_n(r.bytes, LockstepRunner::BLOCK_LANES, value); return r; }
+inline LaneVec vec_add(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x + y; }); }
+inline LaneVec vec_sub(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x - y; }); }
+inline LaneVec vec_and(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x & y; }); }
+inline LaneVec vec_or(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x | y; }); }
+inline LaneVec vec_xor(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x ^ y; }); }
+inline LaneVec vec_eq(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x == y ? 0xFF : 0x00; }); }
+inline LaneVec vec_ge(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x >= y ? 0xFF : 0x00; }); }
+inline LaneVec vec_carry(const LaneVec& a, const LaneVec& b) { return vec_map(a, b, [](unsigned x, unsigned y) { return x + y > 0xFF ? 0xFF : 0x00; }); }
+inline LaneVec vec_shr(const LaneVec& a, const int bits) { return vec_map(a, a, [bits](unsigned x, unsigned) { return x >> bits; }); }
+
+inline LaneVec vec_select(const LaneVec& mask, const LaneVec& a, const LaneVec& b) 
+{
+	return vec_or(vec_and(mask, a), vec_map(mask, b, [](unsigned m, unsigned y) { return ~m & y; }));
+}
+
+inline LaneVec vec_match(const uint16_t* opcodes, const uint16_t opcode)
+{
+	LaneVec r;
+	for (size_t i = 0; i < LockstepRunner::BLOCK_LANES; ++i)
+		r.bytes[i] = opcodes[i] == opcode ? 0xFF : 0x00;
+	return r;
+}
+
+inline unsigned vec_bits(const LaneVec& mask)
+{
+	unsigned bits = 0;
+	for (size_t i = 0; i < LockstepRunner::BLOCK_LANES; ++i)
+		bits |= unsigned(mask.bytes[i] >> 7) << i;
+	return bits;
+}
+
+#endif
+
+
+// the set bits of a block's lane mask
+inline size_t bit_count(unsigned bits)
+{
+	bits = bits - ((bits >> 1) & 0x5555);
+	bits = (bits & 0x3333) + ((bits >> 2) & 0x3333);
+	bits = (bits + (bits >> 4)) & 0x0F0F;
+	return (bits + (bits >> 8)) & 0x1F;
+}
+
+
+
+
+
+}
@@ -0,0 +1,265 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Utix/Log.h>
+#include <Utix/ScopeExit.h>
+
+#include <XChip/Core/MappedFile.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+
+// local functions declarations
+inline LoadStatus map_file(const char* fileName, uint8_t*& data, size_t& size);
+inline LoadStatus read_file(const char* fileName, uint8_t*& data, size_t& size);
+
+
+
+
+
+MappedFile::MappedFile() noexcept
+{
+	Log("Creating MappedFile object...");
+}
+
+
+MappedFile::~MappedFile()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying MappedFile object...");
+}
+
+
+
+
+LoadStatus MappedFile::Initialize(const char* fileName) noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	auto status = map_file(fileName, m_data, m_size);
+
+	if (status == LoadStatus::OK)
+	{
+		m_mapped = true;
+	}
+	else if (status == LoadStatus::READ_FAILED)
+	{
+		// the file is there but can't be mapped, read it instead
+		status = read_file(fileName, m_data, m_size);
+	}
+
+	if (status != LoadStatus::OK)
+		return status;
+
+	m_initialized = true;
+	return LoadStatus::OK;
+}
+
+
+
+
+void MappedFile::Dispose() noexcept
+{
+	if (m_mapped)
+	{
+	#if defined(__linux__) || defined(__APPLE__)
+		munmap(m_data, m_size);
+	#elif defined(_WIN32)
+		UnmapViewOfFile(m_data);
+	#endif
+	}
+	else
+	{
+		free(m_data);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+	m_initialized = false;
+}
+
+
+
+
+
+
+
+
+
+
+// local functions definitions
+inline LoadStatus map_file(const char* fileName, uint8_t*& data, size_t& size)
+{
+#if defined(__linux__) || defined(__APPLE__)
+
+	const int fd = open(fileName, O_RDONLY);
+	if (fd == -1)
+	{
+		LogError("MappedFile: error opening file \'%s\': %s", fileName, strerror(errno));
+		return LoadStatus::OPEN_FAILED;
+	}
+
+	const auto fdClose = MakeScopeExit([fd]() noexcept { 
+		close(fd); 
+	});
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		return LoadStatus::READ_FAILED;
+
+	if (st.st_size == 0)
+	{
+		LogError("MappedFile: file \'%s\' is empty", fileName);
+		return LoadStatus::EMPTY;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void* const view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+		return LoadStatus::READ_FAILED;
+
+	data = static_cast<uint8_t*>(view);
+	size = static_cast<size_t>(st.st_size);
+	return LoadStatus::OK;
+
+#elif defined(_WIN32)
+
+	const HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, 
+	                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LogError("MappedFile: error opening file \'%s\'. Error Code: %d", fileName, GetLastError());
+		return LoadStatus::OPEN_FAILED;
+	}
+
+	const auto fileClose = MakeScopeExit([file]() noexcept { 
+		CloseHandle(file); 
+	});
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+		return LoadStatus::READ_FAILED;
+
+	if (fileSize.QuadPart == 0)
+	{
+		LogError("MappedFile: file \'%s\' is empty", fileName);
+		return LoadStatus::EMPTY;
+	}
+
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return LoadStatus::READ_FAILED;
+
+	// the view keeps the mapping alive after the handles are closed
+	void* const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (!view)
+		return LoadStatus::READ_FAILED;
+
+	data = static_cast<uint8_t*>(view);
+	size = static_cast<size_t>(fileSize.QuadPart);
+	return LoadStatus::OK;
+
+#else
+
+	(void)fileName; (void)data; (void)size;
+	return LoadStatus::READ_FAILED;
+
+#endif
+}
+
+
+
+
+inline LoadStatus read_file(const char* fileName, uint8_t*& data, size_t& size)
+{
+	auto *const file = fopen(fileName, "rb");
+
+	if (!file) 
+	{
+		LogError("MappedFile: error opening file \'%s\'", fileName);
+		return LoadStatus::OPEN_FAILED;
+	}
+
+	const auto fileClose = MakeScopeExit([file]() noexcept { 
+		fclose(file); 
+	});
+
+	fseek(file, 0, SEEK_END);
+	const auto fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (fileSize <= 0)
+	{
+		LogError("MappedFile: file \'%s\' is empty", fileName);
+		return LoadStatus::EMPTY;
+	}
+
+	auto* const buffer = static_cast<uint8_t*>(malloc(static_cast<size_t>(fileSize)));
+	if (!buffer)
+	{
+		LogError("MappedFile: cannot allocate buffer for \'%s\'", fileName);
+		return LoadStatus::READ_FAILED;
+	}
+
+	const auto readSize = fread(buffer, 1, static_cast<size_t>(fileSize), file);
+
+	if (readSize != static_cast<size_t>(fileSize))
+	{
+		LogError("MappedFile: could not read the file \'%s\' properly. bytes asked %ld, bytes read %zu", 
+		           fileName, fileSize, readSize);
+		free(buffer);
+		return LoadStatus::READ_FAILED;
+	}
+
+	data = buffer;
+	size = readSize;
+	return LoadStatus::OK;
+}
+
+
+
+
+
+}
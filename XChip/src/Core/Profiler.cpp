@@ -0,0 +1,274 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifdef XCHIP_PROFILER
+
+#include <algorithm>
+
+#include <Utix/Assert.h>
+
+#include <XChip/Core/Profiler.h>
+#include <XChip/Core/Disassembler.h>
+
+
+
+namespace xchip { namespace profiler {
+
+using namespace disassembler;
+
+
+namespace {
+
+constexpr size_t MAX_ADDRESS = 0x10000;
+constexpr size_t MAX_OPCODE = 0x10000;
+constexpr size_t HOT_PCS = 32;
+constexpr size_t COVERAGE_ROW = 128;
+
+
+// indexed by PC and by raw opcode, everything else is derived at report
+Stats pcStats[MAX_ADDRESS];
+Stats opcodeStats[MAX_OPCODE];
+uint16_t pcOpcodes[MAX_ADDRESS];
+
+
+// local functions declarations
+void report_table(FILE* out, const char* title, const char* const* names,
+                  const Stats* stats, const size_t size, const uint64_t total);
+void report_hot_pcs(FILE* out, const uint64_t total);
+void report_coverage(FILE* out);
+}
+
+
+
+
+
+void Record(const uint16_t pc, const uint16_t opcode, const uint64_t nanosecs)
+{
+	++pcStats[pc].count;
+	pcStats[pc].nanosecs += nanosecs;
+	pcOpcodes[pc] = opcode;
+	++opcodeStats[opcode].count;
+	opcodeStats[opcode].nanosecs += nanosecs;
+}
+
+
+
+void Reset()
+{
+	std::fill_n(pcStats, MAX_ADDRESS, Stats{0, 0});
+	std::fill_n(opcodeStats, MAX_OPCODE, Stats{0, 0});
+	std::fill_n(pcOpcodes, MAX_ADDRESS, 0);
+}
+
+
+
+const Stats& GetPCStats(const uint16_t pc)
+{
+	return pcStats[pc];
+}
+
+
+
+const Stats& GetOpcodeStats(const uint16_t opcode)
+{
+	return opcodeStats[opcode];
+}
+
+
+
+const char* GetHandlerName(const uint16_t opcode)
+{
+	return GetOpcodeInfo(opcode).name;
+}
+
+
+
+
+void Report(FILE* out)
+{
+	static const char* const classNames[16] =
+	{
+		"0xxx", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+		"8XYx", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EXxx", "FXxx"
+	};
+
+	const char* handlerNames[OPCODE_TABLE_SIZE];
+	Stats classStats[16] = {};
+	Stats handlerStats[OPCODE_TABLE_SIZE] = {};
+	Stats total = { 0, 0 };
+
+	for (size_t i = 0; i < OPCODE_TABLE_SIZE; ++i)
+		handlerNames[i] = opcodeTable[i].name;
+
+
+	for (size_t opcode = 0; opcode < MAX_OPCODE; ++opcode)
+	{
+		const auto& stats = opcodeStats[opcode];
+		if (stats.count == 0)
+			continue;
+
+		auto& cls = classStats[opcode >> 12];
+		auto& handler = handlerStats[GetOpcodeIndex(static_cast<uint16_t>(opcode))];
+		cls.count += stats.count;
+		cls.nanosecs += stats.nanosecs;
+		handler.count += stats.count;
+		handler.nanosecs += stats.nanosecs;
+		total.count += stats.count;
+		total.nanosecs += stats.nanosecs;
+	}
+
+
+	fprintf(out, "\n==== XChip Profiler Report ====\n");
+	fprintf(out, "instructions: %llu  host time: %.3f ms  avg: %.1f ns/instr\n",
+	        static_cast<unsigned long long>(total.count), total.nanosecs / 1e6,
+	        total.count ? static_cast<double>(total.nanosecs) / total.count : 0.0);
+
+	if (total.count != 0)
+	{
+		report_table(out, "opcode classes", classNames, classStats, 16, total.count);
+		report_table(out, "handlers", handlerNames, handlerStats, OPCODE_TABLE_SIZE, total.count);
+		report_hot_pcs(out, total.count);
+		report_coverage(out);
+	}
+
+	fflush(out);
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+namespace {
+
+
+void report_table(FILE* out, const char* title, const char* const* names,
+                  const Stats* stats, const size_t size, const uint64_t total)
+{
+	ASSERT_MSG(size <= OPCODE_TABLE_SIZE, "too many rows");
+
+	size_t order[OPCODE_TABLE_SIZE];
+	size_t rows = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (stats[i].count)
+			order[rows++] = i;
+	}
+
+	// most executed first
+	std::sort(order, order + rows, [stats](const size_t a, const size_t b) {
+		return stats[a].count > stats[b].count;
+	});
+
+	fprintf(out, "\n-- %s --\n", title);
+	fprintf(out, "%-6s %14s %8s %12s %10s\n", "name", "count", "%", "host ms", "ns/instr");
+
+	for (size_t row = 0; row < rows; ++row)
+	{
+		const auto i = order[row];
+		fprintf(out, "%-6s %14llu %7.2f%% %12.3f %10.1f\n", names[i],
+		        static_cast<unsigned long long>(stats[i].count),
+		        (100.0 * stats[i].count) / total, stats[i].nanosecs / 1e6,
+		        static_cast<double>(stats[i].nanosecs) / stats[i].count);
+	}
+}
+
+
+
+
+void report_hot_pcs(FILE* out, const uint64_t total)
+{
+	// insertion into the top HOT_PCS, ties keep the lower PC first
+	uint32_t pcs[HOT_PCS];
+	size_t hotCount = 0;
+	for (uint32_t pc = 0; pc < MAX_ADDRESS; ++pc)
+	{
+		const auto count = pcStats[pc].count;
+		if (count == 0 || (hotCount == HOT_PCS && count <= pcStats[pcs[HOT_PCS - 1]].count))
+			continue;
+
+		size_t i = (hotCount < HOT_PCS) ? hotCount++ : HOT_PCS - 1;
+		for (; i > 0 && pcStats[pcs[i - 1]].count < count; --i)
+			pcs[i] = pcs[i - 1];
+
+		pcs[i] = pc;
+	}
+
+
+	// the opcode shown is the last one executed at each PC,
+	// self-modifying code may have run others there too.
+	fprintf(out, "\n-- hottest PCs --\n");
+	fprintf(out, "%-6s %14s %8s %10s  %s\n", "pc", "count", "%", "ns/instr", "instruction");
+
+	for (size_t i = 0; i < hotCount; ++i)
+	{
+		const auto pc = pcs[i];
+		const auto& stats = pcStats[pc];
+		char text[MAX_TEXT_SIZE];
+		Disassemble(pcOpcodes[pc], text, sizeof(text));
+		fprintf(out, "0x%04X %14llu %7.2f%% %10.1f  %04X %s\n", pc, static_cast<unsigned long long>(stats.count),
+		        (100.0 * stats.count) / total, static_cast<double>(stats.nanosecs) / stats.count,
+		        pcOpcodes[pc], text);
+	}
+}
+
+
+
+
+void report_coverage(FILE* out)
+{
+	size_t covered = 0;
+	for (size_t pc = 0; pc < MAX_ADDRESS; ++pc)
+		covered += pcStats[pc].count != 0;
+
+	// one column per 2 byte word, rows with no executed word are skipped
+	fprintf(out, "\n-- coverage: %zu addresses executed --\n", covered);
+
+	for (size_t row = 0; row < MAX_ADDRESS; row += COVERAGE_ROW)
+	{
+		char line[(COVERAGE_ROW / 2) + 1];
+		bool any = false;
+		for (size_t word = 0; word < COVERAGE_ROW / 2; ++word)
+		{
+			const auto addr = row + (word * 2);
+			const bool hit = pcStats[addr].count || pcStats[addr + 1].count;
+			line[word] = hit ? '#' : '.';
+			any = any || hit;
+		}
+
+		line[COVERAGE_ROW / 2] = '\0';
+		if (any)
+			fprintf(out, "0x%04zX %s\n", row, line);
+	}
+}
+
+
+}
+
+
+
+}}
+
+
+#endif // XCHIP_PROFILER
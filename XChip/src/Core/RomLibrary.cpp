@@ -0,0 +1,226 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <Utix/Log.h>
+
+#include <XChip/Core/RomLibrary.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+
+constexpr uint32_t RomLibrary::VERSION;
+constexpr size_t RomLibrary::MAX_NAME_SIZE;
+const char RomLibrary::MAGIC[8] = { 'X', 'C', 'H', 'I', 'P', 'L', 'I', 'B' };
+
+static_assert(sizeof(RomLibrary::Header) == 32, "RomLibrary::Header layout changed");
+static_assert(sizeof(RomLibrary::Entry) == 24 + RomLibrary::MAX_NAME_SIZE, "RomLibrary::Entry layout changed");
+
+
+// local functions declarations
+inline bool is_hash_str(const char* str);
+
+
+
+
+
+
+RomLibrary::RomLibrary() noexcept
+{
+	Log("Creating RomLibrary object...");
+}
+
+
+RomLibrary::~RomLibrary()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying RomLibrary object...");
+}
+
+
+
+
+LoadStatus RomLibrary::Initialize(const char* fileName) noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	const auto status = m_file.Initialize(fileName);
+	if (status != LoadStatus::OK)
+		return status;
+
+	const auto* const data = m_file.GetData();
+	const auto size = m_file.GetSize();
+	const auto* const header = reinterpret_cast<const Header*>(data);
+
+	if (size < sizeof(Header) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header->version != VERSION)
+	{
+		LogError("RomLibrary: \'%s\' is not a version %u rom library", fileName, VERSION);
+		m_file.Dispose();
+		return LoadStatus::BAD_FORMAT;
+	}
+
+
+	// validate the whole index once, lookups trust it afterwards. The
+	// index sits between the header and the ROM bytes, checked without
+	// sums which a hostile offset could wrap.
+	const auto indexOffset = header->indexOffset;
+	const auto dataOffset = header->dataOffset;
+
+	if (indexOffset < sizeof(Header) || indexOffset > size || (indexOffset % alignof(Entry)) != 0
+		|| header->count > (size - indexOffset) / sizeof(Entry)
+		|| dataOffset < indexOffset + (uint64_t(header->count) * sizeof(Entry)) || dataOffset > size)
+	{
+		LogError("RomLibrary: \'%s\' has a corrupted header", fileName);
+		m_file.Dispose();
+		return LoadStatus::BAD_FORMAT;
+	}
+
+	const auto* const entries = reinterpret_cast<const Entry*>(data + indexOffset);
+	const auto dataSize = size - dataOffset;
+
+	for (uint32_t i = 0; i < header->count; ++i)
+	{
+		const auto& entry = entries[i];
+		if (entry.offset > dataSize || entry.size > (dataSize - entry.offset)
+			|| entry.name[MAX_NAME_SIZE - 1] != '\0'
+			|| (i > 0 && entries[i - 1].hash > entry.hash))
+		{
+			LogError("RomLibrary: \'%s\' has a corrupted entry at %u", fileName, i);
+			m_file.Dispose();
+			return LoadStatus::BAD_FORMAT;
+		}
+	}
+
+	m_entries = entries;
+	m_romData = data + dataOffset;
+	m_count = header->count;
+	m_initialized = true;
+	return LoadStatus::OK;
+}
+
+
+
+
+void RomLibrary::Dispose() noexcept
+{
+	m_file.Dispose();
+	m_entries = nullptr;
+	m_romData = nullptr;
+	m_count = 0;
+	m_initialized = false;
+}
+
+
+
+
+const RomLibrary::Entry* RomLibrary::FindByName(const char* name) const
+{
+	ASSERT_MSG(m_initialized, "RomLibrary is not initialized");
+
+	for (size_t i = 0; i < m_count; ++i)
+	{
+		if (strcmp(m_entries[i].name, name) == 0)
+			return &m_entries[i];
+	}
+
+	return nullptr;
+}
+
+
+
+const RomLibrary::Entry* RomLibrary::FindByHash(const uint64_t hash) const
+{
+	ASSERT_MSG(m_initialized, "RomLibrary is not initialized");
+
+	const auto* const end = m_entries + m_count;
+	const auto* const itr = std::lower_bound(m_entries, end, hash, 
+		[](const Entry& entry, const uint64_t value) { return entry.hash < value; });
+
+	if (itr != end && itr->hash == hash)
+		return itr;
+
+	return nullptr;
+}
+
+
+
+const RomLibrary::Entry* RomLibrary::Find(const char* nameOrHash) const
+{
+	const auto* const entry = FindByName(nameOrHash);
+	if (entry || !is_hash_str(nameOrHash))
+		return entry;
+
+	return FindByHash(strtoull(nameOrHash, nullptr, 16));
+}
+
+
+
+
+uint64_t RomLibrary::ComputeHash(const uint8_t* data, const size_t size)
+{
+	// 64 bit FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+inline bool is_hash_str(const char* str)
+{
+	// hashes are written as 16 hex digits
+	size_t len = 0;
+	for (; str[len] != '\0'; ++len)
+	{
+		if (!isxdigit(static_cast<unsigned char>(str[len])))
+			return false;
+	}
+
+	return len == 16;
+}
+
+
+
+
+}
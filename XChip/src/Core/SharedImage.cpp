@@ -0,0 +1,297 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Utix/Log.h>
+#include <Utix/Assert.h>
+#include <Utix/ScopeExit.h>
+
+#include <XChip/Core/SharedImage.h>
+#include <XChip/Core/CpuManager.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+
+#if defined(__linux__) || defined(__APPLE__)
+// local functions declarations
+inline int create_shared_fd();
+#endif
+
+
+
+
+SharedImage::SharedImage() noexcept
+{
+	Log("Creating SharedImage object...");
+}
+
+
+SharedImage::~SharedImage()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying SharedImage object...");
+}
+
+
+
+// the guard tail after the memory is part of the image
+bool SharedImage::Initialize(const CpuManager& source) noexcept
+{
+	return this->Initialize(source.GetMemory(), source.GetMemorySize() + CpuManager::MEMORY_GUARD_SIZE);
+}
+
+
+
+bool SharedImage::Initialize(const uint8_t* data, const size_t size) noexcept
+{
+	ASSERT_MSG(data != nullptr && size > 0, "null or empty image");
+
+	if (m_initialized)
+		this->Dispose();
+
+	const auto cleanup = MakeScopeExit([this]() noexcept {
+		if (!this->m_initialized)
+			this->Dispose();
+	});
+
+	m_size = size;
+
+#if defined(__linux__) || defined(__APPLE__)
+
+	m_fd = create_shared_fd();
+
+	if (m_fd != -1 && ftruncate(m_fd, size) == 0)
+	{
+		void* const writer = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (writer != MAP_FAILED)
+		{
+			memcpy(writer, data, size);
+			munmap(writer, size);
+
+			void* const reader = mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0);
+			if (reader != MAP_FAILED)
+			{
+				m_data = static_cast<uint8_t*>(reader);
+				m_shared = true;
+			}
+		}
+	}
+
+	if (!m_shared)
+	{
+		LogError("SharedImage: could not create shared mapping: %s. Using private copies", strerror(errno));
+		if (m_fd != -1)
+		{
+			close(m_fd);
+			m_fd = -1;
+		}
+	}
+
+#elif defined(_WIN32)
+
+	m_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), nullptr);
+
+	if (m_handle)
+	{
+		void* const writer = MapViewOfFile(m_handle, FILE_MAP_WRITE, 0, 0, size);
+		if (writer)
+		{
+			memcpy(writer, data, size);
+			UnmapViewOfFile(writer);
+
+			void* const reader = MapViewOfFile(m_handle, FILE_MAP_READ, 0, 0, size);
+			if (reader)
+			{
+				m_data = static_cast<uint8_t*>(reader);
+				m_shared = true;
+			}
+		}
+	}
+
+	if (!m_shared)
+	{
+		LogError("SharedImage: could not create shared mapping. Error Code: %d. Using private copies", GetLastError());
+		if (m_handle)
+		{
+			CloseHandle(m_handle);
+			m_handle = nullptr;
+		}
+	}
+
+#endif
+
+	if (!m_shared)
+	{
+		m_data = static_cast<uint8_t*>(malloc(size));
+		if (!m_data)
+		{
+			LogError("SharedImage: cannot allocate image size: %zu", size);
+			return false;
+		}
+
+		memcpy(m_data, data, size);
+	}
+
+	m_cloneBase = CpuManager::NewCloneBase();
+	m_initialized = true;
+	return true;
+}
+
+
+
+
+void SharedImage::Dispose() noexcept
+{
+	if (m_shared)
+	{
+	#if defined(__linux__) || defined(__APPLE__)
+		munmap(m_data, m_size);
+		close(m_fd);
+		m_fd = -1;
+	#elif defined(_WIN32)
+		UnmapViewOfFile(m_data);
+		CloseHandle(m_handle);
+		m_handle = nullptr;
+	#endif
+	}
+	else
+	{
+		free(m_data);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_cloneBase = 0;
+	m_shared = false;
+	m_initialized = false;
+}
+
+
+
+
+uint8_t* SharedImage::MapPrivate() const
+{
+	ASSERT_MSG(m_initialized, "SharedImage is not initialized");
+
+	if (m_shared)
+	{
+	#if defined(__linux__) || defined(__APPLE__)
+		void* const view = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, 0);
+		if (view != MAP_FAILED)
+			return static_cast<uint8_t*>(view);
+
+		LogError("SharedImage: failed to map private view: %s", strerror(errno));
+	#elif defined(_WIN32)
+		void* const view = MapViewOfFile(m_handle, FILE_MAP_COPY, 0, 0, m_size);
+		if (view)
+			return static_cast<uint8_t*>(view);
+
+		LogError("SharedImage: failed to map private view. Error Code: %d", GetLastError());
+	#endif
+		return nullptr;
+	}
+
+	auto* const copy = static_cast<uint8_t*>(malloc(m_size));
+	if (!copy)
+	{
+		LogError("SharedImage: cannot allocate private copy size: %zu", m_size);
+		return nullptr;
+	}
+
+	memcpy(copy, m_data, m_size);
+	return copy;
+}
+
+
+
+void SharedImage::UnmapPrivate(uint8_t* view) const
+{
+	if (!view)
+		return;
+
+	if (m_shared)
+	{
+	#if defined(__linux__) || defined(__APPLE__)
+		munmap(view, m_size);
+	#elif defined(_WIN32)
+		UnmapViewOfFile(view);
+	#endif
+	}
+	else
+	{
+		free(view);
+	}
+}
+
+
+
+
+
+
+
+
+
+#if defined(__linux__) || defined(__APPLE__)
+// local functions definitions
+inline int create_shared_fd()
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+	return static_cast<int>(syscall(SYS_memfd_create, "xchip-image", 0));
+#else
+	// anonymous shm object: unlinked as soon as it is open
+	static std::atomic<unsigned> lastId(0);
+	char name[64];
+	snprintf(name, sizeof(name), "/xchip-image-%d-%u", static_cast<int>(getpid()), ++lastId);
+	const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1)
+		shm_unlink(name);
+	return fd;
+#endif
+}
+#endif
+
+
+
+
+
+}
@@ -0,0 +1,292 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include <XChip/Core/Stats.h>
+
+
+
+namespace xchip {
+
+
+constexpr uint64_t StatsCollector::WINDOW;
+constexpr size_t StatsCollector::MAX_FRAME_SAMPLES;
+
+
+// local functions declarations
+inline uint64_t count_missed(const uint64_t interval, const uint64_t period);
+inline double to_ms(const uint64_t nanosecs);
+
+
+
+
+
+StatsCollector::StatsCollector() noexcept
+	: m_presentNs(0),
+	m_presentCount(0),
+	m_sequence(0)
+{
+	memset(&m_snapshot, 0, sizeof(m_snapshot));
+}
+
+
+
+
+void StatsCollector::Reset()
+{
+	const auto now = Now();
+	m_instrs = 0;
+	m_idleInstrs = 0;
+	m_framesPresented = 0;
+	m_framesSkipped = 0;
+	m_missedDeadlines = 0;
+	m_startTime = now;
+	m_lastInstrSlot = 0;
+	m_lastFrameSlot = 0;
+	m_lastFrame = 0;
+	m_windowStart = now;
+	m_windowInstrs = 0;
+	m_windowFrames = 0;
+	m_drawNs = 0;
+	m_eventsNs = 0;
+	m_eventsCount = 0;
+	m_overshootNs = 0;
+	m_maxOvershootNs = 0;
+	m_sleepCount = 0;
+	m_frameSamplesCount = 0;
+	m_presentNs.store(0, std::memory_order_relaxed);
+	m_presentCount.store(0, std::memory_order_relaxed);
+}
+
+
+
+void StatsCollector::SetEnabled(const bool val)
+{
+	if (val && !m_enabled)
+		Reset();
+
+	m_enabled = val;
+}
+
+
+
+
+EmulatorStats StatsCollector::GetSnapshot() const
+{
+	// retry while Publish is writing the snapshot
+	EmulatorStats stats;
+	uint32_t before, after;
+
+	do {
+		before = m_sequence.load(std::memory_order_acquire);
+		memcpy(&stats, &m_snapshot, sizeof(stats));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = m_sequence.load(std::memory_order_relaxed);
+	} while ((before & 0x1) || before != after);
+
+	return stats;
+}
+
+
+
+
+void StatsCollector::AddInstrSlot(const uint64_t now, const int targetHz)
+{
+	// an instruction slot arriving more than one period late means
+	// the slots in between were never run
+	if (m_lastInstrSlot && targetHz > 0)
+		m_missedDeadlines += count_missed(now - m_lastInstrSlot, 1000000000 / targetHz);
+
+	m_lastInstrSlot = now;
+	m_targetHz = targetHz;
+	Update(now);
+}
+
+
+
+void StatsCollector::AddFrameSlot(const uint64_t now, const int targetFps)
+{
+	if (m_lastFrameSlot && targetFps > 0)
+		m_framesSkipped += count_missed(now - m_lastFrameSlot, 1000000000 / targetFps);
+
+	m_lastFrameSlot = now;
+	m_targetFps = targetFps;
+}
+
+
+
+void StatsCollector::AddFrame(const uint64_t drawNs, const uint64_t now)
+{
+	++m_framesPresented;
+	++m_windowFrames;
+	m_drawNs += drawNs;
+
+	if (m_lastFrame && m_frameSamplesCount < MAX_FRAME_SAMPLES)
+	{
+		const auto frameUs = (now - m_lastFrame) / 1000;
+		m_frameSamples[m_frameSamplesCount++] = static_cast<uint32_t>(std::min<uint64_t>(frameUs, UINT32_MAX));
+	}
+
+	m_lastFrame = now;
+	Update(now);
+}
+
+
+
+void StatsCollector::AddSleep(const uint64_t askedNs, const uint64_t sleptNs)
+{
+	const auto overshoot = sleptNs > askedNs ? sleptNs - askedNs : 0;
+	m_overshootNs += overshoot;
+	m_maxOvershootNs = std::max(m_maxOvershootNs, overshoot);
+	++m_sleepCount;
+}
+
+
+
+void StatsCollector::AddEvents(const uint64_t eventsNs)
+{
+	m_eventsNs += eventsNs;
+	++m_eventsCount;
+}
+
+
+
+void StatsCollector::AddPresent(const uint64_t drawNs)
+{
+	m_presentNs.fetch_add(drawNs, std::memory_order_relaxed);
+	m_presentCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+
+void StatsCollector::Update(const uint64_t now)
+{
+	if ((now - m_windowStart) >= WINDOW)
+		Publish(now);
+}
+
+
+
+
+uint64_t StatsCollector::Now()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+
+
+
+void StatsCollector::Publish(const uint64_t now)
+{
+	EmulatorStats stats;
+	const auto windowSecs = (now - m_windowStart) / 1e9;
+	const auto windowInstrs = m_instrs - m_windowInstrs;
+
+	stats.instructions = m_instrs;
+	stats.idleInstructions = m_idleInstrs;
+	stats.framesPresented = m_framesPresented;
+	stats.framesSkipped = m_framesSkipped;
+	stats.missedDeadlines = m_missedDeadlines;
+	stats.elapsedSecs = (now - m_startTime) / 1e9;
+	stats.instrPerSec = windowInstrs / windowSecs;
+	stats.targetInstrPerSec = m_targetHz;
+	stats.framesPerSec = m_windowFrames / windowSecs;
+	stats.targetFps = m_targetFps;
+	stats.avgDrawMs = m_windowFrames ? to_ms(m_drawNs) / m_windowFrames : 0.0;
+
+	// threaded, the frames are drawn by the presentation thread. A present
+	// added between the two exchanges only moves to the next window.
+	const auto presentNs = m_presentNs.exchange(0, std::memory_order_relaxed);
+	const auto presentCount = m_presentCount.exchange(0, std::memory_order_relaxed);
+	if (presentCount)
+		stats.avgDrawMs = to_ms(presentNs) / presentCount;
+
+	stats.avgEventsMs = m_eventsCount ? to_ms(m_eventsNs) / m_eventsCount : 0.0;
+	stats.avgSleepOvershootMs = m_sleepCount ? to_ms(m_overshootNs) / m_sleepCount : 0.0;
+	stats.maxSleepOvershootMs = to_ms(m_maxOvershootNs);
+	stats.avgFrameMs = 0.0;
+	stats.p99FrameMs = 0.0;
+
+	if (m_frameSamplesCount)
+	{
+		uint64_t sum = 0;
+		for (size_t i = 0; i < m_frameSamplesCount; ++i)
+			sum += m_frameSamples[i];
+
+		auto* const p99 = m_frameSamples + ((m_frameSamplesCount * 99) / 100);
+		std::nth_element(m_frameSamples, p99, m_frameSamples + m_frameSamplesCount);
+		stats.avgFrameMs = (sum / 1000.0) / m_frameSamplesCount;
+		stats.p99FrameMs = *p99 / 1000.0;
+	}
+
+
+	// odd sequence while writing, readers retry on it
+	const auto seq = m_sequence.load(std::memory_order_relaxed);
+	m_sequence.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&m_snapshot, &stats, sizeof(stats));
+	m_sequence.store(seq + 2, std::memory_order_release);
+
+
+	// start the next window
+	m_windowStart = now;
+	m_windowInstrs = m_instrs;
+	m_windowFrames = 0;
+	m_drawNs = 0;
+	m_eventsNs = 0;
+	m_eventsCount = 0;
+	m_overshootNs = 0;
+	m_maxOvershootNs = 0;
+	m_sleepCount = 0;
+	m_frameSamplesCount = 0;
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+inline uint64_t count_missed(const uint64_t interval, const uint64_t period)
+{
+	// rounded to the nearest period, so jitter isn't counted as a miss
+	const auto periods = (interval + (period / 2)) / period;
+	return periods > 1 ? periods - 1 : 0;
+}
+
+
+inline double to_ms(const uint64_t nanosecs)
+{
+	return nanosecs / 1e6;
+}
+
+
+
+
+}
@@ -0,0 +1,263 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/Assert.h>
+#include <Utix/ScopeExit.h>
+
+#include <XChip/Core/Trace.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+constexpr char TraceBuffer::MAGIC[8];
+constexpr uint32_t TraceBuffer::VERSION;
+constexpr size_t TraceBuffer::DEFAULT_CAPACITY;
+
+
+// local functions declarations
+namespace {
+struct Chunk
+{
+	const TraceRecord* records;
+	size_t count;
+};
+
+TraceBuffer* crashBuffer = nullptr;
+const CpuManager* crashMachine = nullptr;
+char crashFileName[256];
+
+bool write_trace(const char* fileName, const Chunk* chunks, const size_t chunksCount, const uint64_t lastCycle);
+}
+
+
+
+
+
+TraceBuffer::TraceBuffer() noexcept
+	: m_head(0)
+{
+	Log("Creating TraceBuffer object...");
+}
+
+
+TraceBuffer::~TraceBuffer()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying TraceBuffer object...");
+}
+
+
+
+bool TraceBuffer::Initialize(const size_t capacity) noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	// a power of two, so the ring index is a mask
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	m_records = static_cast<TraceRecord*>(alloc_arr(sizeof(TraceRecord) * size));
+	if (!m_records)
+	{
+		LogError("TraceBuffer: cannot allocate %zu records", size);
+		return false;
+	}
+
+	m_mask = size - 1;
+	m_head.store(0, std::memory_order_relaxed);
+	m_initialized = true;
+	return true;
+}
+
+
+
+void TraceBuffer::Dispose() noexcept
+{
+	if (crashBuffer == this)
+	{
+		crashBuffer = nullptr;
+		crashMachine = nullptr;
+	}
+
+	if (m_records)
+	{
+		free_arr(m_records);
+		m_records = nullptr;
+	}
+
+	m_mask = 0;
+	m_head.store(0, std::memory_order_relaxed);
+	m_initialized = false;
+}
+
+
+
+
+bool TraceBuffer::Dump(const char* fileName) const
+{
+	ASSERT_MSG(m_initialized, "TraceBuffer is not initialized");
+
+	const uint64_t capacity = GetCapacity();
+	const uint64_t head = m_head.load(std::memory_order_acquire);
+	const uint64_t begin = head > capacity ? head - capacity : 0;
+	const auto count = static_cast<size_t>(head - begin);
+
+	auto* const copy = static_cast<TraceRecord*>(alloc_arr(sizeof(TraceRecord) * (count ? count : 1)));
+	if (!copy)
+	{
+		LogError("TraceBuffer: cannot allocate dump copy");
+		return false;
+	}
+
+	const auto free_copy = MakeScopeExit([copy]() noexcept { free_arr(copy); });
+
+	for (uint64_t cycle = begin; cycle < head; ++cycle)
+		copy[cycle - begin] = m_records[cycle & m_mask];
+
+	// the writer kept going while we copied: whatever it 
+	// wrapped over in the meantime may be torn, drop it.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint64_t after = m_head.load(std::memory_order_relaxed);
+	const uint64_t valid = after > capacity ? after - capacity : 0;
+	const auto skip = static_cast<size_t>(std::min<uint64_t>(valid > begin ? valid - begin : 0, count));
+
+	const Chunk chunk = { copy + skip, count - skip };
+	return write_trace(fileName, &chunk, 1, head ? head - 1 : 0);
+}
+
+
+
+
+void TraceBuffer::SetCrashDump(const char* fileName, const CpuManager& machine)
+{
+	ASSERT_MSG(strlen(fileName) < sizeof(crashFileName), "crash dump file name too long");
+
+	strncpy(crashFileName, fileName, sizeof(crashFileName) - 1);
+	crashFileName[sizeof(crashFileName) - 1] = '\0';
+	crashBuffer = this;
+	crashMachine = &machine;
+}
+
+
+
+
+bool TraceBuffer::DumpCrash(const CpuManager* current)
+{
+	TraceBuffer* const trace = crashBuffer;
+	if (!trace || !trace->m_initialized || (current && current != crashMachine))
+		return false;
+
+	// the emulation has stopped, and this may be a signal handler:
+	// write straight from the ring, no allocations nor copies.
+	const uint64_t capacity = trace->GetCapacity();
+	const uint64_t head = trace->m_head.load(std::memory_order_acquire);
+	const auto split = static_cast<size_t>(head & trace->m_mask);
+
+	Chunk chunks[3];
+	size_t count = 0;
+	if (head >= capacity)
+		chunks[count++] = { trace->m_records + split, static_cast<size_t>(capacity) - split };
+
+	chunks[count++] = { trace->m_records, split };
+
+
+	// the instruction which failed has not been recorded yet
+	TraceRecord failed;
+	if (current)
+	{
+		const auto opcode = current->GetOpcode();
+		failed.cycle = static_cast<uint32_t>(head);
+		failed.pc = static_cast<uint16_t>(current->GetPC() - 2);
+		failed.opcode = opcode;
+		failed.I = static_cast<uint16_t>(current->GetIndexRegister());
+		failed.vx = current->GetRegisters()[(opcode >> 8) & 0xF];
+		failed.vf = current->GetRegisters()[0xF];
+		chunks[count++] = { &failed, 1 };
+		return write_trace(crashFileName, chunks, count, head);
+	}
+
+	return write_trace(crashFileName, chunks, count, head ? head - 1 : 0);
+}
+
+
+
+
+
+
+
+
+
+// local functions definitions
+namespace {
+
+
+bool write_trace(const char* fileName, const Chunk* chunks, const size_t chunksCount, const uint64_t lastCycle)
+{
+	FILE* const file = fopen(fileName, "wb");
+	if (!file)
+	{
+		LogError("TraceBuffer: cannot open \'%s\'", fileName);
+		return false;
+	}
+
+	TraceHeader header;
+	memcpy(header.magic, TraceBuffer::MAGIC, sizeof(header.magic));
+	header.version = TraceBuffer::VERSION;
+	header.recordSize = sizeof(TraceRecord);
+	header.count = 0;
+	header.lastCycle = lastCycle;
+
+	for (size_t i = 0; i < chunksCount; ++i)
+		header.count += chunks[i].count;
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (size_t i = 0; ok && i < chunksCount; ++i)
+		ok = chunks[i].count == 0 || fwrite(chunks[i].records, sizeof(TraceRecord), chunks[i].count, file) == chunks[i].count;
+
+	if (fclose(file) != 0 || !ok)
+	{
+		LogError("TraceBuffer: failed to write \'%s\'", fileName);
+		return false;
+	}
+
+	Log("TraceBuffer: %llu records dumped to %s", static_cast<unsigned long long>(header.count), fileName);
+	return true;
+}
+
+
+}
+
+
+
+
+}
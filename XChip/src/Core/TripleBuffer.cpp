@@ -0,0 +1,133 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstring>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+#include <Utix/Assert.h>
+
+#include <XChip/Core/TripleBuffer.h>
+
+
+
+namespace xchip {
+
+using namespace utix;
+
+
+
+
+TripleBuffer::TripleBuffer() noexcept
+	: m_middle(2)
+{
+	Log("Creating TripleBuffer object...");
+	for (auto& frame : m_frames)
+		frame = { nullptr, { 0, 0 }, 0 };
+}
+
+
+TripleBuffer::~TripleBuffer()
+{
+	if (m_initialized)
+		this->Dispose();
+
+	Log("Destroying TripleBuffer object...");
+}
+
+
+
+bool TripleBuffer::Initialize(const size_t maxPixels) noexcept
+{
+	if (m_initialized)
+		this->Dispose();
+
+	m_pixels = static_cast<uint8_t*>(alloc_arr(maxPixels * 3));
+	if (!m_pixels)
+	{
+		LogError("TripleBuffer: cannot allocate 3 frames of %zu pixels", maxPixels);
+		return false;
+	}
+
+	memset(m_pixels, 0, maxPixels * 3);
+	for (size_t i = 0; i < 3; ++i)
+		m_frames[i] = { m_pixels + (maxPixels * i), { 0, 0 }, 0 };
+
+	m_maxPixels = maxPixels;
+	m_back = 0;
+	m_front = 1;
+	m_middle.store(2, std::memory_order_relaxed);
+	m_published = 0;
+	m_initialized = true;
+	return true;
+}
+
+
+
+void TripleBuffer::Dispose() noexcept
+{
+	if (m_pixels)
+	{
+		free_arr(m_pixels);
+		m_pixels = nullptr;
+	}
+
+	for (auto& frame : m_frames)
+		frame = { nullptr, { 0, 0 }, 0 };
+
+	m_maxPixels = 0;
+	m_initialized = false;
+}
+
+
+
+
+void TripleBuffer::Publish()
+{
+	ASSERT_MSG(m_initialized, "TripleBuffer is not initialized");
+
+	m_frames[m_back].number = ++m_published;
+
+	// release the pixels just written, take back whatever frame the 
+	// consumer left in the middle: an acquired one or an unseen one.
+	const auto old = m_middle.exchange(static_cast<uint8_t>(m_back | FRESH), std::memory_order_acq_rel);
+	m_back = old & INDEX_MASK;
+}
+
+
+
+
+const Frame* TripleBuffer::Acquire()
+{
+	ASSERT_MSG(m_initialized, "TripleBuffer is not initialized");
+
+	// only the consumer clears FRESH, it can't go away before the exchange
+	if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+		return nullptr;
+
+	const auto old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+	m_front = old & INDEX_MASK;
+	return &m_frames[m_front];
+}
+
+
+
+
+}
@@ -0,0 +1,138 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <Utix/Log.h>
+#include <Utix/CliOpts.h>
+
+#include <XChip/Core/Analyzer.h>
+#include <XChip/Core/MappedFile.h>
+
+
+
+/*******************************************************************************************
+ *	XChipDisasm -ROM <file> [-BASE addr] [-ENTRY addr] [-SHOW list|report|all] [-OUT file]
+ *	static analysis of a ROM: the report has code / data sizes, the call graph,
+ *	BNNN jump tables and self-modifying stores, the listing has every byte of the
+ *	image as code or data. BASE is where the ROM is loaded, ENTRY defaults to it.
+ *	addresses are hex.
+ *******************************************************************************************/
+
+
+
+
+namespace {
+bool parse_address(const std::string& str, const size_t def, size_t& address);
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+	using namespace utix;
+	using xchip::Analyzer;
+	using xchip::LoadStatus;
+	using xchip::MappedFile;
+
+	const CliOpts opts(argc - 1, argv + 1);
+	const auto romPath = opts.GetOpt("-ROM");
+	const auto outPath = opts.GetOpt("-OUT");
+	auto show = opts.GetOpt("-SHOW");
+	size_t base, entry;
+
+	if (show.empty())
+		show = "all";
+
+	if (romPath.empty() || !parse_address(opts.GetOpt("-BASE"), 0x200, base)
+		|| !parse_address(opts.GetOpt("-ENTRY"), base, entry)
+		|| (show != "list" && show != "report" && show != "all"))
+	{
+		fprintf(stderr, "Usage: %s -ROM <file> [-BASE addr] [-ENTRY addr] [-SHOW list|report|all] [-OUT file]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+
+	MappedFile rom;
+	if (rom.Initialize(romPath.c_str()) != LoadStatus::OK)
+	{
+		LogError("XChipDisasm: could not load \'%s\': %s", romPath.c_str(), GetLastLogError().c_str());
+		return EXIT_FAILURE;
+	}
+
+	Analyzer analyzer;
+	if (!analyzer.Initialize() || !analyzer.Analyze(rom.GetData(), rom.GetSize(), base, entry))
+	{
+		LogError("XChipDisasm: could not analyze \'%s\': %s", romPath.c_str(), GetLastLogError().c_str());
+		return EXIT_FAILURE;
+	}
+
+
+	FILE* const out = outPath.empty() ? stdout : fopen(outPath.c_str(), "w");
+	if (!out)
+	{
+		LogError("XChipDisasm: could not open \'%s\'", outPath.c_str());
+		return EXIT_FAILURE;
+	}
+
+	fprintf(out, "; %s\n", romPath.c_str());
+
+	if (show != "list")
+		analyzer.WriteReport(out);
+
+	if (show != "report")
+		analyzer.WriteListing(out);
+
+	if (out != stdout)
+		fclose(out);
+
+	return EXIT_SUCCESS;
+}
+
+
+
+
+
+
+
+
+
+
+namespace {
+
+
+bool parse_address(const std::string& str, const size_t def, size_t& address)
+{
+	if (str.empty())
+	{
+		address = def;
+		return true;
+	}
+
+	char* end;
+	address = strtoul(str.c_str(), &end, 16);
+	return *end == '\0' && address < xchip::Analyzer::MAX_ADDRESS;
+}
+
+
+}
@@ -0,0 +1,428 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <XChip/Core/Emulator.h>
+#include <XChip/Core/Disassembler.h>
+#include "DebugConsole.h"
+
+
+
+/*******************************************************************************************
+ *	addresses are hex, other values are decimal unless prefixed by 0x
+ *	c                      continue
+ *	s                      step one instruction
+ *	n                      step over a 2NNN call
+ *	u ADDR                 run to ADDR
+ *	b ADDR / db ADDR       set / delete a breakpoint
+ *	w ADDR [SIZE] [r|w|rw] watch memory reads and/or writes, default 1 byte rw
+ *	dw ADDR [SIZE]         delete a watchpoint
+ *	cond REG OP VALUE      break when it becomes true. REG: V0-VF I DT SP, OP: == != < >
+ *	dc INDEX               delete a condition
+ *	r                      show the cpu state
+ *	m ADDR [COUNT]         dump memory, default 16 bytes
+ *	d [ADDR] [COUNT]       disassemble from ADDR or PC, default 8 instructions
+ *	l                      list breakpoints, watchpoints and conditions
+ *	q                      quit
+ *******************************************************************************************/
+
+
+
+
+namespace {
+using xchip::Debugger;
+using xchip::CpuManager;
+
+const char* const helpText =
+	"c: continue  s: step  n: step over  u ADDR: run to\n"
+	"b ADDR / db ADDR: breakpoint  w ADDR [SIZE] [r|w|rw] / dw ADDR [SIZE]: watchpoint\n"
+	"cond REG OP VALUE / dc INDEX: condition (REG V0-VF I DT SP, OP == != < >)\n"
+	"r: cpu state  m ADDR [COUNT]: memory  d [ADDR] [COUNT]: disassemble  l: list  q: quit\n";
+
+const char* const reasonNames[] =
+{
+	"none", "pause", "breakpoint", "watch read", "watch write", "condition", "step"
+};
+
+const char* const compareNames[] = { "==", "!=", "<", ">" };
+
+
+void PrintBreak(const Debugger& debugger, const CpuManager& cpuMan);
+void PrintState(const CpuManager& cpuMan);
+void PrintMemory(const CpuManager& cpuMan, const size_t address, const size_t count);
+void PrintDisassembly(const CpuManager& cpuMan, const size_t address, const size_t count);
+void PrintList(const Debugger& debugger);
+bool ParseRegister(const std::string& name, uint8_t& reg);
+bool ParseCompare(const std::string& op, Debugger::Compare& cmp);
+bool ParseNumber(const std::string& str, const int base, unsigned long& value);
+std::string RegisterName(const uint8_t reg);
+}
+
+
+
+
+
+bool RunDebugConsole(xchip::Emulator& emulator)
+{
+	Debugger& debugger = emulator.GetDebugger();
+	const CpuManager& cpuMan = emulator.GetCpuManager();
+
+	PrintBreak(debugger, cpuMan);
+
+	std::string line;
+	while (std::cout << "xchip> " << std::flush, std::getline(std::cin, line))
+	{
+		std::istringstream input(line);
+		std::string cmd, arg1, arg2, arg3;
+		input >> cmd >> arg1 >> arg2 >> arg3;
+
+		unsigned long addr = 0, value = 0;
+		const bool hasAddr = ParseNumber(arg1, 16, addr) && addr < Debugger::MAX_ADDRESS;
+
+		if (cmd.empty())
+		{
+			continue;
+		}
+		else if (cmd == "c")
+		{
+			debugger.Continue();
+			return true;
+		}
+		else if (cmd == "s")
+		{
+			debugger.Step();
+			return true;
+		}
+		else if (cmd == "n")
+		{
+			debugger.StepOver(cpuMan);
+			return true;
+		}
+		else if (cmd == "u" && hasAddr)
+		{
+			debugger.RunTo(static_cast<uint16_t>(addr));
+			return true;
+		}
+		else if ((cmd == "b" || cmd == "db") && hasAddr)
+		{
+			debugger.SetBreakpoint(static_cast<uint16_t>(addr), cmd == "b");
+		}
+		else if ((cmd == "w" || cmd == "dw") && hasAddr)
+		{
+			size_t size = 1;
+			if (!arg2.empty() && arg2 != "r" && arg2 != "w" && arg2 != "rw")
+			{
+				if (!ParseNumber(arg2, 0, value) || value == 0)
+				{
+					std::cout << "bad size: " << arg2 << '\n';
+					continue;
+				}
+
+				size = value;
+				arg2 = arg3;
+			}
+
+			uint8_t watch = 0;
+			if (cmd == "w")
+			{
+				watch = (arg2 == "r") ? Debugger::WATCH_READ 
+				      : (arg2 == "w") ? Debugger::WATCH_WRITE 
+				      : (Debugger::WATCH_READ | Debugger::WATCH_WRITE);
+			}
+
+			debugger.SetWatchpoint(static_cast<uint16_t>(addr), size, watch);
+		}
+		else if (cmd == "cond")
+		{
+			uint8_t reg;
+			Debugger::Compare cmp;
+			if (!ParseRegister(arg1, reg) || !ParseCompare(arg2, cmp) || !ParseNumber(arg3, 0, value))
+			{
+				std::cout << "usage: cond REG OP VALUE\n";
+				continue;
+			}
+
+			const int index = debugger.AddCondition(reg, cmp, static_cast<uint16_t>(value));
+			if (index >= 0)
+				std::cout << "condition " << index << '\n';
+			else
+				std::cout << "no room for more conditions\n";
+		}
+		else if (cmd == "dc")
+		{
+			if (!ParseNumber(arg1, 0, value) || !debugger.RemoveCondition(static_cast<int>(value)))
+				std::cout << "no such condition: " << arg1 << '\n';
+		}
+		else if (cmd == "r")
+		{
+			PrintState(cpuMan);
+		}
+		else if (cmd == "m" && hasAddr)
+		{
+			unsigned long count = 16;
+			if (!arg2.empty() && !ParseNumber(arg2, 0, count))
+				count = 16;
+
+			PrintMemory(cpuMan, addr, count);
+		}
+		else if (cmd == "d")
+		{
+			unsigned long count = 8;
+			if (!arg2.empty() && !ParseNumber(arg2, 0, count))
+				count = 8;
+
+			PrintDisassembly(cpuMan, hasAddr ? addr : cpuMan.GetPC(), count);
+		}
+		else if (cmd == "l")
+		{
+			PrintList(debugger);
+		}
+		else if (cmd == "q")
+		{
+			return false;
+		}
+		else
+		{
+			std::cout << helpText;
+		}
+	}
+
+	// stdin closed, nothing can resume us later
+	return false;
+}
+
+
+
+
+
+
+
+
+
+
+namespace {
+
+
+void PrintBreak(const Debugger& debugger, const CpuManager& cpuMan)
+{
+	const auto& info = debugger.GetBreakInfo();
+	printf("\n*** %s at 0x%03X", reasonNames[static_cast<int>(info.reason)], info.pc);
+
+	switch (info.reason)
+	{
+		case Debugger::Reason::WATCH_READ:
+		case Debugger::Reason::WATCH_WRITE:
+			printf(", address 0x%03X", info.address);
+			break;
+
+		case Debugger::Reason::CONDITION:
+			printf(", condition %u", info.address);
+			break;
+
+		default:
+			break;
+	}
+
+	printf(" ***\n");
+	PrintState(cpuMan);
+}
+
+
+
+
+void PrintState(const CpuManager& cpuMan)
+{
+	const auto pc = cpuMan.GetPC();
+	const uint8_t* const code = cpuMan.GetMemoryAt(pc);
+	const uint16_t opcode = (code[0] << 8) | code[1];
+	char text[xchip::disassembler::MAX_TEXT_SIZE];
+	xchip::disassembler::Disassemble(opcode, text, sizeof(text));
+	printf("PC: 0x%03zX  opcode: %04X %s  I: 0x%03zX  SP: %zu  DT: %u  ST: %u\n", pc, opcode, text,
+	       cpuMan.GetIndexRegister(), cpuMan.GetSP(), cpuMan.GetDelayTimer(), cpuMan.GetSoundTimer());
+
+	for (size_t i = 0; i < 16; ++i)
+		printf("V%zX: %02X%s", i, cpuMan.GetRegisters(i), (i % 8) == 7 ? "\n" : "  ");
+
+	if (cpuMan.GetSP())
+	{
+		printf("stack:");
+		for (size_t i = 0; i < cpuMan.GetSP(); ++i)
+			printf(" 0x%03zX", cpuMan.GetStack(i));
+		printf("\n");
+	}
+
+	fflush(stdout);
+}
+
+
+
+
+void PrintMemory(const CpuManager& cpuMan, const size_t address, const size_t count)
+{
+	const auto end = std::min(address + count, cpuMan.GetMemorySize());
+	for (size_t row = address; row < end; row += 16)
+	{
+		printf("0x%03zX:", row);
+		for (size_t i = row; i < end && i < row + 16; ++i)
+			printf(" %02X", cpuMan.GetMemory(i));
+		printf("\n");
+	}
+
+	fflush(stdout);
+}
+
+
+
+
+void PrintDisassembly(const CpuManager& cpuMan, const size_t address, const size_t count)
+{
+	for (size_t i = 0, pc = address; i < count && pc + 1 < cpuMan.GetMemorySize(); ++i)
+	{
+		const uint16_t opcode = (cpuMan.GetMemory(pc) << 8) | cpuMan.GetMemory(pc + 1);
+		char text[xchip::disassembler::MAX_TEXT_SIZE];
+		xchip::disassembler::Disassemble(opcode, text, sizeof(text));
+		printf("%s0x%03zX  %04X  %s\n", pc == cpuMan.GetPC() ? "> " : "  ", pc, opcode, text);
+
+		// F000 NNNN's address word
+		const auto size = xchip::disassembler::GetInstrSize(opcode);
+		if (size == 4 && pc + 3 < cpuMan.GetMemorySize())
+			printf("  0x%03zX  %02X%02X\n", pc + 2, cpuMan.GetMemory(pc + 2), cpuMan.GetMemory(pc + 3));
+
+		pc += size;
+	}
+
+	fflush(stdout);
+}
+
+
+
+
+void PrintList(const Debugger& debugger)
+{
+	printf("breakpoints:");
+	for (size_t addr = 0; addr < Debugger::MAX_ADDRESS; ++addr)
+	{
+		if (debugger.GetBreakpoint(static_cast<uint16_t>(addr)))
+			printf(" 0x%03zX", addr);
+	}
+
+	// contiguous addresses with the same mask print as one range
+	printf("\nwatchpoints:");
+	for (size_t addr = 0; addr < Debugger::MAX_ADDRESS; ++addr)
+	{
+		const auto watch = debugger.GetWatchpoint(static_cast<uint16_t>(addr));
+		if (!watch)
+			continue;
+
+		size_t last = addr;
+		while (last + 1 < Debugger::MAX_ADDRESS && debugger.GetWatchpoint(static_cast<uint16_t>(last + 1)) == watch)
+			++last;
+
+		printf(" 0x%03zX-0x%03zX(%s%s)", addr, last, (watch & Debugger::WATCH_READ) ? "r" : "",
+		       (watch & Debugger::WATCH_WRITE) ? "w" : "");
+		addr = last;
+	}
+
+	printf("\nconditions:\n");
+	for (size_t i = 0; i < Debugger::MAX_CONDITIONS; ++i)
+	{
+		uint8_t reg;
+		Debugger::Compare cmp;
+		uint16_t value;
+		if (debugger.GetCondition(static_cast<int>(i), reg, cmp, value))
+			printf("  %zu: %s %s %u\n", i, RegisterName(reg).c_str(), compareNames[static_cast<int>(cmp)], value);
+	}
+
+	fflush(stdout);
+}
+
+
+
+
+bool ParseRegister(const std::string& name, uint8_t& reg)
+{
+	if (name == "I")
+		reg = Debugger::REG_I;
+	else if (name == "DT")
+		reg = Debugger::REG_DT;
+	else if (name == "SP")
+		reg = Debugger::REG_SP;
+	else if (name.size() == 2 && (name[0] == 'V' || name[0] == 'v') && isxdigit(name[1]))
+		reg = static_cast<uint8_t>(strtoul(name.c_str() + 1, nullptr, 16));
+	else
+		return false;
+
+	return true;
+}
+
+
+
+bool ParseCompare(const std::string& op, Debugger::Compare& cmp)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		if (op == compareNames[i])
+		{
+			cmp = static_cast<Debugger::Compare>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+bool ParseNumber(const std::string& str, const int base, unsigned long& value)
+{
+	if (str.empty())
+		return false;
+
+	char* end;
+	value = strtoul(str.c_str(), &end, base);
+	return *end == '\0';
+}
+
+
+
+std::string RegisterName(const uint8_t reg)
+{
+	switch (reg)
+	{
+		case Debugger::REG_I: return "I";
+		case Debugger::REG_DT: return "DT";
+		case Debugger::REG_SP: return "SP";
+		default:
+		{
+			const char name[3] = { 'V', "0123456789ABCDEF"[reg & 0xF], '\0' };
+			return name;
+		}
+	}
+}
+
+
+}
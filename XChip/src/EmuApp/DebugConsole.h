@@ -0,0 +1,36 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#ifndef XCHIP_EMUAPP_DEBUGCONSOLE_H_
+#define XCHIP_EMUAPP_DEBUGCONSOLE_H_
+
+namespace xchip {
+class Emulator;
+}
+
+
+// stdin front-end for the Emulator's Debugger. Called while the debugger
+// is paused, it reads commands until one resumes the emulation. Returns
+// false when the user asked to quit.
+bool RunDebugConsole(xchip::Emulator& emulator);
+
+
+
+#endif // XCHIP_EMUAPP_DEBUGCONSOLE_H_
@@ -22,12 +22,17 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #if defined(__linux__) || defined(__APPLE__)
 #include <signal.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #elif defined( _WIN32 )
 #include <windows.h>
+#include <psapi.h>
 #include <stdlib.h>
 #endif
 
 
+#include <csignal>
+#include <cstdio>
+#include <chrono>
 #include <stdexcept>
 #include <algorithm>
 #include <utility>
@@ -39,25 +44,59 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 
 
 #include <XChip/Core/Emulator.h>
+#include <XChip/Core/RomLibrary.h>
+#include "DebugConsole.h"
+
+#ifdef XCHIP_STATIC_PLUGINS
+#include <XChip/Plugins/SDLPlugins/SdlRender.h>
+#include <XChip/Plugins/SDLPlugins/SdlInput.h>
+#include <XChip/Plugins/SDLPlugins/SdlSound.h>
+
+// LoadPlugins() creates these and nothing swaps them later,
+// so the per frame calls of the main loop go to them directly
+using RenderPlugin = xchip::SdlRender;
+using InputPlugin = xchip::SdlInput;
+#else
+using RenderPlugin = xchip::iRender;
+using InputPlugin = xchip::iInput;
+#endif
+
+#ifdef XCHIP_PROFILER
+#include <XChip/Core/Profiler.h>
+#endif
 
 
 
 /*******************************************************************************************
- *	-ROM  game rom path
- *	-REN  render plugin path
- *	-INP  input plugin path
- *	-SND  sound plugin path
+ *	-ROM  game rom path, or the rom name/hash when -LIB is used
+ *	-LIB  packed rom library path
+ *	-REN  render plugin path, ignored when built with STATIC_PLUGINS
+ *	-INP  input plugin path, ignored when built with STATIC_PLUGINS
+ *	-SND  sound plugin path, ignored when built with STATIC_PLUGINS
  *	-RES  window size: WidthxHeight ex: -RES 200x300 and -RES FULLSCREEN for fullscreen
  *	-CHZ  Cpu Frequency in hz ex: -CHZ 600
  *	-SHZ  Sound Tone in hz ex: -SHZ 400
  *	-COL  Color in RGB ex: -COL 100x200x255
  *	-BKG  Background color in RGB ex: -BKG 255x0x0
+ *	-PAL  the 4 XO-Chip plane colors in RGB: background, plane 1, plane 2, both planes
+ *	      ex: -PAL 0x0x0,255x255x255,170x170x170,85x85x85
  *	-FPS  Frame Rate ex: -FPS 30
+ *	-STATS  log performance counters as CSV every N seconds ex: -STATS 5
+ *	-BENCH  run N frames uncapped with no input, print the results and exit ex: -BENCH 3000
+ *	-PRESENT  draw the frames while in -BENCH: ON or OFF, default OFF
+ *	-TRACE  record the last executed instructions, dumped to this file on
+ *	        unknown opcodes, assertions and SIGUSR1 ex: -TRACE crash.trace
+ *	-DEBUG  ON: start paused in the stdin debugger console, see DebugConsole.cpp
+ *	-IDLE  ON: fast-forward idle loops waiting on the delay timer or a key, default OFF
+ *	-THREADED  ON: emulate on a worker thread, this one only presents. default OFF,
+ *	           not with -DEBUG. SIGUSR1 -TRACE dumps are taken when it stops
  *******************************************************************************************/
 
 /*********************************************************
  * SIGNALS:
- * SIGINT - set g_emulator exitflag
+ * SIGINT - set g_emulator exitflag, or break into the console with -DEBUG ON
+ * SIGUSR1 - dump the -TRACE buffer
+ * SIGABRT - dump the -TRACE buffer, then abort
  * CTRL_EVENT: windows ConsoleCtrlEvents...
  *********************************************************/
 
@@ -65,15 +104,29 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 
 
 static xchip::Emulator g_emulator;
+static int g_statsInterval = 0;
+static int g_benchFrames = 0;
+static bool g_benchPresent = false;
+static bool g_threaded = false;
+static std::string g_traceFile;
+static volatile sig_atomic_t g_traceDumpRequest = 0;
+static volatile sig_atomic_t g_debugBreakRequest = 0;
 
 namespace {
 void DisplayErrorMsg(const std::string& title, const std::string& errmsg);
+void LoadRom(const utix::CliOpts& opts);
 void LoadPlugins(const utix::CliOpts& opts);
 void ConfigureEmulator(const utix::CliOpts& opts);
+void LogStats();
+void RunLoop();
+void RunBenchmark();
+bool RunThreaded();
 }
 
+void signals_sigabrt(const int signum);
 #if defined(__linux__) || defined(__APPLE__)
 void signals_sigint(const int signum);
+void signals_sigusr1(const int signum);
 #elif defined(_WIN32)
 bool _stdcall ctrl_handler(DWORD ctrlType);
 #endif
@@ -94,14 +147,15 @@ int main(int argc, char **argv)
 	
 	if (argc < 2) 
 	{
-		std::cerr << "Usage: " << argv[0] << " -ROM <rompath>\n";
+		std::cerr << "Usage: " << argv[0] << " -ROM <rompath>\n"
+		          << "       " << argv[0] << " -LIB <library> -ROM <name or hash>\n";
 		return EXIT_FAILURE;
 	}
 	
 
 #if defined(__linux__) || defined(__APPLE__) 
 
-	if (signal(SIGINT, signals_sigint) == SIG_ERR)
+	if (signal(SIGINT, signals_sigint) == SIG_ERR || signal(SIGUSR1, signals_sigusr1) == SIG_ERR)
 	{
 		LogError("Could not install signal handler");
 		return EXIT_FAILURE;
@@ -125,20 +179,18 @@ int main(int argc, char **argv)
 			throw std::runtime_error(utix::GetLastLogError());
 
 		const CliOpts opts(argc-1, argv+1);
-		auto romPath = opts.GetOpt("-ROM");
-
-		if (romPath.empty())
-			throw std::runtime_error("Missing -ROM argument");
-		
-		else if (!g_emulator.LoadRom(romPath))
-			throw std::runtime_error(utix::GetLastLogError());
-	
-
+		LoadRom(opts);
 		LoadPlugins(opts);
 		ConfigureEmulator(opts);
 
 		if(!g_emulator.Good())
 			throw std::runtime_error("Could not initialize emulator!");
+
+		if (!g_traceFile.empty() && signal(SIGABRT, signals_sigabrt) == SIG_ERR)
+			throw std::runtime_error("Could not install SIGABRT handler");
+
+		if (g_threaded && g_emulator.GetDebuggerEnabled())
+			throw std::runtime_error("-THREADED does not work with -DEBUG");
 		
 	}
 	catch(std::exception& err) {
@@ -147,26 +199,93 @@ int main(int argc, char **argv)
 	}
 	
 
-
-	while (!g_emulator.GetExitFlag())
+	// fall through to the exit, so the profiler reports the run.
+	// the threaded run has joined its worker by then
+	int result = EXIT_SUCCESS;
+	if (g_benchFrames)
 	{
-		g_emulator.UpdateSystems(); 
-		g_emulator.HaltForNextFlag();		
-		if (g_emulator.GetInstrFlag()) 			
-			g_emulator.ExecuteInstr();
-		if (g_emulator.GetDrawFlag())
-			g_emulator.Draw();
+		RunBenchmark();
+	}
+	else if (g_threaded)
+	{
+		if (!RunThreaded())
+			result = EXIT_FAILURE;
+	}
+	else
+	{
+		RunLoop();
 	}
 
 
+#ifdef XCHIP_PROFILER
+	xchip::profiler::Report(stdout);
+#endif
 
-	return EXIT_SUCCESS;
+	return result;
 }
 
 // locals functions definitions
 namespace {
 
 
+void LoadRom(const utix::CliOpts& opts)
+{
+	const auto rom = opts.GetOpt("-ROM");
+	if (rom.empty())
+		throw std::runtime_error("Missing -ROM argument");
+
+	const auto libPath = opts.GetOpt("-LIB");
+	if (libPath.empty())
+	{
+		if (!g_emulator.LoadRom(rom))
+			throw std::runtime_error(utix::GetLastLogError());
+		return;
+	}
+
+	// -ROM names a rom inside the library
+	xchip::RomLibrary library;
+	if (library.Initialize(libPath.c_str()) != xchip::LoadStatus::OK)
+		throw std::runtime_error(utix::GetLastLogError());
+
+	const auto* const entry = library.Find(rom.c_str());
+	if (!entry)
+		throw std::runtime_error("Could not find \'" + rom + "\' in " + libPath);
+
+	if (!g_emulator.LoadRom(library.GetRomData(*entry), entry->size))
+		throw std::runtime_error(utix::GetLastLogError());
+}
+
+
+
+
+#if defined(XCHIP_STATIC_PLUGINS)
+void LoadPlugins(const utix::CliOpts& opts)
+{
+	using xchip::UniqueRender;
+	using xchip::UniqueInput;
+	using xchip::UniqueSound;
+
+	if (!opts.GetOpt("-REN").empty() || !opts.GetOpt("-INP").empty() || !opts.GetOpt("-SND").empty())
+		utix::Log("the SDL plugins are linked in, -REN -INP -SND are ignored");
+
+	// no shared libraries to open, the plugins are created in place
+	UniqueRender rend;
+	UniqueInput input;
+	UniqueSound sound;
+	if(!rend.Load(new(std::nothrow) xchip::SdlRender()))
+		throw std::runtime_error("Failed to create Render Plugin");
+	if(!input.Load(new(std::nothrow) xchip::SdlInput()))
+		throw std::runtime_error("Failed to create Input Plugin");
+	if(!sound.Load(new(std::nothrow) xchip::SdlSound()))
+		throw std::runtime_error("Failed to create Sound Plugin");
+
+	g_emulator.SetPlugin(std::move(rend));
+	g_emulator.SetPlugin(std::move(input));
+	g_emulator.SetPlugin(std::move(sound));
+}
+
+#else
+
 #ifdef _WIN32
 template<class P>
 constexpr const char* DefaultPluginPath() {
@@ -231,6 +350,8 @@ void LoadPlugins(const utix::CliOpts& opts)
 	g_emulator.SetPlugin(std::move(sound));
 }
 
+#endif // XCHIP_STATIC_PLUGINS
+
 
 
 
@@ -243,7 +364,15 @@ void chz_config(const std::string& arg);
 void shz_config(const std::string& arg);
 void col_config(const std::string& arg);
 void bkg_config(const std::string& arg);
+void pal_config(const std::string& arg);
 void fps_config(const std::string& arg);
+void stats_config(const std::string& arg);
+void bench_config(const std::string& arg);
+void present_config(const std::string& arg);
+void trace_config(const std::string& arg);
+void debug_config(const std::string& arg);
+void idle_config(const std::string& arg);
+void threaded_config(const std::string& arg);
 
 void ConfigureEmulator(const utix::CliOpts& opts)
 {
@@ -260,7 +389,15 @@ void ConfigureEmulator(const utix::CliOpts& opts)
 		{"-SHZ", shz_config},
 		{"-COL", col_config},
 		{"-BKG", bkg_config},
-		{"-FPS", fps_config}
+		{"-PAL", pal_config},
+		{"-FPS", fps_config},
+		{"-STATS", stats_config},
+		{"-BENCH", bench_config},
+		{"-PRESENT", present_config},
+		{"-TRACE", trace_config},
+		{"-DEBUG", debug_config},
+		{"-IDLE", idle_config},
+		{"-THREADED", threaded_config}
 	};
 
 	for(const auto& it : configPairs)
@@ -425,6 +562,41 @@ void bkg_config(const std::string& arg)
 
 
 
+void pal_config(const std::string& arg)
+{
+	try {
+		std::cout << "setting palette colors...\n";
+
+		if(!g_emulator.GetRender())
+			throw std::runtime_error("null Render");
+
+		size_t begin = 0;
+		for (uint8_t index = 0; index < xchip::iRender::PALETTE_SIZE; ++index)
+		{
+			const auto end = arg.find(',', begin);
+			if (end == std::string::npos && index + 1 < xchip::iRender::PALETTE_SIZE)
+				throw std::runtime_error("Bad palette input, Please use 4 comma separated rgb colors");
+
+			const auto color = get_arg_rgb(arg.substr(begin, end - begin));
+			if(!g_emulator.GetRender()->SetPaletteColor(index, color))
+				throw std::runtime_error(utix::GetLastLogError());
+
+			std::cout << "palette color " << +index << ": " << g_emulator.GetRender()->GetPaletteColor(index) << '\n';
+			begin = end + 1;
+		}
+
+		std::cout << "done.\n";
+	}
+	catch(std::exception& e) {
+		DisplayErrorMsg("pal_config", e.what());
+	}
+
+}
+
+
+
+
+
 void fps_config(const std::string& arg)
 {
 	try {
@@ -441,6 +613,334 @@ void fps_config(const std::string& arg)
 }
 
 
+void stats_config(const std::string& arg)
+{
+	try {
+		std::cout << "setting performance stats...\n";
+		// the emulator publishes its counters once per second
+		g_statsInterval = std::max(std::stoi(arg), 1);
+		g_emulator.SetStatsEnabled(true);
+		std::cout << "stats interval: " << g_statsInterval << "s\n";
+		std::cout << "done.\n";
+
+		printf("stats,elapsed_s,instructions,instr_per_sec,target_instr_per_sec,frames_presented,"
+		       "frames_skipped,fps,target_fps,avg_frame_ms,p99_frame_ms,avg_sleep_overshoot_ms,"
+		       "max_sleep_overshoot_ms,avg_draw_ms,avg_events_ms,missed_deadlines,idle_instructions\n");
+	}
+	catch(std::exception& e) {
+		DisplayErrorMsg("stats_config", e.what());
+	}
+
+}
+
+
+
+void bench_config(const std::string& arg)
+{
+	try {
+		std::cout << "setting benchmark mode...\n";
+		g_benchFrames = std::max(std::stoi(arg), 1);
+		std::cout << "benchmark frames: " << g_benchFrames << '\n';
+		std::cout << "done.\n";
+	}
+	catch(std::exception& e) {
+		DisplayErrorMsg("bench_config", e.what());
+	}
+
+}
+
+
+
+void present_config(const std::string& arg)
+{
+	if (arg != "ON" && arg != "OFF")
+	{
+		DisplayErrorMsg("present_config", "use -PRESENT ON or -PRESENT OFF");
+		return;
+	}
+
+	g_benchPresent = arg == "ON";
+}
+
+
+
+void trace_config(const std::string& arg)
+{
+	std::cout << "setting execution trace...\n";
+
+	if (!g_emulator.SetTraceEnabled(true))
+	{
+		DisplayErrorMsg("trace_config", utix::GetLastLogError());
+		return;
+	}
+
+	g_traceFile = arg;
+	g_emulator.GetTrace().SetCrashDump(arg.c_str(), g_emulator.GetCpuManager());
+	std::cout << "trace records: " << g_emulator.GetTrace().GetCapacity() << '\n';
+	std::cout << "trace file: " << g_traceFile << '\n';
+	std::cout << "done.\n";
+}
+
+
+
+void debug_config(const std::string& arg)
+{
+	if (arg != "ON")
+		return;
+
+	std::cout << "setting debugger...\n";
+
+	if (!g_emulator.SetDebuggerEnabled(true))
+	{
+		DisplayErrorMsg("debug_config", utix::GetLastLogError());
+		return;
+	}
+
+	// stop before the first instruction
+	g_emulator.GetDebugger().Break();
+	std::cout << "done.\n";
+}
+
+
+
+void idle_config(const std::string& arg)
+{
+	if (arg != "ON" && arg != "OFF")
+	{
+		DisplayErrorMsg("idle_config", "use -IDLE ON or -IDLE OFF");
+		return;
+	}
+
+	std::cout << "setting idle loop skipping: " << arg << '\n';
+	g_emulator.SetIdleSkipEnabled(arg == "ON");
+	std::cout << "done.\n";
+}
+
+
+
+void threaded_config(const std::string& arg)
+{
+	if (arg != "ON" && arg != "OFF")
+	{
+		DisplayErrorMsg("threaded_config", "use -THREADED ON or -THREADED OFF");
+		return;
+	}
+
+	std::cout << "threaded mode: " << arg << '\n';
+	g_threaded = arg == "ON";
+}
+
+
+
+void LogStats()
+{
+	const auto stats = g_emulator.GetStats();
+	printf("stats,%.3f,%llu,%.1f,%.1f,%llu,%llu,%.2f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%llu,%llu\n",
+	       stats.elapsedSecs, static_cast<unsigned long long>(stats.instructions),
+	       stats.instrPerSec, stats.targetInstrPerSec,
+	       static_cast<unsigned long long>(stats.framesPresented),
+	       static_cast<unsigned long long>(stats.framesSkipped),
+	       stats.framesPerSec, stats.targetFps, stats.avgFrameMs, stats.p99FrameMs,
+	       stats.avgSleepOvershootMs, stats.maxSleepOvershootMs, stats.avgDrawMs,
+	       stats.avgEventsMs, static_cast<unsigned long long>(stats.missedDeadlines),
+	       static_cast<unsigned long long>(stats.idleInstructions));
+	fflush(stdout);
+}
+
+
+
+
+void RunLoop()
+{
+	using StatsClock = std::chrono::steady_clock;
+	const auto statsInterval = std::chrono::seconds(g_statsInterval);
+	auto nextStats = StatsClock::now() + statsInterval;
+
+	while (!g_emulator.GetExitFlag())
+	{
+		g_emulator.UpdateSystems<RenderPlugin, InputPlugin>();
+		g_emulator.HaltForNextFlag();		
+		if (g_emulator.GetInstrFlag()) 			
+			g_emulator.ExecuteInstr();
+
+		if (g_emulator.GetDebuggerEnabled())
+		{
+			if (g_debugBreakRequest)
+			{
+				g_debugBreakRequest = 0;
+				g_emulator.GetDebugger().Break();
+			}
+
+			if (g_emulator.GetDebugger().IsPaused() && !RunDebugConsole(g_emulator))
+				g_emulator.SetExitFlag(true);
+		}
+
+		if (g_emulator.GetDrawFlag())
+		{
+			g_emulator.Draw<RenderPlugin>();
+
+			if (g_traceDumpRequest)
+			{
+				g_traceDumpRequest = 0;
+				if (g_emulator.GetTraceEnabled())
+					g_emulator.GetTrace().Dump(g_traceFile.c_str());
+			}
+
+			if (g_statsInterval && StatsClock::now() >= nextStats)
+			{
+				LogStats();
+				nextStats += statsInterval;
+			}
+		}
+	}
+}
+
+
+
+
+double get_cpu_secs();
+long get_peak_rss_kb();
+
+void RunBenchmark()
+{
+	using Clock = std::chrono::steady_clock;
+	RenderPlugin* const render = static_cast<RenderPlugin*>(g_emulator.GetRender());
+
+	// no input: keys are never polled, so a ROM
+	// stopped in FX0A stays there for the rest of the run.
+
+	if (!g_benchPresent)
+		render->HideWindow();
+
+	std::cout << "*** running " << g_benchFrames << " frames uncapped, presentation "
+	          << (g_benchPresent ? "ON" : "OFF") << " ***\n";
+
+	const double cpuBegin = get_cpu_secs();
+	const auto begin = Clock::now();
+
+	unsigned long long instructions = 0;
+	int frames = 0;
+	for (; frames < g_benchFrames && !g_emulator.GetExitFlag(); ++frames)
+	{
+		instructions += g_emulator.RunFrameUncapped();
+
+		if (g_benchPresent)
+		{
+			render->UpdateEvents();
+			g_emulator.Draw<RenderPlugin>();
+		}
+	}
+
+	const double wallSecs = std::chrono::duration<double>(Clock::now() - begin).count();
+	const double cpuSecs = get_cpu_secs() - cpuBegin;
+	const double secs = wallSecs > 0 ? wallSecs : 1e-9;
+
+
+	printf("\nframes:           %d%s\n", frames, frames < g_benchFrames ? " (the ROM exited early)" : "");
+	printf("instructions:     %llu\n", instructions);
+	printf("wall time:        %.3f s\n", wallSecs);
+	printf("host cpu time:    %.3f s\n", cpuSecs);
+	printf("instructions/sec: %.0f\n", instructions / secs);
+	printf("frames/sec:       %.1f\n", frames / secs);
+	printf("peak rss:         %ld KiB\n", get_peak_rss_kb());
+
+	// one line to grep and track across releases
+	printf("bench,present,frames,instructions,wall_s,cpu_s,instr_per_sec,frames_per_sec,peak_rss_kb\n");
+	printf("bench,%s,%d,%llu,%.6f,%.6f,%.0f,%.2f,%ld\n", g_benchPresent ? "on" : "off", frames,
+	       instructions, wallSecs, cpuSecs, instructions / secs, frames / secs, get_peak_rss_kb());
+	fflush(stdout);
+}
+
+
+
+
+bool RunThreaded()
+{
+	if (!g_emulator.StartWorker())
+	{
+		DisplayErrorMsg("RunThreaded", utix::GetLastLogError());
+		return false;
+	}
+
+	using StatsClock = std::chrono::steady_clock;
+	const auto statsInterval = std::chrono::seconds(g_statsInterval);
+	auto nextStats = StatsClock::now() + statsInterval;
+
+	// the stats snapshot is safe to read from here, the trace is not
+	while (g_emulator.UpdatePresentation())
+	{
+		if (g_statsInterval && StatsClock::now() >= nextStats)
+		{
+			LogStats();
+			nextStats += statsInterval;
+		}
+	}
+
+	g_emulator.StopWorker();
+
+	if (g_traceDumpRequest && g_emulator.GetTraceEnabled())
+		g_emulator.GetTrace().Dump(g_traceFile.c_str());
+
+	return true;
+}
+
+
+
+
+double get_cpu_secs()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+	       + ((usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+#elif defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	// 100 nanosecond intervals
+	const auto to_secs = [](const FILETIME& time) {
+		return ((static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+	};
+
+	return to_secs(kernel) + to_secs(user);
+#else
+	return 0;
+#endif
+}
+
+
+
+
+long get_peak_rss_kb()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	#ifdef __APPLE__
+	return usage.ru_maxrss / 1024; // bytes on mac
+	#else
+	return usage.ru_maxrss;
+	#endif
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+	return 0;
+#endif
+}
+
+
+
+
 utix::Color get_arg_rgb(const std::string& arg)
 {
 	const auto firstSeparator = arg.find('x');
@@ -494,18 +994,40 @@ void DisplayErrorMsg(const std::string& title, const std::string& errmsg)
 
 // signals
 
+void signals_sigabrt(const int signum)
+{
+	// most likely a failed assertion, keep the trace of what led to it
+	xchip::TraceBuffer::DumpCrash();
+	signal(signum, SIG_DFL);
+	raise(signum);
+}
+
+
 #if defined(__linux__) || defined(__APPLE__)
 void signals_sigint(const int signum)
 {
+	if (g_emulator.GetDebuggerEnabled())
+	{
+		g_debugBreakRequest = 1;
+		return;
+	}
+
 	std::cout << "Received sigint! signum: " << signum << "\nClosing Application!\n";
-	g_emulator.SetExitFlag(true);
+	g_emulator.RequestExit();
+}
+
+
+void signals_sigusr1(const int)
+{
+	// dumped by the main loop, between instructions
+	g_traceDumpRequest = 1;
 }
 
 #elif defined(_WIN32)
 bool _stdcall ctrl_handler(DWORD ctrlType)
 {
 	std::cout << "Received ctrlType: " << ctrlType << "\nClosing Application!\n";
-	g_emulator.SetExitFlag(true);
+	g_emulator.RequestExit();
 	return true;
 }
 #endif
@@ -23,6 +23,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #include <Utix/Log.h>
 #include <Utix/ScopeExit.h>
 #include <Utix/Assert.h>
+#include <Utix/BaseTraits.h>
 #include <XChip/Plugins/SDLPlugins/SdlAndroidInput.h>
 
 
@@ -72,7 +73,6 @@ void SdlAndroidInput::Dispose() noexcept
 {
 	m_resetClbk = nullptr;
 	m_escapeClbk = nullptr;
-	m_waitClbk = nullptr;
 	m_initialized = false;
 }
 
@@ -108,6 +108,14 @@ bool SdlAndroidInput::IsKeyPressed(const Key key) const noexcept
 }
 
 
+uint16_t SdlAndroidInput::GetKeyMask() const noexcept
+{
+	_SDLANDROIDINPUT_INITIALIZED_ASSERT_();
+	return m_direction == RIGHT ? (1 << ToSizeT(Key::KEY_6)) 
+	     : m_direction == LEFT ? (1 << ToSizeT(Key::KEY_4)) : 0;
+}
+
+
 
 bool SdlAndroidInput::UpdateKeys() noexcept
 {
@@ -133,24 +141,6 @@ bool SdlAndroidInput::UpdateKeys() noexcept
 
 
 
-Key SdlAndroidInput::WaitKeyPress() noexcept
-{
-	_SDLANDROIDINPUT_INITIALIZED_ASSERT_();
-	// TODO: implement
-	return Key::NO_KEY_PRESSED;
-}
-
-
-
-
-
-void SdlAndroidInput::SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept
-{
-	m_waitClbkArg = arg;
-	m_waitClbk = callback;
-}
-
-
 void SdlAndroidInput::SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept
 {
 	m_resetClbkArg = arg;
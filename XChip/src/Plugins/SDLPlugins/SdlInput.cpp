@@ -31,7 +31,7 @@ namespace xchip {
 
 using namespace utix;
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 extern "C" XCHIP_EXPORT void XCHIP_FreePlugin(const iPlugin*);
 #else
 #define XCHIP_FreePlugin nullptr
@@ -67,16 +67,6 @@ bool SdlInput::Initialize() noexcept
 	if (m_initialized)
 		this->Dispose();
 
-	// TODO: Initialize events
-
-	m_keyboardState = SDL_GetKeyboardState(NULL);
-
-	if (!m_keyboardState) 
-	{
-		LogError("Cannot get Keyboard State: %s", SDL_GetError());
-		return false;
-	}
-
 	if(m_keyPairs.empty())
 	{
 		bool ret = m_keyPairs.initialize({
@@ -92,6 +82,12 @@ bool SdlInput::Initialize() noexcept
 			return false;
 	}
 
+	// the keys are taken as SDL queues their events, whoever pumps
+	// them. keys already down now are seen at their next change.
+	m_keyMask = 0;
+	m_systemKeys = 0;
+	SDL_AddEventWatch(OnEvent, this);
+
 	m_initialized = true;
 	return true;
 }
@@ -100,10 +96,11 @@ bool SdlInput::Initialize() noexcept
 
 void SdlInput::Dispose() noexcept
 {
-	m_keyboardState = nullptr;
+	SDL_DelEventWatch(OnEvent, this);
 	m_resetClbk = nullptr;
 	m_escapeClbk = nullptr;
-	m_waitClbk = nullptr;
+	m_keyMask = 0;
+	m_systemKeys = 0;
 	m_initialized = false;
 }
 
@@ -134,7 +131,15 @@ bool SdlInput::IsKeyPressed(const Key key) const noexcept
 {
 	_SDLINPUT_INITIALIZED_ASSERT_();
 
-	return m_keyboardState[m_keyPairs[ToSizeT(key)].sdlKey] == SDL_TRUE;
+	return ((m_keyMask >> ToSizeT(key)) & 0x1) != 0;
+}
+
+
+uint16_t SdlInput::GetKeyMask() const noexcept
+{
+	_SDLINPUT_INITIALIZED_ASSERT_();
+
+	return m_keyMask;
 }
 
 
@@ -143,10 +148,12 @@ bool SdlInput::UpdateKeys() noexcept
 {
 	_SDLINPUT_INITIALIZED_ASSERT_();
 
-	SDL_PumpEvents();
-	m_keyboardState = SDL_GetKeyboardState(NULL);
+	// the keypad mask is kept by OnEvent, here only
+	// the system keys seen since the last update are run
+	const auto systemKeys = m_systemKeys;
+	m_systemKeys = 0;
 
-	if (m_keyboardState[SDL_SCANCODE_RETURN])
+	if (systemKeys & SYS_RESET)
 	{
 		if (m_resetClbk) 
 			m_resetClbk(m_resetClbkArg);
@@ -155,7 +162,7 @@ bool SdlInput::UpdateKeys() noexcept
 	}
 
 
-	else if (m_keyboardState[SDL_SCANCODE_ESCAPE])
+	else if (systemKeys & SYS_ESCAPE)
 	{
 		if (m_escapeClbk) 
 			m_escapeClbk(m_escapeClbkArg);
@@ -171,42 +178,42 @@ bool SdlInput::UpdateKeys() noexcept
 
 
 
-
-Key SdlInput::WaitKeyPress() noexcept
+int SDLCALL SdlInput::OnEvent(void* sdlinput, SDL_Event* event)
 {
-	_SDLINPUT_INITIALIZED_ASSERT_();
-	
-	if (m_waitClbk != nullptr)
+	if (event->type != SDL_KEYDOWN && event->type != SDL_KEYUP)
+		return 0;
+
+	auto* const input = static_cast<SdlInput*>(sdlinput);
+	const auto scancode = event->key.keysym.scancode;
+	const bool down = event->type == SDL_KEYDOWN;
+
+	if (scancode == SDL_SCANCODE_RETURN || scancode == SDL_SCANCODE_ESCAPE)
 	{
-		const auto begin = m_keyPairs.cbegin();
-		const auto end = m_keyPairs.cend();
-		
-		while (m_waitClbk(m_waitClbkArg))
-		{
-			if (!this->UpdateKeys())
-			{
-				for (auto itr = begin; itr != end; ++itr)
-				{
-					if (m_keyboardState[itr->sdlKey])
-						return itr->chip8Key;
-				}
-			}
-		}
+		if (down && !event->key.repeat)
+			input->m_systemKeys |= (scancode == SDL_SCANCODE_RETURN) ? SYS_RESET : SYS_ESCAPE;
 
+		return 0;
 	}
 
-	return Key::NO_KEY_PRESSED;
-}
+	for (const auto& pair : input->m_keyPairs)
+	{
+		if (pair.sdlKey == scancode)
+		{
+			const auto bit = static_cast<uint16_t>(1 << ToSizeT(pair.chip8Key));
+			if (down)
+				input->m_keyMask |= bit;
+			else
+				input->m_keyMask &= ~bit;
 
+			break;
+		}
+	}
 
+	return 0;
+}
 
 
 
-void SdlInput::SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept
-{
-	m_waitClbkArg = arg;
-	m_waitClbk = callback;
-}
 
 
 void SdlInput::SetResetKeyCallback(const void* arg, ResetKeyCallback callback) noexcept
@@ -234,7 +241,7 @@ void SdlInput::SetEscapeKeyCallback(const void* arg, EscapeKeyCallback callback)
 
 
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 extern "C" {
 
 
@@ -267,7 +274,7 @@ XCHIP_EXPORT void XCHIP_FreePlugin(const iPlugin* plugin)
 
 }
 
-#endif // __ANDROID__
+#endif // XCHIP_STATIC_PLUGINS
 
 
 
@@ -33,7 +33,7 @@ namespace xchip {
 using namespace utix;
 using namespace utix::literals;
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 extern "C" XCHIP_EXPORT void XCHIP_FreePlugin(const iPlugin*);
 #else
 #define XCHIP_FreePlugin nullptr
@@ -77,8 +77,6 @@ bool SdlRender::Initialize(const Vec2i& winSize, const Vec2i& res) noexcept
 		}
 	});
 
-	m_pitch = res.x * sizeof(uint32_t);
-
 	m_window = SDL_CreateWindow("Chip8 - SdlRender", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 
                                  winSize.x, winSize.y, 
                                  SDL_WINDOW_RESIZABLE | SDL_WINDOW_INPUT_FOCUS | SDL_WINDOW_MOUSE_FOCUS);
@@ -92,10 +90,12 @@ bool SdlRender::Initialize(const Vec2i& winSize, const Vec2i& res) noexcept
 		return false;
 
 
-	if(!CreateTexture(res.x, res.y))
+	if(!SetResolution(res))
 		return false;
 
-	SDL_SetRenderDrawColor(m_rend, 0, 0, 0, 0xff);
+	// not initialized yet, GetPaletteColor() would assert
+	const uint32_t bkg = m_palette[0];
+	SDL_SetRenderDrawColor(m_rend, uint8_t(bkg >> 24), uint8_t(bkg >> 16), uint8_t(bkg >> 8), 0xff);
 	SDL_RenderClear(m_rend);
 	SDL_RenderPresent(m_rend);
 	m_initialized = true;
@@ -105,10 +105,18 @@ bool SdlRender::Initialize(const Vec2i& winSize, const Vec2i& res) noexcept
 
 void SdlRender::Dispose() noexcept
 {
-	SDL_DestroyTexture(m_texture);
+	for (auto& texture : m_textures)
+	{
+		SDL_DestroyTexture(texture);
+		texture = nullptr;
+	}
+
 	SDL_DestroyRenderer(m_rend);
 	SDL_DestroyWindow(m_window);
 	SDL_QuitSubSystem( SDL_INIT_VIDEO );
+	m_res = {0, 0};
+	m_texture = nullptr;
+	m_rend = nullptr;
 	m_window = nullptr;
 	m_buffer = nullptr;
 	m_closeClbk = nullptr;
@@ -142,7 +150,7 @@ PluginDeleter SdlRender::GetPluginDeleter() const noexcept
 
 
 
-const uint32_t* SdlRender::GetBuffer() const noexcept 
+const uint8_t* SdlRender::GetBuffer() const noexcept 
 { 
 	return m_buffer; 
 }
@@ -156,25 +164,23 @@ const char* SdlRender::GetWindowName() const noexcept
 
 Color SdlRender::GetDrawColor() const noexcept
 {
-	_SDLRENDER_INITIALIZED_ASSERT_();
+	return GetPaletteColor(1);
+}
 
-	uint8_t r, g, b;
-	SDL_GetTextureColorMod(m_texture, &r, &g, &b);
-	return {r, g, b};
 
+Color SdlRender::GetBackgroundColor() const noexcept
+{
+	return GetPaletteColor(0);
 }
 
 
-Color SdlRender::GetBackgroundColor() const noexcept
+Color SdlRender::GetPaletteColor(const uint8_t index) const noexcept
 {
 	_SDLRENDER_INITIALIZED_ASSERT_();
-	
-	uint8_t r, g, b;	
-	if(SDL_GetRenderDrawColor(m_rend, &r, &g, &b, nullptr) == 0)
-		return {r, g, b};
-	
-	LogError("Could not get render draw color: %s", SDL_GetError());
-	return {0, 0, 0};
+	ASSERT_MSG(index < PALETTE_SIZE, "palette index overflow");
+
+	const uint32_t color = m_palette[index];
+	return { uint8_t(color >> 24), uint8_t(color >> 16), uint8_t(color >> 8) };
 }
 
 
@@ -185,12 +191,7 @@ Vec2i SdlRender::GetResolution() const noexcept
 {
 	_SDLRENDER_INITIALIZED_ASSERT_();
 
-	int x, y;
-	if( SDL_QueryTexture(m_texture, nullptr, nullptr, &x, &y) == 0)
-		return {x, y};
-	
-	LogError("Failed to get SDL_Texture resolution: %s", SDL_GetError());
-	return {0, 0};
+	return m_res;
 }
 
 
@@ -249,7 +250,7 @@ bool SdlRender::UpdateEvents() noexcept
 
 
 
-void SdlRender::SetBuffer(const uint32_t* gfx) noexcept 
+void SdlRender::SetBuffer(const uint8_t* gfx) noexcept 
 { 
 	m_buffer = gfx;
 }
@@ -267,19 +268,45 @@ void SdlRender::SetWindowName(const char* name) noexcept
 
 
 
+// a reserved resolution is only a texture swap
 bool SdlRender::SetResolution(const Vec2i& res) noexcept
 {
-	_SDLRENDER_INITIALIZED_ASSERT_();
+	int index = FindTexture(res);
 
+	if (index < 0)
+	{
+		if (!ReserveResolution(res))
+			return false;
+
+		index = FindTexture(res);
+	}
+
+	m_texture = m_textures[index];
+	m_res = res;
 	m_pitch = res.x * sizeof(uint32_t);
-	
-	const auto currentColor = this->GetDrawColor();
+	return true;
+}
 
-	if(!CreateTexture(res.x, res.y))
-		return false;
 
-	this->SetDrawColor(currentColor);
 
+
+bool SdlRender::ReserveResolution(const Vec2i& res) noexcept
+{
+	ASSERT_MSG(m_rend != nullptr, "null SDL_Renderer");
+
+	if (FindTexture(res) >= 0)
+		return true;
+
+	// the texture in use is never the one replaced
+	const int index = (m_texture != nullptr && m_texture == m_textures[0]) ? 1 : 0;
+	SDL_Texture* const newTexture = CreateTexture(res);
+
+	if (!newTexture)
+		return false;
+
+	SDL_DestroyTexture(m_textures[index]);
+	m_textures[index] = newTexture;
+	m_texturesRes[index] = res;
 	return true;
 }
 
@@ -307,15 +334,7 @@ void SdlRender::SetWindowPosition(const Vec2i& pos) noexcept
 
 bool SdlRender::SetDrawColor(const Color& color) noexcept
 {
-	_SDLRENDER_INITIALIZED_ASSERT_();
-	
-	if(SDL_SetTextureColorMod(m_texture, color.r, color.g, color.b) != 0)
-	{
-		LogError("Failed to set texture draw color: %s", + SDL_GetError());
-		return false;
-	}
-
-	return true;
+	return SetPaletteColor(1, color);
 }
 
 
@@ -324,15 +343,32 @@ bool SdlRender::SetDrawColor(const Color& color) noexcept
 
 
 bool SdlRender::SetBackgroundColor(const Color& color) noexcept
+{
+	return SetPaletteColor(0, color);
+}
+
+
+
+
+// the background color also clears the window around the texture
+bool SdlRender::SetPaletteColor(const uint8_t index, const Color& color) noexcept
 {
 	_SDLRENDER_INITIALIZED_ASSERT_();
 
-	if(SDL_SetRenderDrawColor(m_rend, color.r, color.g, color.b, 0xff))
+	if (index >= PALETTE_SIZE)
+	{
+		LogError("Palette index %u out of range", static_cast<unsigned>(index));
+		return false;
+	}
+
+	if (index == 0 && SDL_SetRenderDrawColor(m_rend, color.r, color.g, color.b, 0xff))
 	{
 		LogError("Could not set render draw color: %s", SDL_GetError());
 		return false;
 	}
 
+	m_palette[index] = (uint32_t(color.r) << 24) | (uint32_t(color.g) << 16) 
+	                    | (uint32_t(color.b) << 8) | 0xff;
 	return true;
 }
 
@@ -422,9 +458,15 @@ void SdlRender::DrawBuffer() noexcept
 		return;
 	}
 
-	const auto res = GetResolution();
-
-	memcpy(pixels, m_buffer, res.y * res.x * sizeof(uint32_t));
+	// the texture rows may be padded, pitch is in bytes
+	const auto res = m_res;
+	const uint8_t* indexes = m_buffer;
+	for (int y = 0; y < res.y; ++y, pixels += m_pitch)
+	{
+		uint32_t* const line = reinterpret_cast<uint32_t*>(pixels);
+		for (int x = 0; x < res.x; ++x)
+			line[x] = m_palette[*indexes++ & (PALETTE_SIZE - 1)];
+	}
 
 	SDL_UnlockTexture(m_texture);
 	
@@ -471,27 +513,40 @@ void SdlRender::SetWinResizeCallback(const void* arg, WinResizeCallback callback
 
 
 
-bool SdlRender::CreateTexture(const int w, const int h)
+SDL_Texture* SdlRender::CreateTexture(const Vec2i& res)
 {
 	SDL_Texture* newTexture = SDL_CreateTexture(m_rend,
 		SDL_PIXELFORMAT_RGBA8888,
 		SDL_TEXTUREACCESS_STREAMING,
-		w, h);
+		res.x, res.y);
 
 	if (!newTexture) {
 		fprintf(stderr, "failed to create texture: %s\n", SDL_GetError());
-		return false;
+		return nullptr;
 	}
 
-	if (SDL_SetTextureBlendMode(newTexture, SDL_BLENDMODE_BLEND) != 0) {
+	// the palette colors are opaque, the texture is copied over
+	if (SDL_SetTextureBlendMode(newTexture, SDL_BLENDMODE_NONE) != 0) {
 		fprintf(stderr, "failed to set blend mode: %s\n", SDL_GetError());
 		SDL_DestroyTexture(newTexture);
-		return false;
+		return nullptr;
 	}
 
-	SDL_DestroyTexture(m_texture);
-	m_texture = newTexture;
-	return true;
+	return newTexture;
+}
+
+
+
+
+int SdlRender::FindTexture(const Vec2i& res) const
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (m_textures[i] != nullptr && m_texturesRes[i] == res)
+			return i;
+	}
+
+	return -1;
 }
 
 
@@ -504,7 +559,7 @@ bool SdlRender::CreateTexture(const int w, const int h)
 
 
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 extern "C" XCHIP_EXPORT iPlugin* XCHIP_LoadPlugin()
 {
 	return new(std::nothrow) SdlRender();
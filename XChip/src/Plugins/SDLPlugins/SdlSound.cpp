@@ -23,6 +23,7 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
 #include <Utix/Log.h>
 #include <Utix/Timer.h>
@@ -38,7 +39,7 @@ namespace xchip {
 
 using namespace utix;
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 extern "C" XCHIP_EXPORT void XCHIP_FreePlugin(const iPlugin*);
 #else
 #define XCHIP_FreePlugin nullptr
@@ -51,17 +52,19 @@ extern "C" XCHIP_EXPORT void XCHIP_FreePlugin(const iPlugin*);
 constexpr const char* const SdlSound::PLUGIN_NAME;
 constexpr const char* const SdlSound::PLUGIN_VER;
 constexpr float SdlSound::DEFAULT_FREQ;
+constexpr int SdlSound::RAMP_SAMPLES;
+constexpr size_t SdlSound::WAVETABLE_SIZE;
+constexpr int SdlSound::WAVETABLE_SHIFT;
+constexpr size_t SdlSound::PATTERN_BITS;
+constexpr int SdlSound::PATTERN_SHIFT;
 
 
 
 
 
 inline float SdlSound::GetCurFreq() const { return m_curFreq * m_specs[HAVE].freq; }
-inline float SdlSound::GetPlayFreq() const { return m_playFreq * m_specs[HAVE].freq; }
 inline void SdlSound::SetCycleTime(const float hz) { m_cycleTime = m_specs[HAVE].freq / hz; }
 inline void SdlSound::SetCurFreq(const float hz) { m_curFreq = hz / m_specs[HAVE].freq; }
-inline void SdlSound::SetPlayFreq(const float hz) { m_playFreq = hz / m_specs[HAVE].freq; }
-inline void SdlSound::SetLenght(const unsigned int len) { m_len = m_cycleTime * len; }
 
 
 
@@ -70,6 +73,10 @@ inline void SdlSound::SetLenght(const unsigned int len) { m_len = m_cycleTime *
 
 
 SdlSound::SdlSound() noexcept
+	: m_write(0),
+	m_read(0),
+	m_flush(false),
+	m_playing(false)
 {
 	Log("Creating SdlSound object...");
 }
@@ -105,13 +112,23 @@ bool SdlSound::Initialize() noexcept
 	if( !OpenAudioDevice() )
 		return false;
 
-	m_len = 0.f;
-	m_pos = 0u;
+	// one sine cycle, the only libm calls the tone makes
+	constexpr auto _2pi = 2 * M_PI;
+	for (size_t i = 0; i < WAVETABLE_SIZE; ++i)
+		m_wavetable[i] = static_cast<Sint16>(32767 * sin(_2pi * i / WAVETABLE_SIZE));
+
+	m_tickRemain = 0.f;
+	m_phase = 0u;
+	m_gain = 0;
 	m_amplitude = 16000;
+	m_table = m_wavetable;
+	m_tableShift = WAVETABLE_SHIFT;
 	m_cycleTime = m_specs[HAVE].freq / 60.f;
 	this->SetCurFreq(DEFAULT_FREQ);
 
+	// the device always runs, silence is what the ring has when there is no tone
 	m_initialized = true;
+	SDL_PauseAudioDevice(m_dev, 0);
 	return true;
 }
 
@@ -166,7 +183,7 @@ float SdlSound::GetCountdownFreq() const noexcept
 bool SdlSound::IsPlaying() const  noexcept
 {
 	_SDLSOUND_INITIALIZED_ASSERT_();
-	return SDL_GetAudioDeviceStatus(m_dev) == SDL_AUDIO_PLAYING;
+	return m_playing.load(std::memory_order_relaxed);
 }
 
 
@@ -185,24 +202,109 @@ void SdlSound::SetSoundFreq(const float hz) noexcept
 
 
 
-void SdlSound::Play(const uint8_t soundTimer) noexcept
+void SdlSound::Tick(const uint8_t soundTimer) noexcept
 {
 	_SDLSOUND_INITIALIZED_ASSERT_();
-	if (!this->IsPlaying()) 
+
+	// m_cycleTime samples per tick, the fractions carried to the next
+	m_tickRemain += m_cycleTime;
+	const auto samples = static_cast<size_t>(m_tickRemain);
+	m_tickRemain -= samples;
+
+	m_playing.store(soundTimer != 0, std::memory_order_relaxed);
+
+	// ahead of the device, as in turbo or bursts: the tick is dropped
+	// instead of growing the latency.
+	const auto write = m_write.load(std::memory_order_relaxed);
+	const auto queued = write - m_read.load(std::memory_order_acquire);
+	if (queued > m_maxQueued || queued + samples > m_ringMask + 1)
+		return;
+
+	// the envelope is worked out per block: a linear attack or release 
+	// over the first RAMP_SAMPLES when the tone toggles, then flat.
+	m_phaseStep = m_table == m_wavetable ? static_cast<uint32_t>(m_curFreq * 4294967296.0) : m_patternStep;
+	const int32_t target = soundTimer ? (m_amplitude << 16) : 0;
+	const size_t ramp = m_gain != target ? std::min<size_t>(RAMP_SAMPLES, samples) : 0;
+
+	if (ramp)
 	{
-		SetPlayFreq(GetCurFreq() + 2 * soundTimer);
-		SetLenght(soundTimer);
+		this->RenderBlock(write, ramp, (target - m_gain) / static_cast<int32_t>(ramp));
+		m_gain = target;
 	}
-	
-	else
+
+	this->RenderBlock(write + ramp, samples - ramp, 0);
+	m_write.store(write + samples, std::memory_order_release);
+}
+
+
+
+
+// fills count samples from the ring index write on. The phase never 
+// resets, silence included, so the tone has no edges of its own.
+void SdlSound::RenderBlock(size_t write, size_t count, const int32_t gainStep)
+{
+	while (count > 0)
 	{
-		SDL_LockAudioDevice(m_dev);
-		SetPlayFreq(GetCurFreq() + 2 * soundTimer);
-		SetLenght(soundTimer);
-		SDL_UnlockAudioDevice(m_dev);
+		// contiguous spans, no masking in the loop
+		const auto index = write & m_ringMask;
+		const auto span = std::min(count, m_ringMask + 1 - index);
+		Sint16* const dest = m_ring + index;
+		const auto phaseStep = m_phaseStep;
+		const Sint16* const table = m_table;
+		const int shift = m_tableShift;
+		auto phase = m_phase;
+		auto gain = m_gain;
+
+		if (gain == 0 && gainStep == 0)
+		{
+			memset(dest, 0, sizeof(Sint16) * span);
+			phase += static_cast<uint32_t>(phaseStep * span);
+		}
+		else
+		{
+			for (size_t i = 0; i < span; ++i)
+			{
+				dest[i] = static_cast<Sint16>((table[phase >> shift] * (gain >> 16)) >> 15);
+				phase += phaseStep;
+				gain += gainStep;
+			}
+		}
+
+		m_phase = phase;
+		m_gain = gain;
+		write += span;
+		count -= span;
 	}
+}
 
-	SDL_PauseAudioDevice(m_dev, 0);
+
+
+
+
+// the pattern is expanded to samples here, once, and then played as
+// a 128 entries wavetable: the phase accumulator is the resampler.
+void SdlSound::SetPattern(const uint8_t* const pattern, const uint8_t pitch) noexcept
+{
+	_SDLSOUND_INITIALIZED_ASSERT_();
+
+	if (!pattern)
+	{
+		m_table = m_wavetable;
+		m_tableShift = WAVETABLE_SHIFT;
+		return;
+	}
+
+	for (size_t i = 0; i < PATTERN_BITS; ++i)
+	{
+		const int bit = (pattern[i / 8] >> (7 - (i % 8))) & 1;
+		m_pattern[i] = static_cast<Sint16>(bit * 65534 - 32767);
+	}
+
+	// a full phase cycle is the whole pattern
+	const double rate = 4000.0 * pow(2.0, (pitch - 64) / 48.0);
+	m_patternStep = static_cast<uint32_t>((rate / m_specs[HAVE].freq) * (1u << PATTERN_SHIFT));
+	m_table = m_pattern;
+	m_tableShift = PATTERN_SHIFT;
 }
 
 
@@ -212,12 +314,9 @@ void SdlSound::Play(const uint8_t soundTimer) noexcept
 void SdlSound::Stop() noexcept
 {
  	_SDLSOUND_INITIALIZED_ASSERT_();
-	if (this->IsPlaying())
-	{
-		SDL_LockAudioDevice(m_dev);
-		m_len = 0;
-		SDL_UnlockAudioDevice(m_dev);
-	}
+	// the queued ticks belong to the audio thread, it drops them
+	m_playing.store(false, std::memory_order_relaxed);
+	m_flush.store(true, std::memory_order_release);
 }
 
 
@@ -254,7 +353,7 @@ bool SdlSound::OpenAudioDevice()
 	want.format = AUDIO_S16;
 	want.channels = 1;
 	want.samples = 1024;
-	want.callback = SdlSound::audio_callback<Sint16>;
+	want.callback = SdlSound::audio_callback;
 	want.userdata = this;
 
 	m_dev = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
@@ -268,6 +367,24 @@ bool SdlSound::OpenAudioDevice()
 		return false;
 	}
 
+	// up to two device buffers queued, in a power of two ring
+	// with room for a tick more, ~100ms.
+	m_maxQueued = static_cast<size_t>(have.samples) * 2;
+	size_t ringSize = 1;
+	while (ringSize < m_maxQueued + have.freq / 10)
+		ringSize <<= 1;
+
+	m_ring = static_cast<Sint16*>( malloc( sizeof(Sint16) * ringSize ) );
+
+	if (!m_ring) {
+		LogError("Could not allocate memory for SdlSound ring");
+		return false;
+	}
+
+	m_ringMask = ringSize - 1;
+	m_write.store(0, std::memory_order_relaxed);
+	m_read.store(0, std::memory_order_relaxed);
+	m_flush.store(false, std::memory_order_relaxed);
 	return true;
 }
 
@@ -283,6 +400,11 @@ void SdlSound::CloseAudioDevice()
 		SDL_CloseAudioDevice(m_dev);
 		m_dev = 0;
 	}
+
+	if(m_ring) {
+		free(m_ring);
+		m_ring = nullptr;
+	}
 }
 
 
@@ -299,46 +421,34 @@ void SdlSound::CloseAudioDevice()
 
 
 
-template<class T>
+// the consumer side: it never waits on the emulation, and only 
+// takes whole buffers, an underrun plays silence while the ring refills.
 void SdlSound::audio_callback(void* userdata, uint8_t* const stream, const int len) noexcept
 {
 	auto *const _this = reinterpret_cast<SdlSound*>(userdata);
-	auto *const buff = reinterpret_cast<T*>(stream);
-	const size_t bufflen = len / sizeof(T);
+	auto *const buff = reinterpret_cast<Sint16*>(stream);
+	const size_t bufflen = len / sizeof(Sint16);
 
+	auto read = _this->m_read.load(std::memory_order_relaxed);
+	const auto write = _this->m_write.load(std::memory_order_acquire);
 
-	constexpr auto _2pi = static_cast<float>(2 * M_PI);
-	const auto ampl = _this->m_amplitude;
-	const auto freq = _this->m_playFreq;
-	auto pos = _this->m_pos;
+	if (_this->m_flush.exchange(false, std::memory_order_acquire))
+		read = write;
 
-
-	if (_this->m_len > 0)
+	if (write - read < bufflen)
 	{
-		for (size_t i = 0; i < bufflen; ++i, ++pos)
-			buff[i] = static_cast<T>(ampl * sin(_2pi * freq * pos));
-
-		_this->m_pos = pos;
-		_this->m_len -= bufflen;
+		memset(buff, 0, len);
 	}
-
 	else
-	{	// need a better workaround to stop clipping.
-		auto downAmpl = ampl;
-		for (size_t i = 0; i < bufflen; ++i, ++pos)
-		{
-			buff[i] = static_cast<T>(downAmpl * sin(_2pi * freq * pos));
-			if (downAmpl > 100)
-				downAmpl -= 60;
-		}
+	{
+		const auto mask = _this->m_ringMask;
+		for (size_t i = 0; i < bufflen; ++i)
+			buff[i] = _this->m_ring[(read + i) & mask];
 
-		// pause the device from the callback function.
-		// is this ok ?
-		_this->m_pos = 0;
-		SDL_PauseAudioDevice(_this->m_dev, 1);
-		
+		read += bufflen;
 	}
 
+	_this->m_read.store(read, std::memory_order_release);
 }
 
 
@@ -356,7 +466,7 @@ void SdlSound::audio_callback(void* userdata, uint8_t* const stream, const int l
 
 
 
-#ifndef __ANDROID__
+#ifndef XCHIP_STATIC_PLUGINS
 // export
 
 extern "C" XCHIP_EXPORT iPlugin* XCHIP_LoadPlugin()
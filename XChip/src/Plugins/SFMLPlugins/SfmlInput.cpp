@@ -86,12 +86,11 @@ bool SfmlInput::Initialize() noexcept
 
 void SfmlInput::Dispose() noexcept 
 {
-	m_waitArg = nullptr;
 	m_resetArg = nullptr;
 	m_escapeArg = nullptr;
-	m_waitCallback = nullptr;
 	m_resetCallback = nullptr;
 	m_escapeCallback = nullptr;
+	m_keyMask = 0;
 	m_initialized = false;		
 }
 
@@ -128,10 +127,15 @@ PluginDeleter SfmlInput::GetPluginDeleter() const noexcept
 bool SfmlInput::IsKeyPressed(const Key key) const noexcept
 {
 	_SFMLINPUT_INITIALIZED_ASSERT_();
-	if( sf::Keyboard::isKeyPressed(m_keyPairs[ToSizeT(key)].sfKey) )
-		return true;
+	return ((m_keyMask >> ToSizeT(key)) & 0x1) != 0;
+}
+
+
 
-	return false;
+uint16_t SfmlInput::GetKeyMask() const noexcept
+{
+	_SFMLINPUT_INITIALIZED_ASSERT_();
+	return m_keyMask;
 }
 
 
@@ -149,36 +153,14 @@ bool SfmlInput::UpdateKeys() noexcept
 		return false;
 	}
 
-	return true;
-}
-
-
-Key SfmlInput::WaitKeyPress() noexcept
-{
-	_SFMLINPUT_INITIALIZED_ASSERT_();
-
-	if( m_waitCallback )
-	{
-		while(m_waitCallback(m_waitArg))
-		{
-			if(UpdateKeys())
-			{
-				for(const auto& kpair : m_keyPairs)
-					if( sf::Keyboard::isKeyPressed(kpair.sfKey) )
-						return kpair.chip8Key;
-			}
-		}
-	}
-
-	return Key::NO_KEY_PRESSED;
-}
-
-
+	// sampled once per update, the keypad is read from the mask
+	uint16_t mask = 0;
+	for(const auto& kpair : m_keyPairs)
+		if( sf::Keyboard::isKeyPressed(kpair.sfKey) )
+			mask |= 1 << ToSizeT(kpair.chip8Key);
 
-void SfmlInput::SetWaitKeyCallback(const void* arg, WaitKeyCallback callback) noexcept
-{
-	m_waitCallback = callback;
-	m_waitArg = arg;
+	m_keyMask = mask;
+	return true;
 }
 
 
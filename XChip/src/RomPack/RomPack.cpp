@@ -0,0 +1,278 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <dirent.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <Utix/Log.h>
+#include <Utix/ScopeExit.h>
+
+#include <XChip/Core/MappedFile.h>
+#include <XChip/Core/RomLibrary.h>
+
+
+
+/*******************************************************************************************
+ *	XChipRomPack <roms directory> <output library>
+ *	packs the ROMs of the directory into a RomLibrary. ROMs are the files
+ *	with a .ch8 .sc8 or .xo8 extension, or with no extension at all.
+ *	duplicated ROMs (same content hash) are stored once.
+ *******************************************************************************************/
+
+
+
+
+namespace {
+using xchip::RomLibrary;
+
+struct PackedRom
+{
+	RomLibrary::Entry entry;
+	std::vector<uint8_t> data;
+};
+
+std::vector<std::string> ListDirectory(const std::string& dirPath);
+std::string GetExtension(const std::string& fileName);
+uint32_t GuessVariant(const std::string& fileName, const std::vector<uint8_t>& data);
+void WriteLibrary(const char* fileName, std::vector<PackedRom>& roms);
+}
+
+
+
+
+int main(int argc, char** argv)
+{
+	using namespace utix;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <roms directory> <output library>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	try {
+		std::vector<PackedRom> roms;
+		const std::string dirPath = argv[1];
+
+		for (const auto& fileName : ListDirectory(dirPath))
+		{
+			const auto ext = GetExtension(fileName);
+			if (!ext.empty() && ext != "ch8" && ext != "sc8" && ext != "xo8")
+				continue;
+
+			if (fileName.size() >= RomLibrary::MAX_NAME_SIZE)
+			{
+				LogError("Skipping \'%s\': name is too long", fileName.c_str());
+				continue;
+			}
+
+			xchip::MappedFile file;
+			if (file.Initialize((dirPath + '/' + fileName).c_str()) != xchip::LoadStatus::OK)
+			{
+				LogError("Skipping \'%s\': %s", fileName.c_str(), GetLastLogError().c_str());
+				continue;
+			}
+
+			PackedRom rom;
+			memset(&rom.entry, 0, sizeof(rom.entry));
+			rom.data.assign(file.GetData(), file.GetData() + file.GetSize());
+			rom.entry.hash = RomLibrary::ComputeHash(file.GetData(), file.GetSize());
+			rom.entry.size = static_cast<uint32_t>(file.GetSize());
+			rom.entry.variant = GuessVariant(fileName, rom.data);
+			strcpy(rom.entry.name, fileName.c_str());
+			roms.push_back(std::move(rom));
+		}
+
+
+		// lookups by hash are binary searches
+		std::sort(roms.begin(), roms.end(), [](const PackedRom& a, const PackedRom& b) {
+			return a.entry.hash < b.entry.hash;
+		});
+
+		const auto dup = std::unique(roms.begin(), roms.end(), [](const PackedRom& a, const PackedRom& b) {
+			return a.entry.hash == b.entry.hash;
+		});
+
+		if (dup != roms.end())
+		{
+			Log("Skipping %zu duplicated ROMs", static_cast<size_t>(roms.end() - dup));
+			roms.erase(dup, roms.end());
+		}
+
+		if (roms.empty())
+			throw std::runtime_error("No ROMs found in " + dirPath);
+
+		WriteLibrary(argv[2], roms);
+		Log("Packed %zu ROMs into %s", roms.size(), argv[2]);
+	}
+	catch (std::exception& err) {
+		LogError("%s", err.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+
+
+
+// local functions definitions
+namespace {
+
+
+std::vector<std::string> ListDirectory(const std::string& dirPath)
+{
+	std::vector<std::string> files;
+
+#if defined(__linux__) || defined(__APPLE__)
+
+	DIR* const dir = opendir(dirPath.c_str());
+	if (!dir)
+		throw std::runtime_error("Could not open directory " + dirPath);
+
+	const auto dirClose = utix::MakeScopeExit([dir]() noexcept { closedir(dir); });
+
+	while (const dirent* const e = readdir(dir))
+	{
+		struct stat st;
+		const auto path = dirPath + '/' + e->d_name;
+		if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			files.emplace_back(e->d_name);
+	}
+
+#elif defined(_WIN32)
+
+	WIN32_FIND_DATAA data;
+	const HANDLE find = FindFirstFileA((dirPath + "\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Could not open directory " + dirPath);
+
+	const auto findClose = utix::MakeScopeExit([find]() noexcept { FindClose(find); });
+
+	do {
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			files.emplace_back(data.cFileName);
+	} while (FindNextFileA(find, &data));
+
+#endif
+
+	// keep the output stable between runs
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+
+
+
+std::string GetExtension(const std::string& fileName)
+{
+	const auto dot = fileName.rfind('.');
+	if (dot == std::string::npos || dot == 0)
+		return std::string();
+
+	std::string ext = fileName.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+
+
+
+uint32_t GuessVariant(const std::string& fileName, const std::vector<uint8_t>& data)
+{
+	const auto ext = GetExtension(fileName);
+	if (ext == "sc8")
+		return RomLibrary::VARIANT_SCHIP;
+	else if (ext == "xo8")
+		return RomLibrary::VARIANT_XOCHIP;
+
+
+	// look for SuperChip opcodes. Data bytes may look like code, so this
+	// is only a hint. XO-Chip opcodes collide with common sprite data too
+	// often to be guessed this way, those ROMs need the .xo8 extension.
+	for (size_t i = 0; (i + 1) < data.size(); i += 2)
+	{
+		const unsigned opcode = (data[i] << 8) | data[i + 1];
+		const unsigned nn = opcode & 0x00FF;
+
+		if ((opcode >= 0x00FB && opcode <= 0x00FF) || (opcode & 0xFFF0) == 0x00C0 
+			|| ((opcode & 0xF000) == 0xF000 && (nn == 0x30 || nn == 0x75 || nn == 0x85)))
+		{
+			return RomLibrary::VARIANT_SCHIP;
+		}
+	}
+
+	return RomLibrary::VARIANT_CHIP8;
+}
+
+
+
+
+void WriteLibrary(const char* fileName, std::vector<PackedRom>& roms)
+{
+	RomLibrary::Header header;
+	memcpy(header.magic, RomLibrary::MAGIC, sizeof(header.magic));
+	header.version = RomLibrary::VERSION;
+	header.count = static_cast<uint32_t>(roms.size());
+	header.indexOffset = sizeof(RomLibrary::Header);
+	header.dataOffset = header.indexOffset + (roms.size() * sizeof(RomLibrary::Entry));
+
+	uint64_t offset = 0;
+	for (auto& rom : roms)
+	{
+		rom.entry.offset = offset;
+		offset += rom.entry.size;
+	}
+
+
+	auto* const file = fopen(fileName, "wb");
+	if (!file)
+		throw std::runtime_error(std::string("Could not create ") + fileName);
+
+	const auto fileClose = utix::MakeScopeExit([file]() noexcept { fclose(file); });
+
+	bool good = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	for (const auto& rom : roms)
+		good = good && fwrite(&rom.entry, sizeof(rom.entry), 1, file) == 1;
+
+	for (const auto& rom : roms)
+		good = good && fwrite(rom.data.data(), 1, rom.data.size(), file) == rom.data.size();
+
+	if (!good)
+		throw std::runtime_error(std::string("Could not write ") + fileName);
+}
+
+
+
+}
@@ -0,0 +1,1430 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#include <Utix/Log.h>
+#include <Utix/Alloc.h>
+
+#include <XChip/Core/CpuManager.h>
+#include <XChip/Core/Instructions.h>
+#include <XChip/Core/Lockstep.h>
+#include <XChip/Core/Emulator.h>
+#include <XChip/Core/RomLibrary.h>
+#include <XChip/Core/SharedImage.h>
+#include <XChip/Core/TripleBuffer.h>
+#include <XChip/Core/CommandQueue.h>
+
+
+
+/*******************************************************************************************
+ *	XChipCoreTest opcode level behavior checks for the Core, run by ctest
+ *	-FILTER   only run the tests whose name contains this string
+ *
+ *	every test writes a few opcodes into fresh CpuManagers, executes them
+ *	and checks the resulting state. No plugins are needed, the "emu/" tests
+ *	run a headless Emulator with RunFrameUncapped. The failed
+ *	checks are printed and the exit code is EXIT_FAILURE if any test failed.
+ *******************************************************************************************/
+
+
+
+
+
+namespace {
+using xchip::Cpu;
+using xchip::CpuManager;
+
+using TestFunc = bool(*)();
+
+struct Test
+{
+	const char* name;
+	TestFunc run;
+};
+
+
+#define TEST_CHECK(cond) do { if (!(cond)) { check_failed(__FILE__, __LINE__, #cond); return false; } } while (0)
+
+void check_failed(const char* file, const int line, const char* cond);
+bool setup(CpuManager& cpuMan);
+void load_program(CpuManager& cpuMan, const uint16_t* program, const size_t size, const size_t at = 0x200);
+void execute(CpuManager& cpuMan, const size_t instrs);
+bool same_state(const CpuManager& a, const CpuManager& b);
+bool same_image(const CpuManager& a, const CpuManager& b);
+long trace_records(const char* fileName);
+bool write_file(const char* fileName, const void* data, const size_t size);
+}
+
+
+
+
+namespace tests {
+bool lockstep_vs_scalar();
+bool lockstep_skip_long();
+bool lockstep_halted();
+bool skip_long();
+bool store_range();
+bool load_range();
+bool scroll_up();
+bool plane_select();
+bool audio_pattern();
+bool wait_key();
+bool memory_wrap();
+bool read_wrap();
+bool stack_wrap();
+bool frame_timers();
+bool frame_clone();
+bool frame_idle_skip();
+bool frame_stats();
+bool clone_dirty_pages();
+bool clone_emulator();
+bool shared_cow();
+bool load_status();
+bool crash_dump();
+bool library_header();
+bool triple_buffer();
+bool command_queue();
+bool save_state();
+}
+
+
+
+
+const Test testList[] = 
+{
+	{ "lockstep/vs-scalar",   tests::lockstep_vs_scalar },
+	{ "lockstep/skip-F000",   tests::lockstep_skip_long },
+	{ "lockstep/halted",      tests::lockstep_halted },
+	{ "instr/skip-F000",      tests::skip_long },
+	{ "instr/5XY2",           tests::store_range },
+	{ "instr/5XY3",           tests::load_range },
+	{ "instr/00DN",           tests::scroll_up },
+	{ "instr/FN01",           tests::plane_select },
+	{ "instr/F002",           tests::audio_pattern },
+	{ "instr/FX0A",           tests::wait_key },
+	{ "wrap/memory",          tests::memory_wrap },
+	{ "wrap/read",            tests::read_wrap },
+	{ "wrap/stack",           tests::stack_wrap },
+	{ "emu/timers",           tests::frame_timers },
+	{ "emu/clone",            tests::frame_clone },
+	{ "emu/idle-skip",        tests::frame_idle_skip },
+	{ "emu/stats",            tests::frame_stats },
+	{ "clone/dirty-pages",    tests::clone_dirty_pages },
+	{ "clone/emulator",       tests::clone_emulator },
+	{ "shared/cow",           tests::shared_cow },
+	{ "load/status",          tests::load_status },
+	{ "trace/crash-dump",     tests::crash_dump },
+	{ "romlib/header",        tests::library_header },
+	{ "thread/triple-buffer", tests::triple_buffer },
+	{ "thread/cmd-queue",     tests::command_queue },
+	{ "emu/save-state",       tests::save_state }
+};
+
+
+
+
+int main(int argc, char** argv)
+{
+	const char* const filter = (argc > 2 && strcmp(argv[1], "-FILTER") == 0) ? argv[2] : nullptr;
+	int failed = 0;
+	int ran = 0;
+
+	for (const auto& test : testList)
+	{
+		if (filter && strstr(test.name, filter) == nullptr)
+			continue;
+
+		const bool passed = test.run();
+		printf("%-24s %s\n", test.name, passed ? "ok" : "FAILED");
+		failed += !passed;
+		++ran;
+	}
+
+	printf("\n%d tests, %d failed\n", ran, failed);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+
+
+
+
+
+
+
+
+namespace {
+
+
+void check_failed(const char* file, const int line, const char* cond)
+{
+	printf("%s:%d: check failed: %s\n", file, line, cond);
+}
+
+
+
+bool setup(CpuManager& cpuMan)
+{
+	// the layout Emulator uses
+	if (cpuMan.SetMemory(CpuManager::MAX_MEMORY_SIZE)
+		&& cpuMan.SetRegisters(0x10)
+		&& cpuMan.SetStack(0x10)
+		&& cpuMan.SetGfxModes({64, 32}, {128, 64}))
+	{
+		cpuMan.LoadDefaultFont();
+		cpuMan.LoadHiResFont();
+		cpuMan.CleanGfx();
+		cpuMan.SetPC(0x200);
+
+		// the gfx instructions only check a render is there, none is used
+		cpuMan.UnsetFlags(Cpu::BAD_RENDER);
+		return true;
+	}
+
+	utix::LogError("XChipCoreTest: could not set up the CpuManager");
+	return false;
+}
+
+
+
+void load_program(CpuManager& cpuMan, const uint16_t* program, const size_t size, const size_t at)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		cpuMan.GetMemory((at + (i * 2)) & cpuMan.GetMemoryMask()) = program[i] >> 8;
+		cpuMan.GetMemory((at + (i * 2) + 1) & cpuMan.GetMemoryMask()) = program[i] & 0xFF;
+	}
+}
+
+
+
+void execute(CpuManager& cpuMan, const size_t instrs)
+{
+	for (size_t i = 0; i < instrs && !cpuMan.GetFlags(Cpu::EXIT); ++i)
+		xchip::instructions::ExecuteInstruction(cpuMan);
+}
+
+
+
+bool same_state(const CpuManager& a, const CpuManager& b)
+{
+	return a.GetPC() == b.GetPC() && a.GetIndexRegister() == b.GetIndexRegister()
+		&& a.GetSP() == b.GetSP() && a.GetFlags(Cpu::EXIT) == b.GetFlags(Cpu::EXIT)
+		&& std::equal(a.GetRegisters(), a.GetRegisters() + 16, b.GetRegisters());
+}
+
+
+
+// same_state, and the whole memory, gfx and timers
+bool same_image(const CpuManager& a, const CpuManager& b)
+{
+	const size_t gfxWords = a.GetPlaneSize() * CpuManager::GFX_PLANES;
+	return same_state(a, b) && a.GetMemorySize() == b.GetMemorySize()
+		&& memcmp(a.GetMemory(), b.GetMemory(), a.GetMemorySize()) == 0
+		&& a.GetPlaneSize() == b.GetPlaneSize()
+		&& std::equal(a.GetGfx(), a.GetGfx() + gfxWords, b.GetGfx())
+		&& a.GetDelayTimer() == b.GetDelayTimer() && a.GetSoundTimer() == b.GetSoundTimer();
+}
+
+
+
+// the record count of a trace file, -1 if there is none
+long trace_records(const char* fileName)
+{
+	FILE* const file = fopen(fileName, "rb");
+	if (!file)
+		return -1;
+
+	xchip::TraceHeader header;
+	const bool read = fread(&header, sizeof(header), 1, file) == 1;
+	fclose(file);
+	return read ? static_cast<long>(header.count) : -1;
+}
+
+
+
+bool write_file(const char* fileName, const void* data, const size_t size)
+{
+	FILE* const file = fopen(fileName, "wb");
+	if (!file)
+	{
+		utix::LogError("XChipCoreTest: could not write \'%s\'", fileName);
+		return false;
+	}
+
+	const bool written = fwrite(data, 1, size, file) == size;
+	fclose(file);
+	return written;
+}
+
+
+}
+
+
+
+
+
+
+
+
+
+namespace tests {
+
+
+// runs 'program' on lanes starting with VA = lane number, through the
+// LockstepRunner and one by one, the states must match
+inline bool run_lockstep(const uint16_t* program, const size_t size, const size_t steps)
+{
+	// a whole block of lanes and a partial one
+	constexpr size_t lanes = xchip::LockstepRunner::BLOCK_LANES + 5;
+	CpuManager vector[lanes];
+	CpuManager scalar[lanes];
+	CpuManager* lanePtrs[lanes];
+
+	for (size_t i = 0; i < lanes; ++i)
+	{
+		if (!setup(vector[i]) || !setup(scalar[i]))
+			return false;
+
+		load_program(vector[i], program, size);
+		load_program(scalar[i], program, size);
+		vector[i].GetRegisters(0xA) = scalar[i].GetRegisters(0xA) = static_cast<uint8_t>(i);
+		vector[i].GetRegisters(0xB) = scalar[i].GetRegisters(0xB) = 3;
+		lanePtrs[i] = &vector[i];
+	}
+
+	xchip::LockstepRunner runner;
+	TEST_CHECK(runner.Initialize(lanePtrs, lanes));
+
+	for (size_t step = 0; step < steps; ++step)
+	{
+		runner.Step();
+		for (size_t i = 0; i < lanes; ++i)
+			execute(scalar[i], 1);
+
+		// the runner keeps the registers over a few steps between flushes
+		if (step % 3 != 2)
+			continue;
+
+		runner.Flush();
+		for (size_t i = 0; i < lanes; ++i)
+			TEST_CHECK(same_state(vector[i], scalar[i]));
+	}
+
+	// the test means nothing if every lane ran scalar
+	TEST_CHECK(runner.GetVectorInstrCount() > 0);
+	return true;
+}
+
+
+
+bool lockstep_vs_scalar()
+{
+	// ALU and skips, the skips split the lanes by VA
+	const uint16_t program[] = 
+	{
+		0x7A01, // ADD VA, 1
+		0x8AB4, // ADD VA, VB
+		0x3A0C, // SE VA, 0x0C
+		0x8BA1, // OR VB, VA
+		0x8AB5, // SUB VA, VB
+		0x8AB6, // SHR VA
+		0x4A00, // SNE VA, 0
+		0x6C07, // LD VC, 7
+		0x8ACE, // SHL VA
+		0x1200  // JP 0x200
+	};
+
+	return run_lockstep(program, utix::arr_size(program), 200);
+}
+
+
+
+bool lockstep_skip_long()
+{
+	// half the lanes skip F000 NNNN, they must land past NNNN
+	const uint16_t program[] =
+	{
+		0x8AB2, // AND VA, VB      VA = lane & 3
+		0x3A00, // SE VA, 0
+		0xF000, // LD I, 0x0300
+		0x0300,
+		0x7B04, // ADD VB, 4
+		0x1202  // JP 0x202
+	};
+
+	return run_lockstep(program, utix::arr_size(program), 200);
+}
+
+
+
+bool lockstep_halted()
+{
+	// every third lane starts stopped, the lanes reaching VA = 5
+	// stop in FX0A. Halted lanes must keep their PC and registers
+	const uint16_t program[] =
+	{
+		0x7A01, // ADD VA, 1
+		0x3A05, // SE VA, 5
+		0x1200, // JP 0x200
+		0xF00A, // LD V0, K
+		0x1200  // JP 0x200
+	};
+
+	constexpr size_t lanes = xchip::LockstepRunner::BLOCK_LANES + 5;
+	CpuManager vector[lanes];
+	CpuManager scalar[lanes];
+	CpuManager* lanePtrs[lanes];
+
+	for (size_t i = 0; i < lanes; ++i)
+	{
+		if (!setup(vector[i]) || !setup(scalar[i]))
+			return false;
+
+		load_program(vector[i], program, utix::arr_size(program));
+		load_program(scalar[i], program, utix::arr_size(program));
+		vector[i].GetRegisters(0xA) = scalar[i].GetRegisters(0xA) = static_cast<uint8_t>(i);
+		if (i % 3 == 0)
+		{
+			vector[i].SetFlags(Cpu::EXIT);
+			scalar[i].SetFlags(Cpu::EXIT);
+		}
+
+		lanePtrs[i] = &vector[i];
+	}
+
+	xchip::LockstepRunner runner;
+	TEST_CHECK(runner.Initialize(lanePtrs, lanes));
+
+	size_t released = lanes;
+	for (size_t step = 0; step < 60; ++step)
+	{
+		runner.Step();
+		for (auto& lane : scalar)
+		{
+			if (!lane.GetFlags(Cpu::EXIT | Cpu::WAIT_KEY))
+				xchip::instructions::ExecuteInstruction(lane);
+		}
+
+		// a lane let out of FX0A through GetLane() runs again
+		if (step == 30)
+		{
+			for (released = 0; released < lanes; ++released)
+			{
+				if (scalar[released].GetFlags(Cpu::WAIT_KEY))
+					break;
+			}
+
+			TEST_CHECK(released < lanes);
+			runner.GetLane(released).UnsetFlags(Cpu::WAIT_KEY);
+			scalar[released].UnsetFlags(Cpu::WAIT_KEY);
+		}
+	}
+
+	runner.Flush();
+	for (size_t i = 0; i < lanes; ++i)
+	{
+		TEST_CHECK(same_state(vector[i], scalar[i]));
+		TEST_CHECK(vector[i].GetFlags(Cpu::WAIT_KEY) == scalar[i].GetFlags(Cpu::WAIT_KEY));
+		TEST_CHECK(vector[i].GetOpcode() == scalar[i].GetOpcode());
+	}
+
+	TEST_CHECK(vector[0].GetPC() == 0x200 && vector[0].GetRegisters(0xA) == 0);
+	TEST_CHECK(!vector[released].GetFlags(Cpu::WAIT_KEY));
+	return true;
+}
+
+
+
+bool skip_long()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	// every skip instruction jumps over F000 NNNN whole
+	const uint16_t program[] =
+	{
+		0x3000, 0xF000, 0x0310, // SE V0, 0
+		0x4001, 0xF000, 0x0320, // SNE V0, 1
+		0x5010, 0xF000, 0x0330, // SE V0, V1
+		0x9020, 0xF000, 0x0340, // SNE V0, V2
+		0x3001, 0xF000, 0x0350  // SE V0, 1: no skip, I = 0x0350
+	};
+
+	load_program(cpuMan, program, utix::arr_size(program));
+	cpuMan.GetRegisters(2) = 1;
+
+	for (size_t i = 0; i < 4; ++i)
+	{
+		execute(cpuMan, 1);
+		TEST_CHECK(cpuMan.GetPC() == 0x200 + ((i + 1) * 6));
+	}
+
+	execute(cpuMan, 2);
+	TEST_CHECK(cpuMan.GetPC() == 0x200 + (5 * 6));
+	TEST_CHECK(cpuMan.GetIndexRegister() == 0x0350);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool store_range()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	// ascending, descending and a single register. I is not changed
+	const uint16_t program[] = { 0x5252, 0x5632, 0x5772 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	for (size_t i = 0; i < 16; ++i)
+		cpuMan.GetRegisters(i) = static_cast<uint8_t>(0x10 + i);
+
+	cpuMan.SetIndexRegister(0x400);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0x400) == 0x12 && cpuMan.GetMemory(0x401) == 0x13);
+	TEST_CHECK(cpuMan.GetMemory(0x402) == 0x14 && cpuMan.GetMemory(0x403) == 0x15);
+	TEST_CHECK(cpuMan.GetMemory(0x404) == 0);
+	TEST_CHECK(cpuMan.GetIndexRegister() == 0x400);
+
+	cpuMan.SetIndexRegister(0x410);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0x410) == 0x16 && cpuMan.GetMemory(0x411) == 0x15);
+	TEST_CHECK(cpuMan.GetMemory(0x412) == 0x14 && cpuMan.GetMemory(0x413) == 0x13);
+	TEST_CHECK(cpuMan.GetMemory(0x414) == 0);
+
+	cpuMan.SetIndexRegister(0x420);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0x420) == 0x17 && cpuMan.GetMemory(0x421) == 0);
+	return true;
+}
+
+
+
+bool load_range()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	const uint16_t program[] = { 0x5253, 0x5A83 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	for (size_t i = 0; i < 4; ++i)
+		cpuMan.GetMemory(0x400 + i) = static_cast<uint8_t>(0xA0 + i);
+
+	cpuMan.SetIndexRegister(0x400);
+	execute(cpuMan, 2);
+
+	// V2..V5 ascending, then VA down to V8
+	TEST_CHECK(cpuMan.GetRegisters(2) == 0xA0 && cpuMan.GetRegisters(5) == 0xA3);
+	TEST_CHECK(cpuMan.GetRegisters(0xA) == 0xA0 && cpuMan.GetRegisters(9) == 0xA1);
+	TEST_CHECK(cpuMan.GetRegisters(8) == 0xA2);
+	TEST_CHECK(cpuMan.GetRegisters(1) == 0 && cpuMan.GetRegisters(6) == 0 && cpuMan.GetRegisters(0xB) == 0);
+	TEST_CHECK(cpuMan.GetIndexRegister() == 0x400);
+	return true;
+}
+
+
+
+bool scroll_up()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	// a row at y = 10 and one at the bottom, up 3 lines
+	const uint16_t program[] = { 0x00D3 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	cpuMan.GetPlane(0)[10] = 0xF0;
+	cpuMan.GetPlane(0)[31] = 0x0F;
+	execute(cpuMan, 1);
+
+	TEST_CHECK(cpuMan.GetPlane(0)[7] == 0xF0 && cpuMan.GetPlane(0)[28] == 0x0F);
+	TEST_CHECK(cpuMan.GetPlane(0)[10] == 0 && cpuMan.GetPlane(0)[31] == 0);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool plane_select()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	const uint16_t program[] = 
+	{
+		0xF201, // plane 1
+		0x00E0, // CLS
+		0xF301, // planes 0 and 1
+		0xD011, // DRW V0, V1, 1
+		0xF001, // no plane
+		0xD011, // DRW V0, V1, 1
+		0xF011  // not a FN01
+	};
+
+	load_program(cpuMan, program, utix::arr_size(program));
+	cpuMan.GetPlane(0)[5] = 0xAA;
+	cpuMan.GetPlane(1)[5] = 0x55;
+	cpuMan.GetMemory(0x400) = 0x80;
+	cpuMan.GetMemory(0x401) = 0x40;
+	cpuMan.SetIndexRegister(0x400);
+
+	// CLS only clears the selected plane
+	execute(cpuMan, 2);
+	TEST_CHECK(cpuMan.GetPlanes() == 0x2);
+	TEST_CHECK(cpuMan.GetPlane(0)[5] == 0xAA && cpuMan.GetPlane(1)[5] == 0);
+
+	// each plane takes its own row of sprite data, one after the other
+	execute(cpuMan, 2);
+	TEST_CHECK(cpuMan.GetPlane(0)[0] == (UINT64_C(0x80) << 56));
+	TEST_CHECK(cpuMan.GetPlane(1)[0] == (UINT64_C(0x40) << 56));
+	TEST_CHECK(cpuMan.GetRegisters(0xF) == 0);
+
+	// with no plane selected DXYN draws nothing and collides with nothing
+	execute(cpuMan, 2);
+	TEST_CHECK(cpuMan.GetPlanes() == 0);
+	TEST_CHECK(cpuMan.GetPlane(0)[0] == (UINT64_C(0x80) << 56));
+	TEST_CHECK(cpuMan.GetPlane(1)[0] == (UINT64_C(0x40) << 56));
+	TEST_CHECK(cpuMan.GetRegisters(0xF) == 0);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetFlags(Cpu::EXIT));
+	TEST_CHECK(cpuMan.GetPlanes() == 0);
+	return true;
+}
+
+
+
+bool audio_pattern()
+{
+	// F102 and F012 only share F002's low nibble, they are unknown
+	for (const uint16_t opcode : { 0xF102, 0xF012 })
+	{
+		CpuManager cpuMan;
+		if (!setup(cpuMan))
+			return false;
+
+		load_program(cpuMan, &opcode, 1);
+		execute(cpuMan, 1);
+		TEST_CHECK(cpuMan.GetFlags(Cpu::EXIT));
+		TEST_CHECK(!cpuMan.GetFlags(Cpu::AUDIO_PATTERN));
+	}
+
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	const uint16_t program[] = { 0xF002 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	for (size_t i = 0; i < 16; ++i)
+		cpuMan.GetMemory(0x400 + i) = static_cast<uint8_t>(0xF0 + i);
+
+	cpuMan.SetIndexRegister(0x400);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetFlags(Cpu::AUDIO_PATTERN));
+	TEST_CHECK(std::equal(cpuMan.GetCpu().pattern, cpuMan.GetCpu().pattern + 16, cpuMan.GetMemoryAt(0x400)));
+	TEST_CHECK(cpuMan.GetIndexRegister() == 0x400);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool wait_key()
+{
+	const uint16_t program[] =
+	{
+		0xF30A, // LD V3, K
+		0x7301, // ADD V3, 1
+		0x1204  // JP 0x204
+	};
+
+	CpuManager cpuMan;
+	TEST_CHECK(setup(cpuMan));
+	load_program(cpuMan, program, sizeof(program) / 2);
+
+	// key 5 is held when FX0A runs
+	cpuMan.SetKeys(0x0020);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetFlags(Cpu::WAIT_KEY) && cpuMan.GetPC() == 0x202);
+
+	// it must be released before it counts
+	TEST_CHECK(!xchip::instructions::PollWaitKey(cpuMan));
+	cpuMan.SetKeys(0x0000);
+	TEST_CHECK(!xchip::instructions::PollWaitKey(cpuMan));
+	TEST_CHECK(cpuMan.GetFlags(Cpu::WAIT_KEY));
+
+	// the lowest of the new keys is taken
+	cpuMan.SetKeys(0x0220);
+	TEST_CHECK(xchip::instructions::PollWaitKey(cpuMan));
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::WAIT_KEY) && cpuMan.GetRegisters(3) == 5);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetRegisters(3) == 6 && cpuMan.GetPC() == 0x204);
+
+
+	// an Emulator frame stops at the wait, and runs nothing while it lasts
+	const uint8_t rom[] = { 0x60, 0x01, 0xF3, 0x0A, 0x12, 0x04 };
+	xchip::Emulator emulator;
+	TEST_CHECK(emulator.Initialize());
+	TEST_CHECK(emulator.LoadRom(rom, sizeof(rom)));
+	TEST_CHECK(emulator.RunFrameUncapped() == 2);
+	TEST_CHECK(emulator.RunFrameUncapped() == 0);
+	TEST_CHECK(emulator.GetCpuManager().GetFlags(Cpu::WAIT_KEY));
+	TEST_CHECK(emulator.GetCpuManager().GetPC() == 0x204);
+	return true;
+}
+
+
+
+bool memory_wrap()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	const uint16_t program[] = { 0xF355, 0xFA33, 0x5232, 0xF165 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	for (size_t i = 0; i < 4; ++i)
+		cpuMan.GetRegisters(i) = static_cast<uint8_t>(i + 1);
+
+	// FX55 runs over the memory end into its start
+	cpuMan.SetIndexRegister(0xFFFE);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0xFFFE) == 1 && cpuMan.GetMemory(0xFFFF) == 2);
+	TEST_CHECK(cpuMan.GetMemory(0x0000) == 3 && cpuMan.GetMemory(0x0001) == 4);
+
+	// FX33 wraps each digit
+	cpuMan.GetRegisters(0xA) = 159;
+	cpuMan.SetIndexRegister(0xFFFF);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0xFFFF) == 1);
+	TEST_CHECK(cpuMan.GetMemory(0x0000) == 5 && cpuMan.GetMemory(0x0001) == 9);
+
+	// 5XY2 too
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetMemory(0xFFFF) == 3 && cpuMan.GetMemory(0x0000) == 4);
+
+	// I past the memory is masked
+	cpuMan.GetMemory(0x400) = 0x12;
+	cpuMan.GetMemory(0x401) = 0x34;
+	cpuMan.SetIndexRegister(0x10400);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetRegisters(0) == 0x12 && cpuMan.GetRegisters(1) == 0x34);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+
+	// PC runs from the last word to the first, and is masked on fetch
+	const uint16_t edge[] = { 0x6E42, 0x6D17 };
+	load_program(cpuMan, edge, utix::arr_size(edge), 0xFFFE);
+	cpuMan.SetPC(0xFFFE);
+	execute(cpuMan, 2);
+	TEST_CHECK(cpuMan.GetRegisters(0xE) == 0x42 && cpuMan.GetRegisters(0xD) == 0x17);
+	TEST_CHECK(cpuMan.GetPC() == 0x0002);
+
+	cpuMan.GetRegisters(0xE) = 0;
+	cpuMan.SetPC(0x1FFFE);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetRegisters(0xE) == 0x42);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool read_wrap()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	// FX55 then FX65 at the memory end reads back what was written,
+	// 5XY3 descending and F002 wrap the same way
+	const uint16_t program[] = { 0xF355, 0x6000, 0x6100, 0x6200, 0x6300, 0xF365, 0x5A73, 0xF002 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	for (size_t i = 0; i < 4; ++i)
+		cpuMan.GetRegisters(i) = static_cast<uint8_t>(0xA0 + i);
+
+	cpuMan.SetIndexRegister(0xFFFE);
+	execute(cpuMan, 6);
+	TEST_CHECK(cpuMan.GetRegisters(0) == 0xA0 && cpuMan.GetRegisters(1) == 0xA1);
+	TEST_CHECK(cpuMan.GetRegisters(2) == 0xA2 && cpuMan.GetRegisters(3) == 0xA3);
+
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetRegisters(0xA) == 0xA0 && cpuMan.GetRegisters(9) == 0xA1);
+	TEST_CHECK(cpuMan.GetRegisters(8) == 0xA2 && cpuMan.GetRegisters(7) == 0xA3);
+
+	cpuMan.SetIndexRegister(0xFFFC);
+	execute(cpuMan, 1);
+	TEST_CHECK(std::equal(cpuMan.GetCpu().pattern, cpuMan.GetCpu().pattern + 4, cpuMan.GetMemoryAt(0xFFFC)));
+	TEST_CHECK(std::equal(cpuMan.GetCpu().pattern + 4, cpuMan.GetCpu().pattern + 16, cpuMan.GetMemoryAt(0)));
+	TEST_CHECK(cpuMan.GetCpu().pattern[4] == 0xA2);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool stack_wrap()
+{
+	CpuManager cpuMan;
+	if (!setup(cpuMan))
+		return false;
+
+	// 0x200 calls itself, the 17th call overwrites the first return address
+	const uint16_t program[] = { 0x2200 };
+	load_program(cpuMan, program, utix::arr_size(program));
+	execute(cpuMan, 16);
+	TEST_CHECK(cpuMan.GetSP() == 0);
+	cpuMan.GetStack(0) = 0;
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetSP() == 1 && cpuMan.GetStack(0) == 0x202);
+	TEST_CHECK(cpuMan.GetPC() == 0x200);
+
+	// returning with SP = 0 pops the last entry
+	const uint16_t ret[] = { 0x00EE };
+	load_program(cpuMan, ret, utix::arr_size(ret), 0x300);
+	cpuMan.GetStack(0xF) = 0x340;
+	cpuMan.SetSP(0);
+	cpuMan.SetPC(0x300);
+	execute(cpuMan, 1);
+	TEST_CHECK(cpuMan.GetSP() == 0xF && cpuMan.GetPC() == 0x340);
+	TEST_CHECK(!cpuMan.GetFlags(Cpu::EXIT));
+	return true;
+}
+
+
+
+bool frame_timers()
+{
+	// sets both timers to 30 and spins. FX18 with no sound plugin only sets
+	// the timer, the timers tick 60 times per emulated second whatever the fps
+	const uint8_t rom[] = 
+	{
+		0x6A, 0x1E, // LD VA, 30
+		0xFA, 0x18, // LD ST, VA
+		0xFA, 0x15, // LD DT, VA
+		0x12, 0x06  // JP 0x206
+	};
+
+	// fps, frames to run up to FX15 and the timers right after them
+	const int runs[][4] = { { 60, 3, 29, 28 }, { 30, 2, 28, 26 } };
+
+	for (const auto& run : runs)
+	{
+		xchip::Emulator emulator;
+		TEST_CHECK(emulator.Initialize());
+		TEST_CHECK(emulator.LoadRom(rom, sizeof(rom)));
+		emulator.SetCpuFreq(60);
+		emulator.SetFps(run[0]);
+
+		const int ticks = 60 / run[0];
+		const auto& cpuMan = emulator.GetCpuManager();
+		for (int frame = 0; frame < run[1]; ++frame)
+			emulator.RunFrameUncapped();
+
+		TEST_CHECK(cpuMan.GetDelayTimer() == run[2]);
+		TEST_CHECK(cpuMan.GetSoundTimer() == run[3]);
+
+		for (int frame = 0; frame < 10; ++frame)
+			emulator.RunFrameUncapped();
+
+		TEST_CHECK(cpuMan.GetDelayTimer() == run[2] - (10 * ticks));
+		TEST_CHECK(cpuMan.GetSoundTimer() == run[3] - (10 * ticks));
+
+		// and stop at 0
+		for (int frame = 0; frame < 60; ++frame)
+			emulator.RunFrameUncapped();
+
+		TEST_CHECK(cpuMan.GetDelayTimer() == 0 && cpuMan.GetSoundTimer() == 0);
+		TEST_CHECK(!emulator.GetExitFlag());
+	}
+
+	return true;
+}
+
+
+
+
+bool frame_clone()
+{
+	// counts, reloads the delay timer from the count when it runs out and
+	// stores the registers. 1000hz at 70 fps leaves remainders of both
+	// the instructions and the timer ticks on every frame.
+	const uint8_t rom[] = 
+	{
+		0x70, 0x01, // ADD V0, 1
+		0x81, 0x04, // ADD V1, V0
+		0xF2, 0x07, // LD V2, DT
+		0x32, 0x00, // SE V2, 0
+		0x12, 0x0C, // JP 0x20C
+		0xF1, 0x15, // LD DT, V1
+		0xA3, 0x00, // LD I, 0x300
+		0xF2, 0x55, // LD [I], V2
+		0x12, 0x00  // JP 0x200
+	};
+
+	xchip::Emulator source;
+	xchip::Emulator clone;
+	TEST_CHECK(source.Initialize() && clone.Initialize());
+	TEST_CHECK(source.LoadRom(rom, sizeof(rom)));
+	source.SetCpuFreq(1000);
+	source.SetFps(70);
+
+	for (int frame = 0; frame < 5; ++frame)
+		source.RunFrameUncapped();
+
+	TEST_CHECK(source.Clone(clone));
+
+	const auto& a = source.GetCpuManager();
+	const auto& b = clone.GetCpuManager();
+	for (int frame = 0; frame < 50; ++frame)
+	{
+		TEST_CHECK(source.RunFrameUncapped() == clone.RunFrameUncapped());
+		TEST_CHECK(same_state(a, b));
+		TEST_CHECK(a.GetDelayTimer() == b.GetDelayTimer());
+		TEST_CHECK(std::equal(&a.GetMemory(0x300), &a.GetMemory(0x303), &b.GetMemory(0x300)));
+	}
+
+	return true;
+}
+
+
+
+bool frame_idle_skip()
+{
+	// waits on the delay timer with a longer wait each time,
+	// then on a key nobody presses
+	const uint8_t rom[] =
+	{
+		0x61, 0x05, // LD V1, 5
+		0xF1, 0x15, // LD DT, V1
+		0xF2, 0x07, // LD V2, DT
+		0x32, 0x00, // SE V2, 0
+		0x12, 0x04, // JP 0x204
+		0x73, 0x01, // ADD V3, 1
+		0x71, 0x07, // ADD V1, 7
+		0x33, 0x08, // SE V3, 8
+		0x12, 0x02, // JP 0x202
+		0xE4, 0x9E, // SKP V4
+		0x12, 0x12  // JP 0x212
+	};
+
+	xchip::Emulator skipping;
+	xchip::Emulator running;
+	TEST_CHECK(skipping.Initialize() && running.Initialize());
+	TEST_CHECK(skipping.LoadRom(rom, sizeof(rom)) && running.LoadRom(rom, sizeof(rom)));
+	skipping.SetIdleSkipEnabled(true);
+	running.SetIdleSkipEnabled(false);
+
+	for (const int fps : { 70, 60 })
+	{
+		skipping.SetCpuFreq(1000);
+		running.SetCpuFreq(1000);
+		skipping.SetFps(fps);
+		running.SetFps(fps);
+
+		// the skipped instructions count as executed
+		for (int frame = 0; frame < 200; ++frame)
+		{
+			TEST_CHECK(skipping.RunFrameUncapped() == running.RunFrameUncapped());
+			TEST_CHECK(same_image(skipping.GetCpuManager(), running.GetCpuManager()));
+		}
+	}
+
+	TEST_CHECK(running.GetCpuManager().GetRegisters(3) == 8);
+	TEST_CHECK(running.GetCpuManager().GetPC() == 0x212 || running.GetCpuManager().GetPC() == 0x214);
+	return true;
+}
+
+
+
+bool frame_stats()
+{
+	// RunFrameUncapped alone publishes the snapshot, once a window passed
+	const uint8_t rom[] = { 0x70, 0x01, 0x12, 0x00 };
+	xchip::Emulator emulator;
+	TEST_CHECK(emulator.Initialize());
+	TEST_CHECK(emulator.LoadRom(rom, sizeof(rom)));
+	emulator.SetStatsEnabled(true);
+
+	using xchip::StatsCollector;
+	const auto begin = StatsCollector::Now();
+	uint64_t executed = 0;
+	while (emulator.GetStats().instructions == 0 && (StatsCollector::Now() - begin) < 3 * StatsCollector::WINDOW)
+		executed += emulator.RunFrameUncapped();
+
+	const auto stats = emulator.GetStats();
+	TEST_CHECK(stats.instructions != 0 && stats.instructions <= executed);
+	TEST_CHECK(stats.framesPresented == 0 && stats.instrPerSec > 0);
+	return true;
+}
+
+
+
+bool clone_dirty_pages()
+{
+	// stores V0 at an I moving across the pages and draws from it
+	const uint16_t program[] =
+	{
+		0xA300, // LD I, 0x300
+		0x7001, // ADD V0, 1
+		0xF055, // LD [I], V0
+		0xF01E, // ADD I, V0
+		0xD015, // DRW V0, V1, 5
+		0x1202  // JP 0x202
+	};
+
+	CpuManager source, clone;
+	TEST_CHECK(setup(source) && setup(clone));
+	load_program(source, program, sizeof(program) / 2);
+	source.MarkMemoryClean();
+	TEST_CHECK(source.CloneInto(clone));
+
+	// the clone dirties its own pages and gfx in between. The
+	// incremental copy has to restore them, like a full one
+	for (size_t i = 0; i < 1000; i += 7)
+	{
+		const size_t offset = 0x800 + ((i % 48) * CpuManager::MEMORY_PAGE_SIZE);
+		clone.GetMemory(offset) ^= 0xAA;
+		clone.MarkMemoryDirty(offset, 1);
+		clone.GetGfx()[i % 16] ^= 0x1;
+		clone.MarkGfxDirty();
+
+		execute(source, 7);
+		TEST_CHECK(source.CloneInto(clone));
+
+		CpuManager full;
+		TEST_CHECK(source.CloneInto(full));
+		TEST_CHECK(same_image(source, clone));
+		TEST_CHECK(same_image(full, clone));
+	}
+
+	return true;
+}
+
+
+
+bool clone_emulator()
+{
+	// Emulator::Clone gives the machine CloneInto gives, into a
+	// fresh dest and into one which ran on its own since
+	const uint8_t rom[] =
+	{
+		0xA3, 0x00, // LD I, 0x300
+		0x70, 0x03, // ADD V0, 3
+		0xF0, 0x55, // LD [I], V0
+		0xF0, 0x1E, // ADD I, V0
+		0x81, 0x04, // ADD V1, V0
+		0xF1, 0x15, // LD DT, V1
+		0x12, 0x02  // JP 0x202
+	};
+
+	xchip::Emulator source;
+	xchip::Emulator clone;
+	TEST_CHECK(source.Initialize() && clone.Initialize());
+	TEST_CHECK(source.LoadRom(rom, sizeof(rom)) && clone.LoadRom(rom, sizeof(rom)));
+	source.SetCpuFreq(600);
+	clone.SetCpuFreq(900);
+
+	for (int round = 0; round < 8; ++round)
+	{
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			source.RunFrameUncapped();
+			clone.RunFrameUncapped();
+		}
+
+		TEST_CHECK(source.Clone(clone));
+
+		CpuManager full;
+		TEST_CHECK(source.GetCpuManager().CloneInto(full));
+		TEST_CHECK(same_image(full, clone.GetCpuManager()));
+		TEST_CHECK(clone.GetCpuFreq() == 600);
+	}
+
+	return true;
+}
+
+
+
+bool shared_cow()
+{
+	const uint16_t program[] =
+	{
+		0xA300, // LD I, 0x300
+		0x6011, // LD V0, 0x11
+		0xF055, // LD [I], V0
+		0x1206  // JP 0x206
+	};
+
+	CpuManager source;
+	TEST_CHECK(setup(source));
+	load_program(source, program, sizeof(program) / 2);
+
+	// the image outlives the managers mapping it
+	xchip::SharedImage image;
+	TEST_CHECK(image.Initialize(source));
+
+	CpuManager a, b, c;
+	TEST_CHECK(setup(a) && setup(b) && setup(c));
+	TEST_CHECK(a.SetMemory(image) && b.SetMemory(image) && c.SetMemory(image));
+	TEST_CHECK(a.IsMemoryShared() && b.IsMemoryShared() && c.IsMemoryShared());
+
+	// a writes through the instructions, b through the raw memory
+	execute(a, 4);
+	b.GetMemory(0x300) = 0x22;
+	b.MarkMemoryDirty(0x300, 1);
+	b.GetMemory(0x200) = 0x00;
+	b.MarkMemoryDirty(0x200, 1);
+
+	TEST_CHECK(a.GetMemory(0x300) == 0x11 && b.GetMemory(0x300) == 0x22);
+	TEST_CHECK(a.GetMemory(0x200) == 0xA3 && b.GetMemory(0x200) == 0x00);
+	TEST_CHECK(c.GetMemory(0x300) == 0x00 && c.GetMemory(0x200) == 0xA3);
+	TEST_CHECK(image.GetData()[0x300] == 0x00 && image.GetData()[0x200] == 0xA3);
+
+	// the pages nobody wrote are still the image's
+	TEST_CHECK(memcmp(a.GetMemory(), image.GetData(), 0x200) == 0);
+	TEST_CHECK(memcmp(b.GetMemory() + 0x400, image.GetData() + 0x400, 0x1000) == 0);
+	return true;
+}
+
+
+
+bool load_status()
+{
+	using xchip::LoadStatus;
+	using xchip::MappedFile;
+
+	const uint8_t rom[] = { 0x12, 0x34, 0x56, 0x78 };
+	const size_t memSize = CpuManager::MAX_MEMORY_SIZE;
+
+	CpuManager cpuMan;
+	TEST_CHECK(setup(cpuMan));
+
+	// spans, up to the last byte of memory
+	TEST_CHECK(cpuMan.LoadRom(rom, sizeof(rom), 0x200) == LoadStatus::OK);
+	TEST_CHECK(memcmp(&cpuMan.GetMemory(0x200), rom, sizeof(rom)) == 0);
+	TEST_CHECK(cpuMan.LoadRom(rom, sizeof(rom), memSize - sizeof(rom)) == LoadStatus::OK);
+	TEST_CHECK(cpuMan.GetMemory(memSize - 1) == 0x78);
+	TEST_CHECK(cpuMan.LoadRom(rom, sizeof(rom), memSize - 2) == LoadStatus::DOES_NOT_FIT);
+	TEST_CHECK(cpuMan.LoadRom(rom, 0, 0x200) == LoadStatus::EMPTY);
+	TEST_CHECK(cpuMan.LoadRom(nullptr, sizeof(rom), 0x200) == LoadStatus::EMPTY);
+
+
+	// files, through MappedFile
+	const char* const fileName = "XChipCoreTest.ch8";
+	const char* const emptyName = "XChipCoreTest.empty";
+	const bool written = write_file(fileName, rom, sizeof(rom)) && write_file(emptyName, rom, 0);
+
+	MappedFile file;
+	const auto fileStatus = written ? file.Initialize(fileName) : LoadStatus::OPEN_FAILED;
+	const bool sameData = file.IsInitialized() && file.GetSize() == sizeof(rom) 
+		&& memcmp(file.GetData(), rom, sizeof(rom)) == 0;
+	file.Dispose();
+
+	MappedFile empty;
+	const auto emptyStatus = empty.Initialize(emptyName);
+	const auto loadStatus = cpuMan.LoadRom(fileName, 0x300);
+	const auto loadEmptyStatus = cpuMan.LoadRom(emptyName, 0x300);
+	remove(fileName);
+	remove(emptyName);
+
+	MappedFile missing;
+	TEST_CHECK(written);
+	TEST_CHECK(fileStatus == LoadStatus::OK && sameData);
+	TEST_CHECK(emptyStatus == LoadStatus::EMPTY && !empty.IsInitialized());
+	TEST_CHECK(loadStatus == LoadStatus::OK && cpuMan.GetMemory(0x303) == 0x78);
+	TEST_CHECK(loadEmptyStatus == LoadStatus::EMPTY);
+	TEST_CHECK(missing.Initialize(fileName) == LoadStatus::OPEN_FAILED);
+	TEST_CHECK(cpuMan.LoadRom(fileName, 0x300) == LoadStatus::OPEN_FAILED);
+	return true;
+}
+
+
+
+bool crash_dump()
+{
+	// 16 instructions fill the ring, the 17th is unknown
+	uint8_t rom[34];
+	for (size_t i = 0; i < 16; ++i)
+	{
+		rom[i * 2] = 0x70;
+		rom[(i * 2) + 1] = 0x01;
+	}
+
+	rom[32] = 0xFF;
+	rom[33] = 0xFF;
+
+	const char* const fileName = "XChipCoreTest.trace";
+	remove(fileName);
+
+	xchip::Emulator emulator;
+	TEST_CHECK(emulator.Initialize());
+	TEST_CHECK(emulator.LoadRom(rom, sizeof(rom)));
+	TEST_CHECK(emulator.SetTraceEnabled(true, 16));
+	emulator.GetTrace().SetCrashDump(fileName, emulator.GetCpuManager());
+
+	// another machine's unknown opcode is not this trace's crash
+	CpuManager other;
+	if (!setup(other))
+		return false;
+
+	const uint16_t unknown[] = { 0xFFFF };
+	load_program(other, unknown, utix::arr_size(unknown));
+	execute(other, 1);
+	TEST_CHECK(other.GetFlags(Cpu::EXIT));
+	TEST_CHECK(trace_records(fileName) == -1);
+
+	// the full ring and the failed instruction
+	emulator.SetCpuFreq(17 * 60);
+	emulator.SetFps(60);
+	emulator.RunFrameUncapped();
+	TEST_CHECK(emulator.GetExitFlag());
+	const long records = trace_records(fileName);
+	remove(fileName);
+	TEST_CHECK(records == 17);
+	return true;
+}
+
+
+
+bool library_header()
+{
+	using xchip::RomLibrary;
+	using xchip::LoadStatus;
+
+	// Header | one Entry | 4 ROM bytes, as RomPack writes it
+	struct
+	{
+		RomLibrary::Header header;
+		RomLibrary::Entry entry;
+		uint8_t rom[4];
+	} file;
+
+	memset(&file, 0, sizeof(file));
+	memcpy(file.header.magic, RomLibrary::MAGIC, sizeof(file.header.magic));
+	file.header.version = RomLibrary::VERSION;
+	file.header.count = 1;
+	file.header.indexOffset = sizeof(file.header);
+	file.header.dataOffset = sizeof(file.header) + sizeof(file.entry);
+	file.entry.size = sizeof(file.rom);
+	strcpy(file.entry.name, "rom");
+
+	const char* const fileName = "XChipCoreTest.xlib";
+	const auto load = [&](const uint64_t indexOffset, const uint64_t dataOffset) {
+		file.header.indexOffset = indexOffset;
+		file.header.dataOffset = dataOffset;
+		RomLibrary library;
+		return write_file(fileName, &file, sizeof(file)) ? library.Initialize(fileName) : LoadStatus::OPEN_FAILED;
+	};
+
+	const uint64_t indexOffset = sizeof(file.header);
+	const uint64_t dataOffset = indexOffset + sizeof(file.entry);
+	const LoadStatus good = load(indexOffset, dataOffset);
+
+	// an index offset which wraps the index end below the file size, 
+	// the ROM bytes over the index and the index over the header
+	const LoadStatus wrapped = load(~uint64_t(0) - 7, dataOffset);
+	const LoadStatus overlapped = load(indexOffset, dataOffset - 8);
+	const LoadStatus inHeader = load(0, dataOffset);
+	remove(fileName);
+
+	TEST_CHECK(good == LoadStatus::OK);
+	TEST_CHECK(wrapped == LoadStatus::BAD_FORMAT);
+	TEST_CHECK(overlapped == LoadStatus::BAD_FORMAT);
+	TEST_CHECK(inHeader == LoadStatus::BAD_FORMAT);
+	return true;
+}
+
+
+
+
+
+
+bool triple_buffer()
+{
+	using xchip::Frame;
+	xchip::TripleBuffer frames;
+	TEST_CHECK(frames.Initialize(16));
+	TEST_CHECK(frames.Acquire() == nullptr);
+
+	const auto publish = [&frames](const uint8_t value) {
+		Frame& back = frames.GetBack();
+		memset(back.pixels, value, frames.GetMaxPixels());
+		back.res = { 4, 4 };
+		frames.Publish();
+	};
+
+	publish(1);
+	const Frame* front = frames.Acquire();
+	TEST_CHECK(front && front->number == 1 && front->pixels[15] == 1 && front->res.x == 4);
+	TEST_CHECK(frames.Acquire() == nullptr);
+
+	// the newest frame wins, the one in between is dropped
+	publish(2);
+	publish(3);
+	front = frames.Acquire();
+	TEST_CHECK(front && front->number == 3 && front->pixels[0] == 3);
+	TEST_CHECK(frames.Acquire() == nullptr);
+
+
+	// across threads, every acquired frame is newer than the last
+	// one and whole: all its pixels come from the same publish
+	constexpr uint64_t last = 20000;
+	std::thread producer([&]() {
+		for (uint64_t number = 4; number <= last; ++number)
+			publish(static_cast<uint8_t>(number));
+	});
+
+	uint64_t seen = 3;
+	bool ordered = true;
+	bool whole = true;
+	while (seen != last)
+	{
+		front = frames.Acquire();
+		if (!front)
+			continue;
+
+		ordered = ordered && front->number > seen;
+		for (size_t i = 0; i < frames.GetMaxPixels(); ++i)
+			whole = whole && front->pixels[i] == static_cast<uint8_t>(front->number);
+
+		seen = front->number;
+	}
+
+	producer.join();
+	TEST_CHECK(ordered && whole);
+	return true;
+}
+
+
+
+
+
+bool command_queue()
+{
+	using xchip::Command;
+	using xchip::CommandQueue;
+
+	CommandQueue queue;
+	Command command { Command::SET_CPU_FREQ, 0, nullptr, nullptr, nullptr };
+	TEST_CHECK(!queue.Pop(command));
+
+	// fills up, then drains in order, twice to go around the slots
+	for (int lap = 0; lap < 2; ++lap)
+	{
+		for (size_t i = 0; i < CommandQueue::CAPACITY; ++i)
+		{
+			command.value = static_cast<int>(i);
+			TEST_CHECK(queue.Push(command));
+		}
+
+		TEST_CHECK(!queue.Push(command));
+
+		for (size_t i = 0; i < CommandQueue::CAPACITY; ++i)
+			TEST_CHECK(queue.Pop(command) && command.value == static_cast<int>(i));
+
+		TEST_CHECK(!queue.Pop(command));
+	}
+
+
+	// 4 producers, retrying when full. Each one's commands
+	// come out in its own order and none is lost
+	constexpr int producers = 4;
+	constexpr int perProducer = 5000;
+	std::thread threads[producers];
+	for (int id = 0; id < producers; ++id)
+	{
+		threads[id] = std::thread([&queue, id]() {
+			for (int i = 0; i < perProducer; ++i)
+			{
+				const Command cmd { Command::SET_FPS, (id << 16) | i, nullptr, nullptr, nullptr };
+				while (!queue.Push(cmd))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	int next[producers] = {};
+	bool ordered = true;
+	for (int popped = 0; popped < producers * perProducer; )
+	{
+		if (!queue.Pop(command))
+			continue;
+
+		const int id = command.value >> 16;
+		ordered = ordered && id < producers && (command.value & 0xFFFF) == next[id];
+		next[id] = (command.value & 0xFFFF) + 1;
+		++popped;
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	TEST_CHECK(ordered && !queue.Pop(command));
+	return true;
+}
+
+
+
+bool save_state()
+{
+	const uint8_t rom[] =
+	{
+		0x70, 0x01, // ADD V0, 1
+		0xA3, 0x00, // LD I, 0x300
+		0xF0, 0x55, // LD [I], V0
+		0x12, 0x00  // JP 0x200
+	};
+
+	xchip::Emulator emulator;
+	xchip::Emulator saved;
+	TEST_CHECK(emulator.Initialize() && saved.Initialize());
+	TEST_CHECK(emulator.LoadRom(rom, sizeof(rom)));
+
+	// applied in order by the next frame, before it runs
+	int done = 0;
+	const auto onDone = [](const void* arg, const bool success) {
+		*const_cast<int*>(static_cast<const int*>(arg)) = success ? 1 : -1;
+	};
+	TEST_CHECK(emulator.PostCommand({ xchip::Command::SET_CPU_FREQ, 1200, nullptr, nullptr, nullptr }));
+	TEST_CHECK(emulator.PostCommand({ xchip::Command::SAVE_STATE, 0, &saved, onDone, &done }));
+	TEST_CHECK(emulator.RunFrameUncapped() == 20);
+	TEST_CHECK(done == 1 && saved.GetCpuFreq() == 1200);
+
+	// the saved machine goes on like the one it was taken from
+	xchip::Emulator replay;
+	TEST_CHECK(replay.Initialize() && saved.Clone(replay));
+	TEST_CHECK(replay.RunFrameUncapped() == 20);
+	TEST_CHECK(same_image(emulator.GetCpuManager(), replay.GetCpuManager()));
+	return true;
+}
+
+
+}
@@ -0,0 +1,119 @@
+/*
+
+XChip - A chip8 lib and emulator.
+Copyright (C) 2016  Rafael Moura
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
+
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Utix/Log.h>
+#include <Utix/ScopeExit.h>
+
+#include <XChip/Core/Trace.h>
+#include <XChip/Core/Disassembler.h>
+
+
+
+/*******************************************************************************************
+ *	XChipTraceDump <trace file> [last N records]
+ *	decodes a TraceBuffer dump to text, one executed instruction per line:
+ *	cycle, PC, opcode, I after it ran, VX and VF after it ran, then the mnemonic.
+ *******************************************************************************************/
+
+
+
+
+int main(int argc, char** argv)
+{
+	using namespace utix;
+	using xchip::TraceBuffer;
+	using xchip::TraceHeader;
+	using xchip::TraceRecord;
+
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <trace file> [last N records]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE* const file = fopen(argv[1], "rb");
+	if (!file)
+	{
+		LogError("Could not open \'%s\'", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	const auto close_file = MakeScopeExit([file]() noexcept { fclose(file); });
+
+	TraceHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+		|| memcmp(header.magic, TraceBuffer::MAGIC, sizeof(header.magic)) != 0)
+	{
+		LogError("\'%s\' is not a XChip trace", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	if (header.version != TraceBuffer::VERSION || header.recordSize != sizeof(TraceRecord))
+	{
+		LogError("Unsupported trace version %u, record size %u", header.version, header.recordSize);
+		return EXIT_FAILURE;
+	}
+
+
+	uint64_t skip = 0;
+	if (argc > 2)
+	{
+		const uint64_t last = strtoull(argv[2], nullptr, 10);
+		skip = header.count > last ? header.count - last : 0;
+	}
+
+	if (skip && fseek(file, static_cast<long>(skip * sizeof(TraceRecord)), SEEK_CUR) != 0)
+	{
+		LogError("Could not seek \'%s\'", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+
+	// records keep the low 32 bits of the cycle,
+	// the high bits come from the newest one.
+	const uint64_t first = header.lastCycle - (header.count ? header.count - 1 : 0);
+
+	printf("%-12s %-6s %-6s %-6s %-7s %-3s %s\n", "cycle", "pc", "opcode", "I", "VX", "VF", "instruction");
+
+	TraceRecord record;
+	for (uint64_t i = skip; i < header.count; ++i)
+	{
+		if (fread(&record, sizeof(record), 1, file) != 1)
+		{
+			LogError("Trace truncated at record %llu of %llu", static_cast<unsigned long long>(i),
+			         static_cast<unsigned long long>(header.count));
+			return EXIT_FAILURE;
+		}
+
+		const uint64_t expected = first + i;
+		const uint64_t cycle = (expected & ~uint64_t(0xFFFFFFFF)) | record.cycle;
+
+		char text[xchip::disassembler::MAX_TEXT_SIZE];
+		xchip::disassembler::Disassemble(record.opcode, text, sizeof(text));
+		printf("%-12llu 0x%03X  %04X   0x%03X  V%X=%02X   %02X  %s\n", static_cast<unsigned long long>(cycle),
+		       record.pc, record.opcode, record.I, (record.opcode >> 8) & 0xF, record.vx, record.vf, text);
+	}
+
+	return EXIT_SUCCESS;
+}
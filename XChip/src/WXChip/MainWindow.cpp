@@ -38,6 +38,8 @@ along with this program.  If not, see http://www.gnu.org/licenses/gpl-3.0.html.
 #include <Utix/Log.h>
 #include <Utix/Memory.h>
 
+#include <XChip/Core/RomLibrary.h>
+
 #include <WXChip/Dialog.h>
 #include <WXChip/Main.h>
 #include <WXChip/SaveList.h>
@@ -50,7 +52,9 @@ namespace {
 static void FillRomPath(const wxString& dirPath, const wxString& filename, wxString& dest);
 inline void FillRomPath(const wxString& fullPath, wxString& dest);
 static bool LoadListBox(wxFrame* const parent, const wxString& path, wxListBox& lbox);
-inline std::string ComputeEmuAppCommand(const wxString& emuAppPath, const wxString& rom, const wxString& cliArgs);
+static bool LoadListBoxFromLib(wxFrame* const parent, const wxString& libPath, wxListBox& lbox);
+inline std::string ComputeEmuAppCommand(const wxString& emuAppPath, const wxString& rom, 
+                                        const wxString& libPath, const wxString& cliArgs);
 inline const char* ToCStr(const wxString& wxstr);
 }
 
@@ -59,6 +63,7 @@ wxBEGIN_EVENT_TABLE(MainWindow, wxFrame)
 EVT_MENU(wxID_EXIT, MainWindow::OnExit)
 EVT_MENU(wxID_ABOUT, MainWindow::OnAbout)
 EVT_MENU(ID_MENU_BAR_LOAD_ROM, MainWindow::OnMenuBarLoadRom)
+EVT_MENU(ID_MENU_BAR_LOAD_LIB, MainWindow::OnMenuBarLoadLib)
 EVT_MENU(wxID_ABOUT, MainWindow::OnAbout)
 EVT_BUTTON(ID_BUTTON_LOAD_ROM, MainWindow::OnButtonLoadRom)
 EVT_BUTTON(ID_BUTTON_SELECT_DIR, MainWindow::OnButtonSelectDir)
@@ -133,6 +138,7 @@ void MainWindow::CreateMenuBar()
 	auto menuFile = make_unique<wxMenu>();
 
 	menuFile->Append(ID_MENU_BAR_LOAD_ROM, "&Load Rom...\tCtrl-L", "Load a game rom");
+	menuFile->Append(ID_MENU_BAR_LOAD_LIB, "Load Rom &Library...\tCtrl-B", "List the roms of a packed rom library");
 	menuFile->AppendSeparator();
 	menuFile->Append(wxID_EXIT);
 
@@ -162,7 +168,7 @@ void MainWindow::StartEmulator()
 	if(m_romPath.empty() == false) 
 	{
 		utix::Log("Start Rom At Path: %s", ToCStr(m_romPath));
-		if(!m_process.Run(ComputeEmuAppCommand(m_emuAppPath, m_romPath, m_settingsWin->GetArguments())))
+		if(!m_process.Run(ComputeEmuAppCommand(m_emuAppPath, m_romPath, m_libPath, m_settingsWin->GetArguments())))
 			throw std::runtime_error(utix::GetLastLogError());
 	}
 	else {
@@ -243,7 +249,11 @@ void MainWindow::OnListBoxMouseClick(wxMouseEvent& event)
 	if (item != wxNOT_FOUND) 
 	{
 		lbox->SetSelection(item);
-		FillRomPath(m_settingsWin->GetDirPath(), lbox->GetString(item),m_romPath);
+		if (m_libPath.empty())
+			FillRomPath(m_settingsWin->GetDirPath(), lbox->GetString(item),m_romPath);
+		else
+			FillRomPath(lbox->GetString(item), m_romPath);
+
 		if (event.ButtonDClick())
 			this->StartEmulator();
 	}
@@ -272,8 +282,10 @@ void MainWindow::OnButtonSelectDir(wxCommandEvent&)
 {
 	wxString path = DirectoryDlg(this, "Choose Roms Directory");
 	if(path.empty() == false && path != m_settingsWin->GetDirPath()) {
-		if(LoadListBox(this, path, *m_listBox))
+		if(LoadListBox(this, path, *m_listBox)) {
+			m_libPath.clear();
 			m_settingsWin->SetDirPath(std::move(path));
+		}
 	}
 }
 
@@ -285,6 +297,7 @@ void MainWindow::OnMenuBarLoadRom(wxCommandEvent&)
 	const wxString path = FileDlg(this, "Select Rom", "All Files (*)|*");
 	if (path.empty() == false)
 	{
+		m_libPath.clear();
 		FillRomPath(path, m_romPath);
 		utix::Log("Selected File: %s", ToCStr(m_romPath));
 		StartEmulator();
@@ -295,6 +308,20 @@ void MainWindow::OnMenuBarLoadRom(wxCommandEvent&)
 
 
 
+void MainWindow::OnMenuBarLoadLib(wxCommandEvent&)
+{
+	const wxString path = FileDlg(this, "Select Rom Library", "All Files (*)|*");
+	if (path.empty() == false && LoadListBoxFromLib(this, path, *m_listBox))
+	{
+		FillRomPath(path, m_libPath);
+		m_romPath.clear();
+		utix::Log("Selected Library: %s", ToCStr(m_libPath));
+	}
+}
+
+
+
+
  // local functiosn definitions
 namespace {
 
@@ -372,9 +399,35 @@ static bool LoadListBox(wxFrame* const parent, const wxString& path, wxListBox&
 
 
 
-inline std::string ComputeEmuAppCommand(const wxString& emuAppPath, const wxString& rom, const wxString& cliArgs)
+static bool LoadListBoxFromLib(wxFrame* const parent, const wxString& libPath, wxListBox& lbox)
 {
-	return static_cast<const char*>((emuAppPath + " -ROM " + rom + ' ' + cliArgs).c_str());
+	xchip::RomLibrary library;
+	if (library.Initialize(ToCStr(libPath)) != xchip::LoadStatus::OK) 
+	{
+		ErrorDlg(parent, "Error opening \"" + libPath + "\": " + utix::GetLastLogError());
+		return false;
+	}
+
+	wxArrayString names;
+	for (size_t i = 0; i < library.GetCount(); ++i)
+		names.Add(wxString(library.GetEntry(i).name));
+
+	names.Sort();
+	lbox.Clear();
+	lbox.InsertItems(names, 0);
+	return true;
+}
+
+
+
+
+inline std::string ComputeEmuAppCommand(const wxString& emuAppPath, const wxString& rom, 
+                                        const wxString& libPath, const wxString& cliArgs)
+{
+	if (libPath.empty())
+		return static_cast<const char*>((emuAppPath + " -ROM " + rom + ' ' + cliArgs).c_str());
+
+	return static_cast<const char*>((emuAppPath + " -LIB " + libPath + " -ROM " + rom + ' ' + cliArgs).c_str());
 }
 
 